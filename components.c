@@ -23,7 +23,39 @@
 
 #include <math.h>
 #include <float.h>
+#include <limits.h>
+#include <stddef.h>
 #include "components.h"
+#include "profiler.h"
+#include "lz.h"
+#include "outofcore.h"
+#include "scene.h"
+#include "watch.h"
+
+#if defined(__SSE__)
+    #include <xmmintrin.h>
+#endif // defined(__SSE__)
+
+#if defined(__APPLE__) || defined(__linux__)
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <unistd.h>
+#endif // defined(__APPLE__) || defined(__linux__)
+
+// NOTE: extern variables definition; for declaration see components.hpp
+// light settings
+const GLfloat light_ambient[]  = { 0.0f, 0.0f, 0.0f, 1.0f };
+const GLfloat light_diffuse[]  = { 1.0f, 1.0f, 1.0f, 1.0f };
+const GLfloat light_specular[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+const GLfloat light_position[] = { -10.0f, 10.0f, 10.0f, 1.0f };
+
+// material settings
+const GLfloat mat_ambient[]    = { 0.7f, 0.7f, 0.7f, 1.0f };
+const GLfloat mat_diffuse[]    = { 0.8f, 0.8f, 0.8f, 1.0f };
+const GLfloat mat_specular[]   = { 1.0f, 1.0f, 1.0f, 1.0f };
+const GLfloat high_shininess[] = { 100.0f };
 
 GLuint *indices = NULL;  //!< Vertexs indexes.
 GLfloat *color = NULL;   //!< Vertexs colors.
@@ -34,6 +66,62 @@ int n_vertex = 0;  //!< Vertexes number.
 int n_faces = 0;   //!< Faces number.
 int isColored = 1; //!< Nonzero if model has color.
 FILE *f_ply=NULL;  //!< Input file for model.
+int parse_threads = 0; //!< Threads parsing ASCII bodies, 0 for one per CPU.
+
+GLsizei vertex_stride = 0;  /*!< Byte offset between consecutive vertices
+                                 in the vertex, normal and color arrays,
+                                 nonzero when they are interleaved. */
+GLenum normal_type = GL_FLOAT;        //!< Type of the normal components.
+GLenum color_type = GL_FLOAT;         //!< Type of the color components.
+GLenum element_type = GL_UNSIGNED_INT; //!< Type of the indices.
+int packed_vertices = 1; //!< Nonzero to draw the model in packed format.
+int optimize_vertex_cache = 1; //!< Nonzero to reorder the model on load.
+int lod_enabled = 1;           //!< Nonzero to build and use levels of detail.
+Lod_level lod[MAX_LOD_LEVELS]; //!< Levels of detail, from the finest one.
+int n_lod = 0;                 //!< Number of levels of detail.
+int cluster_culling = 1;       //!< Nonzero to skip clusters not in view.
+int cache_writing = 1;         //!< Nonzero to write the cache of models.
+int cull_backfaces = 0;        //!< Nonzero to skip back-facing triangles.
+Cluster_set clusters;          //!< Clusters of all the levels of detail.
+int viewport_height = 1;       //!< Height of the viewport, in pixels.
+int normals_missing = 0;       //!< Nonzero if the model file has no normals.
+float crease_angle = 0;        //!< Angle of the sharp edges, 0 for none.
+int chunked_model = 0;         //!< Nonzero if the model is drawn from disk.
+
+int model_ready = 0;     //!< Nonzero when the model can be drawn.
+long model_file_size = 0; //!< Size of the model file being parsed.
+const char *load_stage = "Loading"; //!< Current loading stage.
+float load_progress = 0;  //!< Completed fraction of the loading stage.
+int load_done = 0;        //!< Nonzero when the background loading is over.
+int load_failed = 0;      //!< Nonzero if the model could not be loaded.
+int ask_filename = 1;     //!< Nonzero to ask for another file on failure.
+int reloading = 0;        //!< Nonzero while a changed model is loaded again.
+char load_filename[STR_LEN + 1]; //!< Name of the model file to be loaded.
+char *load_path = NULL;   //!< Executable path, used to open the model.
+Preview preview;          //!< Points shown while the model is loading.
+#if defined(__APPLE__) || defined(__linux__)
+pthread_t loader;         //!< Thread loading the model in background.
+pthread_mutex_t load_mutex = PTHREAD_MUTEX_INITIALIZER; /*!< Lock for the
+                               loading progress and completion flag. */
+#endif // defined(__APPLE__) || defined(__linux__)
+void *mapping = NULL;       //!< Memory mapping of the model file, if any.
+size_t mapping_size = 0;    //!< Size of the model file mapping.
+void *cache_mapping = NULL; //!< Memory mapping of the model cache, if any.
+size_t cache_mapping_size = 0; //!< Size of the model cache mapping.
+void *arena = NULL;         //!< Block holding the model arrays, if any.
+size_t arena_size = 0;      //!< Size of the model arena.
+
+GLuint vertex_buffer = 0; //!< Buffer object for vertex data, if used.
+GLuint index_buffer = 0;  //!< Buffer object for indices, if used.
+const GLvoid *vertex_ptr = NULL; /*!< Vertex array pointer, i.e. host
+                                      address or buffer object offset. */
+const GLvoid *normal_ptr = NULL; //!< Normal array pointer.
+const GLvoid *color_ptr = NULL;  //!< Color array pointer.
+const GLvoid *index_ptr = NULL;  //!< Index array pointer.
+
+Mesh shown_model;        //!< Model drawn by display(void).
+int context_menu = 0;    //!< Context menu, for the model shown.
+int axis_menu = 0;       //!< Submenu for the rotation axis choice.
 
 int rotate = 1; //!< Variable indicating wether the model is rotating.
 int light_rotation = 0;  /*!< Variable indicating if the light is rotating
@@ -42,16 +130,18 @@ int light_rotation = 0;  /*!< Variable indicating if the light is rotating
 
 Vector_3D rotation_axis = {0, 1, 0}; //!< Components of the model rotation axis.
 Polar_3D eye = {};        //!< Polar coordinates of the vieweing camera.
-int moving_camera_h = 0;  /*!< Indicate wether left or right arrow
-                               is pressed at the moment. */
-int moving_camera_v = 0;  /*!< Indicate wether up or down arrow
-                               is pressed at the moment. */
-int moving_camera_r = 0;  /*!< Indicate wether PageUp or PageDown key
-                               is pressed at the moment. */
-int adjusting_speed = 0;  /*!< Indicate wether a key for the rotation speed
-                               variation is pressed at the moment. */
+int moving_camera_h = 0;  /*!< Camera movement for the left or right arrow
+                               pressed at the moment, if any. */
+int moving_camera_v = 0;  /*!< Camera movement for the up or down arrow
+                               pressed at the moment, if any. */
+int moving_camera_r = 0;  /*!< Camera movement for the PageUp or PageDown
+                               key pressed at the moment, if any. */
+int adjusting_speed = 0;  /*!< Direction of the rotation speed variation
+                               whose key is pressed at the moment, if any. */
 float angle = 0;          //!< Current angle for model rotation.
 float angularSpeed = 3;   //!< Current angular speed, in deg/TIME_GAP.
+int animating = 0;        //!< Nonzero while the idle function is registered.
+int last_frame_time = 0;  //!< Time of the last animation step, in ms.
 int rotation_sign = 1;    //!< Sign for the model rotation (right hand rule).
 int displayColor = 1;     //!< True to display the model with colors.
 Vector_3D center;         //!< Center of the model bounding box.
@@ -75,6 +165,7 @@ void resize(int w, int h)
 {
     const float ar = (float) w / (float) h; // viewport aspect ratio
     glViewport(0, 0, w, h);                 // set viewport position and size
+    viewport_height = h;
 
     glMatrixMode(GL_PROJECTION);
 
@@ -86,55 +177,52 @@ void resize(int w, int h)
 }
 
 /*!
- * Update the angle used for model rotation around its rotation axis.
- * When called, the function increments the angle, then if the rotation
- * is enabled it schedules a next call of itself with a time gap.
+ * Advance the rotation angle of the model by the current angular speed,
+ * for the given number of time steps.
  */
-void updateAngle(int value)
+void step_rotation(float steps)
 {
-    UNUSED(value); // suppress warning for unused parameter
-
-    angle += angularSpeed; // update angle
+    angle += angularSpeed * steps; // update angle
 
     // reduce angle into [0, 360]
     // NOTE: the angle is always positive, sign is applied in the rotation
     if (angle > 360.0f)
         angle = fmod(angle, 360.0f);
-
-    // schedule call with timing, only when rotation is active
-    if(rotate)
-        glutTimerFunc(TIME_GAP, updateAngle, 0);
-
-    glutPostRedisplay(); // ask for viewport refresh
 }
 
 /*!
  * This function variates the rotation speed of the model, inside the interval
  * (`MIN_ANGULAR_SPEED`, `MAX_ANGULAR_SPEED`), of an amount equal to  
- * `ANGULAR_INCREMENT`, then it schedules a call of itself (with a `TIME_GAP`
- * delay) wether the key controlling rotation speed variation is still
- * pressed.
+ * `ANGULAR_INCREMENT` for each time step.
+ *
+ * @return Nonzero if the speed is not already at the bound in the given
+ * direction, i.e. if the variation can go on.
  */
-void adjust_rotation_speed(int dir)
+int adjust_rotation_speed(int dir, float steps)
 {
     if (dir == SPEED_INCREMENT && angularSpeed < MAX_ANGULAR_SPEED)
-        angularSpeed += ANGULAR_INCREMENT;
+    {
+        angularSpeed += ANGULAR_INCREMENT * steps;
+        if (angularSpeed > MAX_ANGULAR_SPEED)
+            angularSpeed = MAX_ANGULAR_SPEED;
+        return 1;
+    }
 
     if (dir == SPEED_DECREMENT && angularSpeed > MIN_ANGULAR_SPEED)
-        angularSpeed -= ANGULAR_INCREMENT;
-        
-    // schedule call iff key is still pressed
-    if (adjusting_speed)
-        glutTimerFunc(TIME_GAP, adjust_rotation_speed, dir);
+    {
+        angularSpeed -= ANGULAR_INCREMENT * steps;
+        if (angularSpeed < MIN_ANGULAR_SPEED)
+            angularSpeed = MIN_ANGULAR_SPEED;
+        return 1;
+    }
 
-    glutPostRedisplay(); // ask for viewport refresh
+    return 0;
 }
 
 /*!
- * This function performs a small camera movement in the desired direction, 
- * whose size is specified by the `ARROW_ZOOM_SPEED` or `ARROW_ROT_SPEED`
- * macros, then calls itself (with a `TIME_GAP` delay) if the key for
- * the camera movement is still pressed.
+ * This function performs a camera movement in the desired direction, 
+ * whose size for each time step is specified by the `ARROW_ZOOM_SPEED` or
+ * `ARROW_ROT_SPEED` macros.
  *
  * The camera position is mantained inside the interval
  * \f[ 
@@ -142,57 +230,235 @@ void adjust_rotation_speed(int dir)
  *      \times (\frac{-\pi}{2},\, \frac{\pi}{2}) 
  *      \times (0,\, \text{MAX\_RHO}) 
  * \f]
+ *
+ * @return Nonzero if the camera is not already at the bound in the given
+ * direction, i.e. if the movement can go on.
  */
-void move_camera(int dir)
+int move_camera(int dir, float steps)
 {
-    int still_moving; // schedule or not another timed call to move_camera
+    const float zoom = ARROW_ZOOM_SPEED * steps; // radial movement
+    const float rot = ARROW_ROT_SPEED * steps;   // angular movement
 
     switch (dir)
     {
         case MOVE_AWAY:
-            if (eye.rho + ARROW_ZOOM_SPEED < MAX_RHO)
-                eye.rho += ARROW_ZOOM_SPEED;
-            still_moving = (moving_camera_r ? 1 : 0);
+            if (eye.rho + ARROW_ZOOM_SPEED >= MAX_RHO)
+                return 0;
+            if (eye.rho + zoom < MAX_RHO)
+                eye.rho += zoom;
             break;
 
         case MOVE_CLOSE:
-            if (eye.rho > ARROW_ROT_SPEED)
-                eye.rho -= ARROW_ZOOM_SPEED;
-            still_moving = (moving_camera_r ? 1 : 0);
+            if (eye.rho <= ARROW_ROT_SPEED)
+                return 0;
+            if (eye.rho - zoom > 0)
+                eye.rho -= zoom;
             break;
 
         case MOVE_UP:
-            if (eye.phi + ARROW_ROT_SPEED < PI / 2)
-                eye.phi += ARROW_ROT_SPEED;
-            still_moving = (moving_camera_v ? 1 : 0);
+            if (eye.phi + ARROW_ROT_SPEED >= PI / 2)
+                return 0;
+            if (eye.phi + rot < PI / 2)
+                eye.phi += rot;
             break;
 
         case MOVE_DOWN:
-            if (eye.phi - ARROW_ROT_SPEED > -PI / 2)
-                eye.phi -= ARROW_ROT_SPEED;
-            still_moving = (moving_camera_v ? 1 : 0);
+            if (eye.phi - ARROW_ROT_SPEED <= -PI / 2)
+                return 0;
+            if (eye.phi - rot > -PI / 2)
+                eye.phi -= rot;
             break;
 
         case MOVE_RIGHT:
-            eye.theta += ARROW_ROT_SPEED;
+            eye.theta += rot;
             if (eye.theta > 2 * PI)
                 eye.theta = fmod(eye.theta, 2 * PI);
-            still_moving = (moving_camera_h ? 1 : 0);
             break;
 
         case MOVE_LEFT:
-            eye.theta -= ARROW_ROT_SPEED;
+            eye.theta -= rot;
             if (eye.theta < 0)
                 eye.theta = fmod(eye.theta, 2 * PI);
-            still_moving = (moving_camera_h ? 1 : 0);
             break;
     }
 
-    // schedule call, iff key is still holded
-    if (still_moving)
-        glutTimerFunc(TIME_GAP, move_camera, dir);
+    return 1;
+}
 
-    glutPostRedisplay(); // ask for viewport refresh
+/*!
+ * Register the idle function animate(void), if it is not running yet,
+ * starting to measure time from now. It must be called whenever the
+ * automatic rotation is started or a key for continuous movement is
+ * pressed.
+ */
+void start_animation(void)
+{
+    if (animating)
+        return;
+
+    animating = 1;
+    last_frame_time = glutGet(GLUT_ELAPSED_TIME);
+    glutIdleFunc(animate);
+}
+
+/*!
+ * This idle function is the single scheduler for all the continuous
+ * changes of the scene: automatic rotation, rotation speed variation and
+ * camera movement with the keyboard. Each change is advanced by the time
+ * elapsed since the previous call, measured in `TIME_GAP` units, so that
+ * the motion has the same speed regardless of the time taken to draw
+ * a frame. The elapsed time is limited to `MAX_FRAME_STEPS` units, to avoid
+ * jumps after a stall.
+ *
+ * A single redisplay is requested when something changed, and the function
+ * unregisters itself when nothing is moving, so that no CPU time is spent
+ * while the scene is static.
+ */
+void animate(void)
+{
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    float steps = (float) (now - last_frame_time) / TIME_GAP;
+    int changed = 0; // nonzero when the scene must be redrawn
+
+    last_frame_time = now;
+    if (steps > MAX_FRAME_STEPS)
+        steps = MAX_FRAME_STEPS;
+
+    if (rotate && model_ready)
+    {
+        step_rotation(steps);
+        changed = 1;
+    }
+
+    if (adjusting_speed)
+        changed |= adjust_rotation_speed(adjusting_speed, steps);
+
+    if (moving_camera_h)
+        changed |= move_camera(moving_camera_h, steps);
+
+    if (moving_camera_v)
+        changed |= move_camera(moving_camera_v, steps);
+
+    if (moving_camera_r)
+        changed |= move_camera(moving_camera_r, steps);
+
+    if (changed)
+        glutPostRedisplay(); // ask for viewport refresh
+    else
+    {
+        // nothing is moving, stop until next start_animation()
+        animating = 0;
+        glutIdleFunc(NULL);
+    }
+}
+
+/*!
+ * Draw a progress bar, with a description of the current loading stage,
+ * in the middle of the viewport.
+ */
+static void draw_progress(void)
+{
+    char text[STR_LEN + 1];
+    const char *c;
+    const char *stage;
+    float progress;
+
+    #if defined(__APPLE__) || defined(__linux__)
+    pthread_mutex_lock(&load_mutex);
+    #endif // defined(__APPLE__) || defined(__linux__)
+    stage = load_stage;
+    progress = load_progress;
+    #if defined(__APPLE__) || defined(__linux__)
+    pthread_mutex_unlock(&load_mutex);
+    #endif // defined(__APPLE__) || defined(__linux__)
+
+    // draw in normalized device coordinates
+    glPushAttrib(GL_ENABLE_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    // bar outline and filled part
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glBegin(GL_LINE_LOOP);
+    glVertex2f(-0.5f, -0.02f);
+    glVertex2f(0.5f, -0.02f);
+    glVertex2f(0.5f, 0.02f);
+    glVertex2f(-0.5f, 0.02f);
+    glEnd();
+    glRectf(-0.5f, -0.02f, -0.5f + progress, 0.02f);
+
+    // stage description
+    sprintf(text, "%s... %d%%", stage, (int) (progress * 100));
+    glRasterPos2f(-0.5f, 0.05f);
+    for (c = text; *c; ++c)
+        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
+
+/*!
+ * Draw the points of the preview received so far, with the same camera
+ * used for the model, centered in their own bounding box.
+ */
+static void draw_preview(void)
+{
+    float rho, f = 1;
+
+    if (preview.uploaded == 0)
+        return;
+
+    // scale preview if too small, as the model
+    rho = INITIAL_DISTANCE_RATIO * preview.radius;
+    if (preview.radius > 0 && preview.radius < MIN_BB_RADIUS)
+    {
+        f = MIN_BB_RADIUS / preview.radius;
+        rho *= f;
+    }
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glPushMatrix();
+    gluLookAt(
+            rho * sin(eye.theta) * cos(eye.phi),
+            rho * sin(eye.phi),
+            rho * cos(eye.theta) * cos(eye.phi),
+            0, 0, 0,
+            0, 1, 0);
+    glScalef(f, f, f);
+    glRotatef(
+            rotation_sign * angle,
+            rotation_axis.x,
+            rotation_axis.y,
+            rotation_axis.z);
+    glTranslatef(-preview.center.x, -preview.center.y, -preview.center.z);
+
+    glPushAttrib(GL_ENABLE_BIT);
+    glDisable(GL_LIGHTING);
+    glColor3f(0.7f, 0.7f, 0.7f);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    if (preview.buffer)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, preview.buffer);
+        glVertexPointer(3, GL_FLOAT, 0, BUFFER_OFFSET(0));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    else
+        glVertexPointer(3, GL_FLOAT, 0, preview.points);
+    glDrawArrays(GL_POINTS, 0, preview.uploaded);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glPopAttrib();
+
+    glPopMatrix();
 }
 
 /*!
@@ -202,7 +468,7 @@ void move_camera(int dir)
  * It moves the camera in the desired position (retrieved by mouse input),
  * then draws on screen the model. The model is translated in a way such the
  * center of its bounding box coincides with the origin, and then it's rotated.
- * Rotation angle is continuously updated by the updateAngle(int) procedure
+ * Rotation angle is continuously updated by the animate(void) procedure
  * while the automatic rotation of the model is active.
  *
  * The model is scaled up if it is too small, in order to permit adequate
@@ -210,7 +476,181 @@ void move_camera(int dir)
  */
 void display(void)
 {
+    int triangles;
+
+    // show the points read so far and the loading progress until the
+    // model is available
+    if (!model_ready)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        draw_preview();
+        draw_progress();
+        glutSwapBuffers();
+        return;
+    }
+
+    profile_begin_frame();
+    triangles = draw_scene();
+    draw_overlay();
+    glutSwapBuffers();
+    profile_mark(PROF_SWAP);
+    profile_end_frame(triangles);
+
+    // keep refining while the chunks for this view arrive
+    if (shown_model.chunked && chunks_pending())
+        glutPostRedisplay();
+}
+
+/*!
+ * Compute the frustum planes and the eye position in model coordinates,
+ * from the current projection and modelview matrices. The planes are
+ * extracted from the rows of their product (Gribb and Hartmann, "Fast
+ * extraction of viewing frustum planes from the world-view-projection
+ * matrix", 2001), and normalized. The eye is the image of the origin
+ * through the inverse modelview, which is a rotation and a uniform scale.
+ */
+static void view_volume(float planes[6][4], float eye_position[3])
+{
+    GLfloat mv[16], pr[16], m[16];
+    float scale2, length;
+    int i, j, k;
+
+    glGetFloatv(GL_MODELVIEW_MATRIX, mv);
+    glGetFloatv(GL_PROJECTION_MATRIX, pr);
+
+    // column-major product pr * mv
+    for (i = 0; i < 4; ++i)
+        for (j = 0; j < 4; ++j)
+        {
+            m[j * 4 + i] = 0;
+            for (k = 0; k < 4; ++k)
+                m[j * 4 + i] += pr[k * 4 + i] * mv[j * 4 + k];
+        }
+
+    // left, right, bottom, top, near, far: fourth row plus or minus another
+    for (i = 0; i < 6; ++i)
+    {
+        const float sign = i % 2 ? -1.0f : 1.0f;
+        for (j = 0; j < 4; ++j)
+            planes[i][j] = m[j * 4 + 3] + sign * m[j * 4 + i / 2];
+        length = sqrt(planes[i][0] * planes[i][0]
+                      + planes[i][1] * planes[i][1]
+                      + planes[i][2] * planes[i][2]);
+        for (j = 0; j < 4; ++j)
+            planes[i][j] /= length;
+    }
+
+    // the inverse of s * R is R^T / s
+    scale2 = mv[0] * mv[0] + mv[1] * mv[1] + mv[2] * mv[2];
+    for (i = 0; i < 3; ++i)
+        eye_position[i] = -(mv[i * 4] * mv[12]
+                            + mv[i * 4 + 1] * mv[13]
+                            + mv[i * 4 + 2] * mv[14]) / scale2;
+}
+
+/*!
+ * Buffer objects are bound when the model was uploaded, and color is used
+ * only if present and active.
+ */
+void bind_model(const Mesh *m)
+{
+    // source arrays from buffer objects, when the model was uploaded
+    if (m->vertex_buffer)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, m->vertex_buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->index_buffer);
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY); // utilizzare l'array dei vertici
+    // color the model only if color is present and active
+    if (m->is_colored && displayColor)
+        glEnableClientState(GL_COLOR_ARRAY);  // utilizzare l'array dei colori
+    glEnableClientState(GL_NORMAL_ARRAY); // utilizzare l'array delle normali
+    glVertexPointer(3, GL_FLOAT, m->vertex_stride, m->vertex_ptr);
+    glNormalPointer(m->normal_type, m->vertex_stride, m->normal_ptr);
+    if(m->is_colored && displayColor)
+        glColorPointer(3, m->color_type, m->vertex_stride, m->color_ptr);
+}
+
+/*!
+ * Draw the chunks needed for this view, or the visible clusters of the
+ * model, or the whole model. The view volume is taken from the current
+ * matrices, so the model may be drawn several times with different
+ * transformations.
+ */
+int draw_model(const Mesh *m, int l)
+{
+    int count = m->n_lod ? m->lod[l].count : m->n_faces * 3;
+
+    if (m->chunked)
+    {
+        float planes[6][4], eye_position[3];
+        float scale = bb_radius < MIN_BB_RADIUS ? MIN_BB_RADIUS / bb_radius
+                                                : 1;
+
+        view_volume(planes, eye_position);
+        count = 3 * draw_chunks(planes, eye_position, scale, viewport_height,
+                m->is_colored && displayColor);
+    }
+    else if (m->n_lod && m->lod[l].n_clusters)
+    {
+        float planes[6][4], eye_position[3];
+        int i, n_ranges;
+
+        view_volume(planes, eye_position);
+        n_ranges = cull_clusters(m, l, planes,
+                cull_backfaces ? eye_position : NULL);
+        glMultiDrawElements(
+                GL_TRIANGLES,
+                m->clusters.draw_count,
+                m->element_type,
+                m->clusters.draw_start,
+                n_ranges);
+
+        for (i = count = 0; i < n_ranges; ++i)
+            count += m->clusters.draw_count[i];
+    }
+    else
+        glDrawElements(
+                GL_TRIANGLES,
+                count,
+                m->element_type,
+                (const char*) m->index_ptr + (m->n_lod ? m->lod[l].first : 0)
+                    * (m->element_type == GL_UNSIGNED_SHORT
+                       ? sizeof (GLushort) : sizeof (GLuint)));
+
+    return count / 3;
+}
+
+/*!
+ * Unbind the buffer objects and disable the arrays.
+ */
+void unbind_model(const Mesh *m)
+{
+    if (m->vertex_buffer)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    // disable arrays
+    glDisableClientState(GL_NORMAL_ARRAY);
+    if (m->is_colored)
+        glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+/*!
+ * Draw the model shown, at the coarsest level of detail looking like the
+ * full one, in the current state of camera and rotation. The models of a scene
+ * are drawn by draw_instances(void), in the same frame of reference.
+ */
+int draw_scene(void)
+{
+    int triangles;
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    profile_mark(PROF_CLEAR);
 
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
@@ -246,24 +686,15 @@ void display(void)
     // translate the bounding box center in the origin of axes
     glTranslatef(-center.x, -center.y, -center.z);
 
-    glEnableClientState(GL_VERTEX_ARRAY); // utilizzare l'array dei vertici
-    // color the model only if color is present and active
-    if (isColored && displayColor)
-        glEnableClientState(GL_COLOR_ARRAY);  // utilizzare l'array dei colori
-    glEnableClientState(GL_NORMAL_ARRAY); // utilizzare l'array delle normali
-    glVertexPointer(3, GL_FLOAT, 0, vertexp);
-    glNormalPointer(GL_FLOAT, 0, normals);
-    if(isColored && displayColor)
-        glColorPointer(3, GL_FLOAT, 0, color);
-
-    // draw model
-    glDrawElements(GL_TRIANGLES, n_faces * 3, GL_UNSIGNED_INT, indices);
-
-    // disable arrays
-    glDisableClientState(GL_NORMAL_ARRAY);
-    if (isColored)
-        glDisableClientState(GL_COLOR_ARRAY);
-    glDisableClientState(GL_VERTEX_ARRAY);
+    if (scene_active())
+        triangles = draw_instances();
+    else
+    {
+        bind_model(&shown_model);
+        triangles = draw_model(&shown_model, choose_lod(&shown_model));
+        unbind_model(&shown_model);
+    }
+    profile_mark(PROF_DRAW);
 
     // draw rotating light (if light is solidal with model)
     if (light_rotation)
@@ -278,7 +709,7 @@ void display(void)
     if (!light_rotation)
         glLightfv(GL_LIGHT0, GL_POSITION, light_position);
 
-    glutSwapBuffers();
+    return triangles;
 }
 
 /*!
@@ -286,8 +717,8 @@ void display(void)
  * 
  * Note that rotation speed control is performed registering the pressure and 
  * release of the respective keys (with the `adjusting_speed` variable), 
- * and launching a function (adjust_rotation_speed(int)) which constantly 
- * increments or decrements angular speed only while the key is pressed.
+ * and letting the animation scheduler animate(void) constantly 
+ * increment or decrement angular speed only while the key is pressed.
  * This fancy way is more complex than the mere increment or decrement 
  * of a variable with a fixed value on keypress, but permits to have a smooth 
  * keyboard handling which is independent from typematic settings.
@@ -307,17 +738,24 @@ void key(unsigned char key, int x, int y)
         // Tasto 'esc'
         case 27 :
         case 'q':
+            profile_close_trace(); // complete the trace, if any
             exit(EXIT_SUCCESS);
             break;
 
+        // show or hide the profiler overlay
+        case 'p':
+            toggle_overlay();
+            glutPostRedisplay(); // ask for viewport refresh
+            break;
+
         // increment rotation speed
         case '+':
             // ignore callback if related key is still holded
             if (adjusting_speed)
                 return;
-            // set flag and call specific function otherwise
-            adjusting_speed = 1;
-            adjust_rotation_speed(SPEED_INCREMENT);
+            // set direction and start variation otherwise
+            adjusting_speed = SPEED_INCREMENT;
+            start_animation();
             break;
 
         // decrement rotation speed
@@ -325,20 +763,18 @@ void key(unsigned char key, int x, int y)
             // ignore callback if related key is still holded
             if (adjusting_speed)
                 return;
-            // set flag and call specific function otherwise
-            adjusting_speed = 1;
-            adjust_rotation_speed(SPEED_DECREMENT);
+            // set direction and start variation otherwise
+            adjusting_speed = SPEED_DECREMENT;
+            start_animation();
             break;
 
         // start-stop rotation
         case ' ':
-            if (!rotate) // launch angle updating function when needed
-                glutTimerFunc(TIME_GAP, updateAngle, 0);
             rotate = !rotate; // commute rotation status
+            if (rotate)       // launch angle updating when needed
+                start_animation();
             break;
     }
-
-    glutPostRedisplay(); // ask for viewport refresh
 }
 
 /*!
@@ -365,9 +801,9 @@ void key_release(unsigned char key, int x, int y)
  * Note that camera movement is performed registering the pressure and 
  * release of the respective keys (with the `moving_camera_x` variables,
  * each one tracking one direction: horizontal, vertical, radial), 
- * and launching a function (move_camera(int)) which constantly 
- * moves the camera of a small value `ARROW_ROT_SPEED`, only while the 
- * key is pressed.
+ * and letting the animation scheduler animate(void) constantly 
+ * move the camera of a small value `ARROW_ROT_SPEED` per time step, only
+ * while the key is pressed.
  * 
  * This fancy way is more complex than the mere increment or decrement 
  * of a variable with a fixed value on keypress, but permits to have a smooth 
@@ -388,42 +824,36 @@ void special_key_press(int key, int x, int y)
     {
         // decrement camera latitude, i.e. rotate object up
         case GLUT_KEY_UP:
-            moving_camera_v = 1;
-            move_camera(MOVE_DOWN); // camera movement opposite to model's one
+            moving_camera_v = MOVE_DOWN; // camera movement opposite to model's one
             break;
 
         // increment camera latitude, i.e. rotate object down
         case GLUT_KEY_DOWN:
-            moving_camera_v = 1;
-            move_camera(MOVE_UP);
+            moving_camera_v = MOVE_UP;
             break;
 
         // decrement camera longitude, i.e. rotate object counterclockwise
         case GLUT_KEY_LEFT:
-            moving_camera_h = 1;
-            move_camera(MOVE_RIGHT);
+            moving_camera_h = MOVE_RIGHT;
             break;
 
         // increment camera longitude, i.e. rotate object clockwise
         case GLUT_KEY_RIGHT:
-            moving_camera_h = 1;
-            move_camera(MOVE_LEFT);
+            moving_camera_h = MOVE_LEFT;
             break;
 
         // increment camera radial position, i.e. move away
         case GLUT_KEY_PAGE_UP:
-            moving_camera_r = 1;
-            move_camera(MOVE_AWAY);
+            moving_camera_r = MOVE_AWAY;
             break;
 
         // decrement camera radial position, i.e. move closer
         case GLUT_KEY_PAGE_DOWN:
-            moving_camera_r = 1;
-            move_camera(MOVE_CLOSE);
+            moving_camera_r = MOVE_CLOSE;
             break;
     }
 
-    glutPostRedisplay(); // ask for viewport refresh
+    start_animation(); // the movement is performed by the scheduler
 }
 
 /*!
@@ -453,8 +883,6 @@ void special_key_release(int key, int x, int y)
             moving_camera_r = 0;
             break;
     }
-
-    glutPostRedisplay(); // ask for viewport refresh
 }
 
 /*!
@@ -590,6 +1018,14 @@ void menuCallback(int value)
         case 7:
                 exit(EXIT_SUCCESS);
                 break;
+        case 8:
+                // commute back faces culling
+                cull_backfaces = !cull_backfaces;
+                if (cull_backfaces)
+                    glEnable(GL_CULL_FACE);
+                else
+                    glDisable(GL_CULL_FACE);
+                break;
     }
 }
 
@@ -634,14 +1070,19 @@ void axisSubmenuCallback(int value)
 }
 
 /*!
- * Create context menu.
+ * Create context menu, replacing the one of the model shown before.
  */
 void createGLUTMenu()
 {
-    int menu, axis_submenu;
+    // replace the menu of the model shown before, if any
+    if (context_menu)
+    {
+        glutDestroyMenu(context_menu);
+        glutDestroyMenu(axis_menu);
+    }
 
     // Create submenu for rotation axis choice and add its entries to it
-    axis_submenu = glutCreateMenu(axisSubmenuCallback);
+    axis_menu = glutCreateMenu(axisSubmenuCallback);
     glutAddMenuEntry("X axis", 1);
     glutAddMenuEntry("Y axis", 2);
     glutAddMenuEntry("Z axis", 3);
@@ -651,23 +1092,201 @@ void createGLUTMenu()
 
     // Questa istruzione mi permette di creare realmente il menu
     // associando una funzione di callback
-    menu = glutCreateMenu(menuCallback);
+    context_menu = glutCreateMenu(menuCallback);
 
     // Add menu entries
     glutAddMenuEntry("Show boundary edges", 1);
     glutAddMenuEntry("Show vertices", 2);
     glutAddMenuEntry("Show polygons surface", 3);
-    if (isColored) // only if model file has color informations
+    if (shown_model.is_colored) // only if model file has color informations
         glutAddMenuEntry("Enable/disable color", 4);
     glutAddMenuEntry("Fixed/rotating light", 5);
     glutAddMenuEntry("Rotate clockwise/counterclockwise", 6);
-    glutAddSubMenu("Rotation axis", axis_submenu);
+    glutAddMenuEntry("Show/hide back faces", 8);
+    glutAddSubMenu("Rotation axis", axis_menu);
     glutAddMenuEntry("Exit", 7);
 
     // menu associato al tasto destro
     glutAttachMenu(GLUT_RIGHT_BUTTON);
 }
 
+/*!
+ * Return nonzero if the address lies inside the given block.
+ */
+static int in_block(const void *p, const void *base, size_t size)
+{
+    return p != NULL && base != NULL && (const char*) p >= (const char*) base
+           && (const char*) p < (const char*) base + size;
+}
+
+/*!
+ * Return the size of an arena section of the given size, padded to
+ * `ARENA_ALIGN` bytes.
+ */
+static size_t arena_pad(size_t size)
+{
+    return (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+}
+
+/*!
+ * Allocate a block for the arrays of a model. Blocks of at least a huge
+ * page are aligned to it and, on Linux, the kernel is advised to back them
+ * with transparent huge pages, which reduces the TLB misses when the
+ * arrays are traversed. Pages are committed only when written, so the
+ * sections left unused (e.g. when the vertices are read from a file
+ * mapping) cost only address space.
+ *
+ * Since the size of a model comes from its file, a failed allocation is
+ * left to the caller, which can reject the model: NULL is returned.
+ */
+static void *alloc_arena(size_t size)
+{
+    void *block = NULL;
+
+    #if defined(__APPLE__) || defined(__linux__)
+    if (posix_memalign(&block,
+                size >= ARENA_HUGE_PAGE ? ARENA_HUGE_PAGE : ARENA_ALIGN,
+                size ? size : 1))
+        block = NULL;
+    #if defined(MADV_HUGEPAGE)
+    else if (size >= ARENA_HUGE_PAGE)
+        madvise(block, size / ARENA_HUGE_PAGE * ARENA_HUGE_PAGE,
+                MADV_HUGEPAGE);
+    #endif // defined(MADV_HUGEPAGE)
+    #else // _WIN32
+    block = malloc(size ? size : 1);
+    #endif // defined(__APPLE__) || defined(__linux__)
+
+    return block;
+}
+
+/*!
+ * Release a model array, unless it lies in the arena, which is released
+ * as a whole.
+ */
+static void free_array(void *p)
+{
+    if (!in_block(p, arena, arena_size))
+        free(p);
+}
+
+/*!
+ * Resize the index array to the given number of indices, moving it out of
+ * the arena when it lies there. The index array is the last section of the
+ * arena, so its content extends up to the end of the arena.
+ */
+static void resize_indices(size_t count)
+{
+    GLuint *resized;
+    int line;
+
+    if (in_block(indices, arena, arena_size))
+    {
+        size_t kept = (const char*) arena + arena_size - (const char*) indices;
+
+        line = __LINE__ + 1;
+        resized = (GLuint*) malloc(sizeof (GLuint) * (count ? count : 1));
+        if (resized == NULL)
+            error_handler("malloc", __func__, __FILE__, line);
+        memcpy(resized, indices, sizeof (GLuint) * count < kept
+                                 ? sizeof (GLuint) * count : kept);
+    }
+    else
+    {
+        line = __LINE__ + 1;
+        resized = (GLuint*) realloc(indices,
+                sizeof (GLuint) * (count ? count : 1));
+        if (resized == NULL)
+            error_handler("realloc", __func__, __FILE__, line);
+    }
+
+    indices = resized;
+}
+
+/*!
+ * Store a vertex read by read_ply_record() in the model arrays.
+ */
+static void store_vertex(size_t i, const float *values)
+{
+    int k;
+
+    for (k = 0; k < 3; ++k)
+    {
+        vertexp[i * 3 + k] = values[k];
+        if (values[k] > max_coord[k])
+            max_coord[k] = values[k];
+        if (values[k] < min_coord[k])
+            min_coord[k] = values[k];
+        if (!normals_missing)
+            normals[i * 3 + k] = values[k + 3];
+        if (isColored)
+            color[i * 3 + k] = values[k + 6];
+    }
+}
+
+/*!
+ * Append the triangles of a face read by read_ply_record() to the index
+ * array, after the first `*n_triangles` ones. The array grows when it could
+ * not hold one more triangle for each of the `remaining` faces still to be
+ * read, so that faces can also be written directly while it holds room.
+ */
+static int store_face(const GLuint *polygon, int n, size_t *n_triangles,
+        size_t *capacity, long remaining)
+{
+    size_t needed = *n_triangles + (n > 2 ? n - 2 : 0) + remaining;
+
+    if (n > MAX_FACE_VERTICES)
+    {
+        printf("Faces with more than %d vertices are not supported.\n",
+                MAX_FACE_VERTICES);
+        return -1;
+    }
+    if (needed > INT_MAX / 3)
+    {
+        printf("Too many faces.\n");
+        return -1;
+    }
+
+    if (needed > *capacity)
+    {
+        *capacity = needed + *capacity / 2 < INT_MAX / 3
+                    ? needed + *capacity / 2 : INT_MAX / 3;
+        resize_indices(3 * *capacity);
+    }
+
+    *n_triangles += triangulate_polygon(polygon, n,
+            indices + *n_triangles * 3);
+    return 0;
+}
+
+/*!
+ * Check that a binary body of the given size can hold the records declared
+ * in the header, each one taking at least the size of its scalars and of
+ * the counts of its lists, so that the huge counts of a malformed header
+ * are rejected before the model arrays are sized from them.
+ */
+static int check_body_size(const Ply_header *h, long size)
+{
+    const Ply_element *e;
+    const Ply_property *p;
+    long record;  // minimum size of a record of the element
+
+    for (e = h->elements; e < h->elements + h->n_elements; ++e)
+    {
+        record = 0;
+        for (p = e->props; p < e->props + e->n_props; ++p)
+            record += ply_type_size(p->count_type ? p->count_type : p->type);
+        if (record && e->count > size / record)
+        {
+            printf("Truncated model data, shorter than declared.\n");
+            return -1;
+        }
+        size -= e->count * record;
+    }
+
+    return 0;
+}
+
 /*!
  * Read data from the model input file. Informations on vertices, normals,
  * color and faces are stored in three different dynamical arrays.
@@ -676,15 +1295,23 @@ int parse_file(char *filename, char *path)
 {
     int i, j, k;
     int line;
-    char tmp[STR_LEN + 1]; // buffer containing each token read from the file
+    Ply_header header;                         // declarations of the header
+    Text_reader reader;                        // tokenizer for ASCII body
+    const Ply_element *e;                      // element being read
+    float values[9] = {0, 0, 0, 0, 0, 0, 0, 0, 0}; // vertex components
+    GLuint polygon[MAX_FACE_VERTICES];         // vertices of a face
+    size_t n_triangles = 0;                    // triangles read so far
+    size_t capacity;                           // triangles fitting indices
+    size_t size;                               // size of a vertex array
+    int invalid = 0;                           // nonzero on malformed data
 
     UNUSED(path); // no effect, only suppresses warnings for unused parameter
 
-    // open file
+    // open file (in binary mode, because the body may be binary)
     #if defined(__APPLE__)
-    f_ply = openFile(filename, strlen(filename), path, strlen(path), "r");
+    f_ply = openFile(filename, strlen(filename), path, strlen(path), "rb");
     #else // __linux__, _WIN32
-    f_ply = fopen(filename, "r");
+    f_ply = fopen(filename, "rb");
     #endif // defined(__APPLE__)
 
     // error check for file opening
@@ -694,205 +1321,4862 @@ int parse_file(char *filename, char *path)
         return -1;
     }
 
-    // read first line from file and check that is a valid ply file
-    fscanf(f_ply, "%[^\n]s", tmp);
+    // get file size, to track parsing progress
+    fseek(f_ply, 0, SEEK_END);
+    model_file_size = ftell(f_ply);
+    rewind(f_ply);
+    set_load_progress("Parsing", 0);
 
-    if (strcmp(tmp, "ply"))
+    // scan header file for informations on model
+    if (read_ply_header(f_ply, &header))
     {
-        printf("Not a valid .ply file.\n");
+        fclose(f_ply);
         return -1;
     }
-
-    // scan header file for informations on model
-    isColored = 0;
-    do // while (strcmp(tmp, "end_header"))
+    n_vertex = header.n_vertex;
+    n_faces = header.n_faces;
+    isColored = header.is_colored;
+    normals_missing = !header.has_normals;
+
+    // binary bodies start after the end_header line, and must hold the
+    // records declared before the arrays are allocated for them
+    if (header.format != PLY_ASCII)
     {
-        // get next token
-        fscanf(f_ply, "%s", tmp);
-
-        if (!strcmp(tmp, "vertex"))
+        while ((i = fgetc(f_ply)) != EOF && i != '\n') {}
+        if (check_body_size(&header, model_file_size - ftell(f_ply)))
         {
-            // get next token, containing face number
-            fscanf(f_ply, "%d", &n_vertex);
-
-            // allocate dynamical array for normals components
-            line = __LINE__ + 1;
-            normals = (GLfloat*) malloc(sizeof (GLfloat) * n_vertex * 3);
-            if (normals == NULL)
-                error_handler("malloc", __func__, __FILE__, line);
-
-            // allocate dynamical array for vertices components
-            line = __LINE__ + 1;
-            vertexp = (GLfloat*) malloc(sizeof (GLfloat) * n_vertex * 3);
-            if (vertexp == NULL)
-                error_handler("malloc", __func__, __FILE__, line);
+            fclose(f_ply);
+            return -1;
         }
+    }
 
-        // check if model is colored
-        if (!isColored && !strcmp(tmp, "red")) // do this only once
-        {
-            isColored = 1;
+    // a single arena for normals, vertices, color and indices, sized from
+    // the header, with the indices last so that they can grow out of it
+    // (with one triangle per face, grown while reading polygons)
+    size = arena_pad(sizeof (GLfloat) * 3 * (size_t) n_vertex);
+    capacity = n_faces;
+    arena_size = (isColored ? 3 : 2) * size
+                 + (n_faces ? arena_pad(sizeof (GLuint) * 3 * capacity)
+                            : ARENA_ALIGN);
+    arena = alloc_arena(arena_size);
+    if (arena == NULL)
+    {
+        printf("Not enough memory for the model.\n");
+        arena_size = 0;
+        fclose(f_ply);
+        return -1;
+    }
+    normals = (GLfloat*) arena;
+    vertexp = (GLfloat*) ((char*) arena + size);
+    color = isColored ? (GLfloat*) ((char*) arena + 2 * size) : NULL;
+    indices = (GLuint*) ((char*) arena + (isColored ? 3 : 2) * size);
 
-            // allocate dynamical array for color
-            line = __LINE__ + 1;
-            color = (GLfloat*) malloc(sizeof (GLfloat) * n_vertex * 3);
-            if (color == NULL)
-                error_handler("malloc", __func__, __FILE__, line);
+    start_preview(n_vertex);
+
+    // binary bodies are mapped in memory when their layout allows it,
+    // otherwise they are bulk read
+    if (header.format != PLY_ASCII)
+    {
+        if (!map_binary_body(&header))
+        {
+            fclose(f_ply);
+            return 0;
         }
 
-        if (!strcmp(tmp, "face"))
+        if (parse_binary_body(&header))
         {
-            // get next token, containing face number
-            fscanf(f_ply, "%d", &n_faces);
-
-            // allocate dynamical array for faces indices
-            line = __LINE__ + 1;
-            indices = (GLuint*) malloc(sizeof (GLuint) * n_faces * 3);
-            if (indices == NULL)
-                error_handler("malloc", __func__, __FILE__, line);
+            fclose(f_ply);
+            return -1;
         }
-    } while (strcmp(tmp, "end_header"));
-    
+
+        fclose(f_ply);
+        return 0;
+    }
+
+    // large ASCII bodies are split among threads when possible, otherwise
+    // the body is read in large blocks and tokenized in memory
+    #ifndef __DEBUG__
+    i = parse_ascii_body_parallel(&header);
+    if (i <= 0)
+    {
+        if (i < 0)
+            printf("Invalid or truncated model data.\n");
+        fclose(f_ply);
+        return i;
+    }
+    #endif // __DEBUG__
+
+    reader.file = f_ply;
+    reader.size = reader.pos = 0;
+    reader.eof = 0;
+    line = __LINE__ + 1;
+    reader.buf = (char*) malloc(TEXT_BLOCK_SIZE + 1);
+    if (reader.buf == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    // read the elements in order: vertex properties are stored in their
+    // component, faces in the index array, other elements are skipped;
+    // i index iterates on the records of each element
+    for (e = header.elements, k = 2; k > 0 && !invalid; ++e)
+    {
+        const int is_vertex = e - header.elements == header.vertex_element;
+        const int is_face = e - header.elements == header.face_element;
+
+        for (i = 0; i < e->count && !invalid; ++i)
+        {
+            j = read_ply_record(&reader, PLY_ASCII, e, values,
+                    polygon, is_face * MAX_FACE_VERTICES);
+            invalid = j < 0;
+
+            if (is_face && !invalid && store_face(polygon, j, &n_triangles,
+                        &capacity, e->count - i - 1))
+            {
+                free(reader.buf);
+                fclose(f_ply);
+                return -1;
+            }
+
+            if (!is_vertex)
+                continue;
+            store_vertex(i, values);
+
+            #ifdef __DEBUG__
+            printf("%.2f %.2f %.2f\n", values[0], values[1], values[2]);
+            #endif
+
+            // show the vertices read so far
+            if ((i + 1) % PLY_CHUNK_RECORDS == 0 || i + 1 == n_vertex)
+                add_preview(vertexp + (size_t) i / PLY_CHUNK_RECORDS
+                                      * PLY_CHUNK_RECORDS * 3,
+                        3 * sizeof (GLfloat),
+                        i / PLY_CHUNK_RECORDS * PLY_CHUNK_RECORDS,
+                        i % PLY_CHUNK_RECORDS + 1);
+        }
+
+        k -= is_vertex + is_face;
+    }
+    n_faces = (int) n_triangles;
+
+    free(reader.buf);
+
+    if (invalid)
+    {
+        printf("Invalid or truncated model data.\n");
+        fclose(f_ply);
+        return -1;
+    }
+
+    // release file
+    fclose(f_ply);
+
+    #ifdef __DEBUG__
+    printf( "\n      min       max\n"
+            "x: %f %f\n"
+            "y: %f %f\n"
+            "z: %f %f\n",
+            min_coord[0],
+            max_coord[0],
+            min_coord[1],
+            max_coord[1],
+            min_coord[2],
+            max_coord[2]
+            );
+    #endif // __DEBUG__
+
+    return 0;
+}
+
+/*!
+ * Read the next token of a .ply header into a buffer of STR_LEN + 1 chars.
+ * Tokens filling the buffer are rejected, since they may be truncated.
+ * @return 0 on success, -1 on a missing or too long token.
+ */
+static int read_header_token(FILE *f, char *tmp)
+{
+    char specifier[16];  // conversion limited to the buffer size
+
+    sprintf(specifier, "%%%ds", STR_LEN);
+    if (fscanf(f, specifier, tmp) != 1 || strlen(tmp) == STR_LEN)
+    {
+        printf("Invalid file header, missing or too long token.\n");
+        return -1;
+    }
+    return 0;
+}
+
+/*!
+ * The header is scanned token by token, recording the body format and the
+ * schema of every element, i.e. the number of its records and the type of
+ * each property, scalar or list. Vertex properties are matched by name to
+ * the model components, in any order, and the face list named
+ * `vertex_indices` (or `vertex_index`) holds the vertices of each face;
+ * any other property or element is skipped while reading the body. A model
+ * is colored when `red`, `green` and `blue` properties are declared, and
+ * has normals when `nx`, `ny` and `nz` are.
+ */
+int read_ply_header(FILE *f, Ply_header *h)
+{
+    static const char *components[9] = {
+        "x", "y", "z", "nx", "ny", "nz", "red", "green", "blue"
+    };
+    char tmp[STR_LEN + 1];           // buffer containing each token read
+    Ply_element *e = NULL;           // element under declaration
+    Ply_property *p;
+    int found = 0;                   // bit mask of the components found
+    int is_list;                     // nonzero for a list property
+    int i;
+
+    memset(h, 0, sizeof (*h));
+    h->format = PLY_ASCII;
+    h->vertex_element = h->face_element = -1;
+
+    // read first line from file and check that is a valid ply file
+    if (fgets(tmp, sizeof tmp, f) == NULL
+            || (strcmp(tmp, "ply\n") && strcmp(tmp, "ply\r\n")))
+    {
+        printf("Not a valid .ply file.\n");
+        return -1;
+    }
+
+    do // while (strcmp(tmp, "end_header"))
+    {
+        // get next token
+        if (read_header_token(f, tmp))
+            return -1;
+
+        // skip comments, which may contain any word
+        if (!strcmp(tmp, "comment") || !strcmp(tmp, "obj_info"))
+        {
+            fscanf(f, "%*[^\n]");
+            continue;
+        }
+
+        if (!strcmp(tmp, "format"))
+        {
+            // get next token, containing body encoding
+            if (read_header_token(f, tmp))
+                return -1;
+            if (!strcmp(tmp, "ascii"))
+                h->format = PLY_ASCII;
+            else if (!strcmp(tmp, "binary_little_endian"))
+                h->format = PLY_BINARY_LE;
+            else if (!strcmp(tmp, "binary_big_endian"))
+                h->format = PLY_BINARY_BE;
+            else
+            {
+                printf("Unsupported .ply format %s.\n", tmp);
+                return -1;
+            }
+        }
+
+        if (!strcmp(tmp, "element"))
+        {
+            if (h->n_elements == MAX_PLY_ELEMENTS)
+            {
+                printf("Too many .ply elements.\n");
+                return -1;
+            }
+            e = &h->elements[h->n_elements];
+
+            // get element name and number of records
+            if (read_header_token(f, tmp))
+                return -1;
+            if (fscanf(f, "%ld", &e->count) != 1 || e->count < 0)
+            {
+                printf("Invalid declaration of element %s.\n", tmp);
+                return -1;
+            }
+            if (!strcmp(tmp, "vertex") && h->vertex_element < 0)
+                h->vertex_element = h->n_elements;
+            else if (!strcmp(tmp, "face") && h->face_element < 0)
+                h->face_element = h->n_elements;
+            h->n_elements++;
+        }
+
+        if (!strcmp(tmp, "property"))
+        {
+            if (e == NULL || e->n_props == MAX_PLY_PROPERTIES)
+            {
+                printf("Invalid or too many .ply properties.\n");
+                return -1;
+            }
+            p = &e->props[e->n_props++];
+            p->slot = PLY_UNUSED;
+
+            // get type (with count type for lists), then the name
+            if (read_header_token(f, tmp))
+                return -1;
+            is_list = !strcmp(tmp, "list");
+            if (is_list)
+            {
+                if (read_header_token(f, tmp))
+                    return -1;
+                p->count_type = ply_type_from_name(tmp);
+                if (read_header_token(f, tmp))
+                    return -1;
+            }
+            p->type = ply_type_from_name(tmp);
+            if (read_header_token(f, tmp))
+                return -1;
+            if (!p->type || (is_list && !p->count_type))
+            {
+                printf("Invalid type for property %s.\n", tmp);
+                return -1;
+            }
+
+            // record the model component of vertex and face properties
+            if (e - h->elements == h->vertex_element && !p->count_type)
+            {
+                for (i = 0; i < 9; ++i)
+                    if (!strcmp(tmp, components[i]))
+                        p->slot = i;
+            }
+            else if (e - h->elements == h->face_element && p->count_type
+                    && (!strcmp(tmp, "vertex_indices")
+                        || !strcmp(tmp, "vertex_index")))
+                p->slot = PLY_INDICES;
+        }
+    } while (strcmp(tmp, "end_header"));
+
     // check if header contains useful declarations
-    if (n_vertex == 0 || n_faces == 0)
+    if (h->vertex_element < 0 || h->face_element < 0
+            || h->elements[h->vertex_element].count <= 0
+            || h->elements[h->face_element].count <= 0
+            || h->elements[h->vertex_element].count > INT_MAX
+            || h->elements[h->face_element].count > INT_MAX)
+    {
+        printf("Invalid file header, nothing to draw is declared.\n");
+        return -1;
+    }
+    h->n_vertex = (int) h->elements[h->vertex_element].count;
+    h->n_faces = (int) h->elements[h->face_element].count;
+
+    // size of the binary records, when all their properties are scalars
+    for (e = h->elements; e < h->elements + h->n_elements; ++e)
+        for (p = e->props; p < e->props + e->n_props; ++p)
+        {
+            if (p->count_type)
+            {
+                e->stride = 0;
+                break;
+            }
+            e->stride += ply_type_size(p->type);
+        }
+
+    // faces need their vertices, and only the first list is used
+    e = &h->elements[h->face_element];
+    for (i = 0; i < e->n_props; ++i)
+        if (e->props[i].slot == PLY_INDICES)
+        {
+            found = 1;
+            for (++i; i < e->n_props; ++i)
+                if (e->props[i].slot == PLY_INDICES)
+                    e->props[i].slot = PLY_UNUSED;
+        }
+    if (!found)
+    {
+        printf("Invalid file header, face vertex indices are missing.\n");
+        return -1;
+    }
+
+    // normals and color are used only when all their components are there
+    e = &h->elements[h->vertex_element];
+    found = 0;
+    for (i = 0; i < e->n_props; ++i)
+        if (e->props[i].slot != PLY_UNUSED)
+            found |= 1 << e->props[i].slot;
+    if ((found & 0007) != 0007)
+    {
+        printf("Invalid file header, vertex coordinates are missing.\n");
+        return -1;
+    }
+    h->has_normals = (found & 0070) == 0070;
+    h->is_colored = (found & 0700) == 0700;
+    for (i = 0; i < e->n_props; ++i)
+        if ((e->props[i].slot / 3 == 1 && !h->has_normals)
+                || (e->props[i].slot / 3 == 2 && !h->is_colored))
+            e->props[i].slot = PLY_UNUSED;
+
+    return 0;
+}
+
+/*!
+ * Map the type names allowed by the .ply specification, in both their short
+ * (e.g. `uchar`) and sized (e.g. `uint8`) spelling, to the related type.
+ */
+Ply_type ply_type_from_name(const char *name)
+{
+    if (!strcmp(name, "char") || !strcmp(name, "int8"))
+        return PLY_CHAR;
+    if (!strcmp(name, "uchar") || !strcmp(name, "uint8"))
+        return PLY_UCHAR;
+    if (!strcmp(name, "short") || !strcmp(name, "int16"))
+        return PLY_SHORT;
+    if (!strcmp(name, "ushort") || !strcmp(name, "uint16"))
+        return PLY_USHORT;
+    if (!strcmp(name, "int") || !strcmp(name, "int32"))
+        return PLY_INT;
+    if (!strcmp(name, "uint") || !strcmp(name, "uint32"))
+        return PLY_UINT;
+    if (!strcmp(name, "float") || !strcmp(name, "float32"))
+        return PLY_FLOAT;
+    if (!strcmp(name, "double") || !strcmp(name, "float64"))
+        return PLY_DOUBLE;
+    return 0;
+}
+
+/*!
+ * Return the number of bytes occupied by a value of the given type inside
+ * a binary body, or zero for an invalid type.
+ */
+int ply_type_size(Ply_type type)
+{
+    switch (type)
+    {
+        case PLY_CHAR:
+        case PLY_UCHAR:
+            return 1;
+        case PLY_SHORT:
+        case PLY_USHORT:
+            return 2;
+        case PLY_INT:
+        case PLY_UINT:
+        case PLY_FLOAT:
+            return 4;
+        case PLY_DOUBLE:
+            return 8;
+    }
+    return 0;
+}
+
+/*!
+ * Powers of ten exactly representable as double, used for the conversion
+ * of decimal numbers.
+ */
+static const double pow10_table[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*!
+ * The number is converted by accumulating its significant digits into an
+ * integer and scaling it by an exact power of ten, which gives the
+ * correctly rounded double whenever the significand fits in 53 bits and
+ * the decimal exponent is at most 22 in absolute value. The double is then
+ * rounded to float; in the rare cases where this second rounding could
+ * differ from a direct one (i.e. when the double falls exactly halfway
+ * between two floats), and when the fast conversion does not apply, the
+ * number is converted by strtof().
+ *
+ * The decimal separator is always the dot, independently from the locale.
+ */
+int text_to_float(const char *s, size_t len, float *out)
+{
+    const char *p = s, *end = s + len;
+    unsigned long long m = 0; // significand
+    int digits = 0;           // significant digits accumulated into m
+    int exp10 = 0;            // decimal exponent
+    int negative = 0, any = 0;
+    char tmp[STR_LEN + 1];    // null terminated copy for the slow path
+    char *tail;
+    double d;
+    float f, g;
+
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    // integer part
+    for (; p < end && *p >= '0' && *p <= '9'; ++p, any = 1)
+    {
+        if (digits < 19)
+        {
+            m = m * 10 + (*p - '0');
+            digits += m > 0;
+        }
+        else
+            exp10++;
+    }
+
+    // fractional part
+    if (p < end && *p == '.')
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p, any = 1)
+        {
+            if (digits < 19)
+            {
+                m = m * 10 + (*p - '0');
+                digits += m > 0;
+                exp10--;
+            }
+        }
+
+    // exponent
+    if (any && p < end && (*p == 'e' || *p == 'E'))
+    {
+        int e = 0, e_negative = 0;
+        const char *e_start;
+
+        ++p;
+        if (p < end && (*p == '-' || *p == '+'))
+            e_negative = *p++ == '-';
+        for (e_start = p; p < end && *p >= '0' && *p <= '9'; ++p)
+            if (e < 100000)
+                e = e * 10 + (*p - '0');
+        if (p == e_start)
+            any = 0;
+        exp10 += e_negative ? -e : e;
+    }
+
+    // fast path, for plain numbers with few significant digits
+    if (any && p == end && digits < 19 && m < (1ULL << 53)
+            && exp10 >= -22 && exp10 <= 22)
+    {
+        d = exp10 < 0
+            ? (double) m / pow10_table[-exp10]
+            : (double) m * pow10_table[exp10];
+        f = (float) d;
+        g = nextafterf(f, d > f ? FLT_MAX : -FLT_MAX);
+
+        // exclude the double rounding case
+        if ((double) f == d || ((double) f + (double) g) / 2 != d)
+        {
+            *out = negative ? -f : f;
+            return 0;
+        }
+    }
+
+    // slow path, also handling special values such as inf and nan
+    if (len == 0 || len > STR_LEN)
+        return -1;
+    memcpy(tmp, s, len);
+    tmp[len] = '\0';
+    *out = strtof(tmp, &tail);
+    return *tail != '\0';
+}
+
+/*!
+ * Convert a string of decimal digits, rejecting values which do not fit
+ * into an unsigned int.
+ */
+int text_to_uint(const char *s, size_t len, unsigned int *out)
+{
+    unsigned long long v = 0;
+    size_t i;
+
+    if (len == 0)
+        return -1;
+    for (i = 0; i < len; ++i)
+    {
+        if (s[i] < '0' || s[i] > '9')
+            return -1;
+        v = v * 10 + (s[i] - '0');
+        if (v > 0xFFFFFFFFULL)
+            return -1;
+    }
+
+    *out = (unsigned int) v;
+    return 0;
+}
+
+/*!
+ * Move the unread part of the buffer at its beginning, then fill the rest
+ * with the next bytes from the stream.
+ */
+static void text_reader_fill(Text_reader *r)
+{
+    size_t n;
+
+    memmove(r->buf, r->buf + r->pos, r->size - r->pos);
+    r->size -= r->pos;
+    r->pos = 0;
+
+    n = fread(r->buf + r->size, 1, TEXT_BLOCK_SIZE - r->size, r->file);
+    r->size += n;
+    if (model_file_size > 0)
+        set_load_progress("Parsing",
+                (float) ftell(r->file) / model_file_size);
+    r->buf[r->size] = '\0';
+    if (r->size < TEXT_BLOCK_SIZE)
+        r->eof = 1;
+}
+
+/*!
+ * Return a pointer to the next whitespace separated token in the buffer,
+ * refilling it when needed, or NULL at the end of the stream. The length
+ * of the token is stored in `len`.
+ */
+static const char *text_reader_token(Text_reader *r, size_t *len)
+{
+    size_t end;
+
+    // skip whitespace
+    for (;;)
+    {
+        while (r->pos < r->size
+                && (r->buf[r->pos] == ' ' || r->buf[r->pos] == '\n'
+                    || r->buf[r->pos] == '\r' || r->buf[r->pos] == '\t'))
+            r->pos++;
+        if (r->pos < r->size || r->eof)
+            break;
+        text_reader_fill(r);
+    }
+    if (r->pos == r->size)
+        return NULL;
+
+    // find the token end, refilling if the token crosses the buffer end
+    end = r->pos;
+    for (;;)
+    {
+        while (end < r->size
+                && r->buf[end] != ' ' && r->buf[end] != '\n'
+                && r->buf[end] != '\r' && r->buf[end] != '\t')
+            end++;
+        if (end < r->size || r->eof || end - r->pos == TEXT_BLOCK_SIZE)
+            break;
+        end -= r->pos;
+        text_reader_fill(r);
+    }
+
+    *len = end - r->pos;
+    r->pos = end;
+    return r->buf + end - *len;
+}
+
+/*!
+ * Get the next token from the reader and convert it to float.
+ */
+int read_float(Text_reader *r, float *out)
+{
+    size_t len;
+    const char *t = text_reader_token(r, &len);
+    return t == NULL || text_to_float(t, len, out);
+}
+
+/*!
+ * Get the next token from the reader and convert it to unsigned int.
+ */
+int read_uint(Text_reader *r, unsigned int *out)
+{
+    size_t len;
+    const char *t = text_reader_token(r, &len);
+    return t == NULL || text_to_uint(t, len, out);
+}
+
+/*!
+ * Refill the buffer when it holds less than `n` unread bytes.
+ */
+const unsigned char *read_bytes(Text_reader *r, size_t n)
+{
+    const unsigned char *p;
+
+    if (r->size - r->pos < n && !r->eof)
+        text_reader_fill(r);
+    if (r->size - r->pos < n)
+        return NULL;
+
+    p = (const unsigned char*) r->buf + r->pos;
+    r->pos += n;
+    return p;
+}
+
+/*!
+ * Read a value of the given type, either as a token or as binary bytes,
+ * storing it in `out` unless it is NULL. List counts and vertex indices are
+ * read as integers, any other value as a float.
+ */
+static int read_ply_value(Text_reader *r, Ply_format format, Ply_type type,
+        int integer, double *out)
+{
+    const unsigned char *b;
+    size_t len;
+
+    if (format == PLY_ASCII)
+    {
+        const char *t = text_reader_token(r, &len);
+        unsigned int u;
+        float f;
+
+        if (t == NULL)
+            return -1;
+        if (out == NULL)
+            return 0;
+        if (integer ? text_to_uint(t, len, &u) : text_to_float(t, len, &f))
+            return -1;
+        *out = integer ? u : f;
+        return 0;
+    }
+
+    b = read_bytes(r, ply_type_size(type));
+    if (b == NULL)
+        return -1;
+    if (out != NULL)
+        *out = ply_get_value(b, type,
+                (format == PLY_BINARY_LE) != host_is_little_endian());
+    return 0;
+}
+
+/*!
+ * Faces are split as a fan around their first vertex, which is exact for
+ * convex polygons, such as the quads of most CAD exports. The orientation
+ * of the face is kept.
+ */
+int triangulate_polygon(const GLuint *polygon, int n, GLuint *out)
+{
+    int i;
+
+    for (i = 1; i < n - 1; ++i)
+    {
+        *out++ = polygon[0];
+        *out++ = polygon[i];
+        *out++ = polygon[i + 1];
+    }
+
+    return n > 2 ? n - 2 : 0;
+}
+
+/*!
+ * Generic reader for any record layout: every property is decoded
+ * according to its declared type, and only the ones stored in the model are
+ * converted. It is used for the layouts without a specialized decoder.
+ * Binary records without lists are taken from the buffer at once, as well
+ * as the items of binary lists, which must fit in the buffer.
+ */
+int read_ply_record(Text_reader *r, Ply_format format, const Ply_element *e,
+        float *values, GLuint *list, int max_list)
+{
+    const int swap = (format == PLY_BINARY_LE) != host_is_little_endian();
+    const Ply_property *p;
+    const unsigned char *b;
+    int n_list = 0, size;
+    double v, n;
+    long i;
+
+    if (format != PLY_ASCII && e->stride)
+    {
+        if ((b = read_bytes(r, e->stride)) == NULL)
+            return -1;
+        for (p = e->props; p < e->props + e->n_props; ++p)
+        {
+            if (p->slot != PLY_UNUSED)
+                values[p->slot] = (float) ply_get_value(b, p->type, swap);
+            b += ply_type_size(p->type);
+        }
+        return 0;
+    }
+
+    for (p = e->props; p < e->props + e->n_props; ++p)
+    {
+        if (!p->count_type)
+        {
+            if (read_ply_value(r, format, p->type, 0,
+                        p->slot == PLY_UNUSED ? NULL : &v))
+                return -1;
+            if (p->slot != PLY_UNUSED)
+                values[p->slot] = (float) v;
+            continue;
+        }
+
+        // list: count, then its items
+        if (read_ply_value(r, format, p->count_type, 1, &n)
+                || n < 0 || n > INT_MAX)
+            return -1;
+        if (p->slot == PLY_INDICES)
+            n_list = (int) n;
+
+        if (format != PLY_ASCII)
+        {
+            size = ply_type_size(p->type);
+            if (n * size > TEXT_BLOCK_SIZE
+                    || (b = read_bytes(r, (size_t) n * size)) == NULL)
+                return -1;
+            for (i = 0; p->slot == PLY_INDICES && i < (long) n
+                    && i < max_list; ++i, b += size)
+            {
+                v = ply_get_value(b, p->type, swap);
+                if (v < 0)
+                    return -1;
+                list[i] = (GLuint) v;
+            }
+            continue;
+        }
+
+        for (i = 0; i < (long) n; ++i)
+        {
+            if (read_ply_value(r, format, p->type, 1,
+                        p->slot == PLY_INDICES && i < max_list ? &v : NULL))
+                return -1;
+            if (p->slot == PLY_INDICES && i < max_list)
+                list[i] = (GLuint) v;
+        }
+    }
+
+    return n_list;
+}
+
+/*!
+ * Return nonzero if the machine running the program is little endian.
+ */
+int host_is_little_endian(void)
+{
+    const unsigned int one = 1;
+    return *(const unsigned char*) &one;
+}
+
+/*!
+ * Convert a value stored in a binary body into a double. The value is
+ * byte-swapped before the conversion when `swap` is nonzero.
+ */
+double ply_get_value(const unsigned char *p, Ply_type type, int swap)
+{
+    unsigned char b[8];
+    int size = ply_type_size(type);
+    int i;
+
+    // get a local copy of the bytes in host order, also fixing alignment
+    for (i = 0; i < size; ++i)
+        b[i] = swap ? p[size - 1 - i] : p[i];
+
+    switch (type)
+    {
+        case PLY_CHAR:   return *(signed char*) b;
+        case PLY_UCHAR:  return *(unsigned char*) b;
+        case PLY_SHORT:  { short v;          memcpy(&v, b, 2); return v; }
+        case PLY_USHORT: { unsigned short v; memcpy(&v, b, 2); return v; }
+        case PLY_INT:    { int v;            memcpy(&v, b, 4); return v; }
+        case PLY_UINT:   { unsigned int v;   memcpy(&v, b, 4); return v; }
+        case PLY_FLOAT:  { float v;          memcpy(&v, b, 4); return v; }
+        case PLY_DOUBLE: { double v;         memcpy(&v, b, 8); return v; }
+    }
+    return 0;
+}
+
+#if defined(__APPLE__) || defined(__linux__)
+/*!
+ * Add a fraction to the progress of the current loading stage. It can be
+ * called concurrently by several threads.
+ */
+static void add_load_progress(float delta)
+{
+    pthread_mutex_lock(&load_mutex);
+    load_progress += delta;
+    pthread_mutex_unlock(&load_mutex);
+}
+
+/*!
+ * Return nonzero if the character is a blank inside a line.
+ */
+static int is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/*!
+ * Return the next token inside the line ending at `end`, advancing `*p`
+ * after it, or NULL if the line contains no more tokens.
+ */
+static const char *line_token(const char **p, const char *end, size_t *len)
+{
+    const char *t;
+
+    while (*p < end && is_blank(**p))
+        (*p)++;
+    if (*p == end)
+        return NULL;
+
+    for (t = *p; *p < end && !is_blank(**p); (*p)++) {}
+    *len = *p - t;
+    return t;
+}
+
+/*!
+ * Return nonzero if the line between `p` and `end` contains a token.
+ */
+static int is_record(const char *p, const char *end)
+{
+    while (p < end && is_blank(*p))
+        p++;
+    return p < end;
+}
+
+/*!
+ * First pass over a chunk: count its records, i.e. its non empty lines.
+ */
+static void *count_records(void *arg)
+{
+    Parse_chunk *c = (Parse_chunk*) arg;
+    const char *p = c->begin, *eol;
+
+    c->n_records = 0;
+    while (p < c->end)
+    {
+        eol = memchr(p, '\n', c->end - p);
+        if (eol == NULL)
+            eol = c->end;
+        c->n_records += is_record(p, eol);
+        p = eol + 1;
+    }
+
+    return NULL;
+}
+
+/*!
+ * Parse a record of the given element from the line ending at `end`, like
+ * read_ply_record() does for a reader. Return the number of indices in the
+ * vertex list of the record, or -1 if the record is invalid.
+ */
+static int parse_line(const char *p, const char *end, const Ply_element *e,
+        float *values, GLuint *list, int max_list)
+{
+    const Ply_property *q;
+    const char *t;
+    unsigned int n, i, u;
+    int n_list = 0;
+    size_t len;
+
+    for (q = e->props; q < e->props + e->n_props; ++q)
+    {
+        if (!q->count_type)
+        {
+            t = line_token(&p, end, &len);
+            if (t == NULL || (q->slot != PLY_UNUSED
+                        && text_to_float(t, len, &values[q->slot])))
+                return -1;
+            continue;
+        }
+
+        // list: count, then its items
+        t = line_token(&p, end, &len);
+        if (t == NULL || text_to_uint(t, len, &n) || n > INT_MAX)
+            return -1;
+        for (i = 0; i < n; ++i)
+        {
+            t = line_token(&p, end, &len);
+            if (t == NULL)
+                return -1;
+            if (q->slot == PLY_INDICES && i < (unsigned int) max_list)
+            {
+                if (text_to_uint(t, len, &u))
+                    return -1;
+                list[i] = u;
+            }
+        }
+        if (q->slot == PLY_INDICES)
+            n_list = (int) n;
+    }
+
+    return n_list;
+}
+
+/*!
+ * Second pass over a chunk: parse each record into the model arrays, at the
+ * position given by its global index, and track the chunk bounding box.
+ * The element of each record follows from its index; records of elements
+ * other than vertex and face, and records following both, are skipped.
+ * Since each face takes the place of one triangle, the further triangles of
+ * polygons are collected in the chunk, and faces with less than three
+ * vertices are marked to be dropped.
+ */
+static void *parse_records(void *arg)
+{
+    Parse_chunk *c = (Parse_chunk*) arg;
+    const Ply_header *h = c->header;
+    const char *p = c->begin, *eol;
+    const char *reported = c->begin; // end of the part notified as parsed
+    long r = c->first_record;
+    long begin = 0, end = 0;         // global indices of element records
+    long vertex_begin = 0;           // global index of the first vertex
+    long last = 0;                   // end of the last element needed
+    long previewed, done;            // vertices added to preview
+    float values[9];
+    GLuint polygon[MAX_FACE_VERTICES];
+    int e = -1, k, n, line;
+
+    for (k = 0; k < 3; ++k)
+    {
+        c->max_coord[k] = -FLT_MAX;
+        c->min_coord[k] = FLT_MAX;
+    }
+    c->invalid = 0;
+
+    for (k = 0; k < h->n_elements; ++k)
+    {
+        if (k == h->vertex_element)
+            vertex_begin = last;
+        last += h->elements[k].count;
+        if (k == h->vertex_element || k == h->face_element)
+            end = last;
+    }
+    last = end;
+    end = 0;
+
+    previewed = c->first_record - vertex_begin;
+    previewed = previewed < 0 ? 0 : previewed > n_vertex ? n_vertex : previewed;
+
+    for (; p < c->end && r < last; p = eol + 1)
+    {
+        eol = memchr(p, '\n', c->end - p);
+        if (eol == NULL)
+            eol = c->end;
+        if (!is_record(p, eol))
+            continue;
+
+        // find the element of the record
+        while (r >= end)
+        {
+            begin = end;
+            end += h->elements[++e].count;
+        }
+
+        if (e == h->vertex_element)
+        {
+            // vertex record: each property stored in its component
+            if (parse_line(p, eol, &h->elements[e], values, NULL, 0) < 0)
+            {
+                c->invalid = 1;
+                return NULL;
+            }
+            for (k = 0; k < 3; ++k)
+            {
+                vertexp[(r - begin) * 3 + k] = values[k];
+                if (values[k] > c->max_coord[k])
+                    c->max_coord[k] = values[k];
+                if (values[k] < c->min_coord[k])
+                    c->min_coord[k] = values[k];
+                if (!normals_missing)
+                    normals[(r - begin) * 3 + k] = values[k + 3];
+                if (isColored)
+                    color[(r - begin) * 3 + k] = values[k + 6];
+            }
+        }
+        else if (e == h->face_element)
+        {
+            // face record: the first triangle goes in the place of the
+            // face, the other ones of a polygon are kept apart
+            GLuint *slot = indices + (r - begin) * 3;
+
+            n = parse_line(p, eol, &h->elements[e], values, polygon,
+                    MAX_FACE_VERTICES);
+            if (n < 0 || n > MAX_FACE_VERTICES)
+            {
+                c->invalid = 1;
+                return NULL;
+            }
+            if (n < 3)
+            {
+                slot[0] = slot[1] = slot[2] = (GLuint) -1;
+                c->n_dropped++;
+            }
+            else if (n == 3)
+                memcpy(slot, polygon, 3 * sizeof (GLuint));
+            else
+            {
+                if (c->n_extra + n - 2 > c->extra_size)
+                {
+                    c->extra_size = 2 * c->extra_size + n;
+                    line = __LINE__ + 1;
+                    c->extra = (GLuint*) realloc(c->extra,
+                            sizeof (GLuint) * 3 * c->extra_size);
+                    if (c->extra == NULL)
+                        error_handler("realloc", __func__, __FILE__, line);
+                }
+                triangulate_polygon(polygon, n, c->extra + c->n_extra * 3);
+                c->n_extra += n - 3;
+                memcpy(slot, c->extra + c->n_extra * 3, 3 * sizeof (GLuint));
+            }
+        }
+
+        // notify progress and show vertices from time to time
+        if (++r % PLY_CHUNK_RECORDS == 0)
+        {
+            add_load_progress((float) (eol - reported) / model_file_size);
+            reported = eol;
+            done = r - vertex_begin;
+            done = done < 0 ? 0 : done > n_vertex ? n_vertex : done;
+            if (previewed < done)
+            {
+                add_preview(vertexp + previewed * 3, 3 * sizeof (GLfloat),
+                        previewed, done - previewed);
+                previewed = done;
+            }
+        }
+    }
+
+    add_load_progress((float) (c->end - reported) / model_file_size);
+    done = r - vertex_begin;
+    done = done < 0 ? 0 : done > n_vertex ? n_vertex : done;
+    if (previewed < done)
+        add_preview(vertexp + previewed * 3, 3 * sizeof (GLfloat),
+                previewed, done - previewed);
+
+    return NULL;
+}
+#endif // defined(__APPLE__) || defined(__linux__)
+
+/*!
+ * Run a procedure on each task of an array, on a separate thread for each
+ * of them. Tasks which cannot be given to a new thread (all of them on
+ * platforms without threads) are processed by the caller.
+ */
+static void run_tasks(void *(*fun)(void *), void *tasks, size_t size, int n)
+{
+    char *t = (char*) tasks;
+    int i, created = 0;
+#if defined(__APPLE__) || defined(__linux__)
+    pthread_t threads[MAX_PARSE_THREADS];
+
+    for (; created < n && created < MAX_PARSE_THREADS; ++created)
+        if (pthread_create(&threads[created], NULL, fun, t + created * size))
+            break;
+#endif // defined(__APPLE__) || defined(__linux__)
+
+    for (i = created; i < n; ++i)
+        fun(t + i * size);
+
+#if defined(__APPLE__) || defined(__linux__)
+    for (i = 0; i < created; ++i)
+        pthread_join(threads[i], NULL);
+#endif // defined(__APPLE__) || defined(__linux__)
+}
+
+/*!
+ * The body is mapped in memory and split into one chunk of whole lines for
+ * each processor (or for each of `parse_threads` threads, if set). Since
+ * each vertex and face occupies exactly one line, a first parallel pass
+ * counting the records in each chunk is enough to know the global index of
+ * the first record of every chunk; a second parallel pass then parses the
+ * records, writing them directly in their final position inside the model
+ * arrays. Each thread tracks the bounding box of its own vertices, and the
+ * partial boxes are merged at the end, like the further triangles of
+ * polygonal faces, which are appended to the indices.
+ *
+ * Bodies smaller than two chunks of `PARSE_MIN_CHUNK` bytes are not worth
+ * the overhead and are left to the serial parser, like everything on
+ * platforms without mmap and threads.
+ */
+int parse_ascii_body_parallel(const Ply_header *header)
+{
+#if defined(__APPLE__) || defined(__linux__)
+    Parse_chunk chunks[MAX_PARSE_THREADS];
+    struct stat st;
+    long body, records, needed, total;
+    long n_dropped = 0;    // faces with less than three vertices
+    size_t n_extra = 0;    // further triangles of polygons
+    size_t size;
+    const char *map, *p, *end;
+    int n_threads, i, k, invalid = 0;
+
+    body = ftell(f_ply);
+    if (body < 0 || fstat(fileno(f_ply), &st) || st.st_size <= body)
+        return 1;
+    size = st.st_size - body;
+
+    n_threads = parse_threads ? parse_threads
+                              : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads > MAX_PARSE_THREADS)
+        n_threads = MAX_PARSE_THREADS;
+    if ((size_t) n_threads > size / PARSE_MIN_CHUNK)
+        n_threads = size / PARSE_MIN_CHUNK;
+    if (n_threads < 2)
+        return 1;
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f_ply), 0);
+    if (map == MAP_FAILED)
+        return 1;
+
+    // skip the rest of the end_header line
+    p = memchr(map + body, '\n', size);
+    p = p == NULL ? map + st.st_size : p + 1;
+    end = map + st.st_size;
+
+    // split the body at line boundaries
+    for (i = 0; i < n_threads; ++i)
+    {
+        chunks[i].begin = i == 0 ? p : chunks[i - 1].end;
+        if (i == n_threads - 1)
+            chunks[i].end = end;
+        else
+        {
+            const char *split = p + (end - p) / n_threads * (i + 1);
+            const char *eol;
+
+            if (split < chunks[i].begin)
+                split = chunks[i].begin;
+            eol = memchr(split, '\n', end - split);
+            chunks[i].end = eol == NULL ? end : eol + 1;
+        }
+    }
+
+    // count records in each chunk, then find the first one of each chunk
+    run_tasks(count_records, chunks, sizeof (Parse_chunk), n_threads);
+    records = 0;
+    for (i = 0; i < n_threads; ++i)
+    {
+        chunks[i].header = header;
+        chunks[i].extra = NULL;
+        chunks[i].n_extra = chunks[i].extra_size = 0;
+        chunks[i].n_dropped = 0;
+        chunks[i].first_record = records;
+        records += chunks[i].n_records;
+    }
+
+    // all the records up to the last element needed must be there
+    for (i = 0, needed = 0, total = 0; i < header->n_elements; ++i)
+    {
+        total += header->elements[i].count;
+        if (i == header->vertex_element || i == header->face_element)
+            needed = total;
+    }
+    if (records < needed)
+        invalid = 1;
+    else
+    {
+        run_tasks(parse_records, chunks, sizeof (Parse_chunk), n_threads);
+
+        // merge results
+        for (i = 0; i < n_threads; ++i)
+        {
+            invalid |= chunks[i].invalid;
+            n_extra += chunks[i].n_extra;
+            n_dropped += chunks[i].n_dropped;
+            for (k = 0; k < 3; ++k)
+            {
+                if (chunks[i].max_coord[k] > max_coord[k])
+                    max_coord[k] = chunks[i].max_coord[k];
+                if (chunks[i].min_coord[k] < min_coord[k])
+                    min_coord[k] = chunks[i].min_coord[k];
+            }
+        }
+    }
+
+    munmap((void*) map, st.st_size);
+
+    // drop the empty faces, then append the further triangles of polygons
+    if (!invalid && n_dropped > 0)
+    {
+        for (i = 0, total = 0; i < n_faces; ++i)
+            if (indices[(size_t) i * 3] != (GLuint) -1)
+                memmove(indices + total++ * 3, indices + (size_t) i * 3,
+                        3 * sizeof (GLuint));
+        n_faces = (int) total;
+    }
+    if (!invalid && n_extra > 0)
+    {
+        if ((size_t) n_faces + n_extra > INT_MAX / 3)
+        {
+            printf("Too many faces.\n");
+            invalid = 1;
+        }
+        else
+        {
+            resize_indices(3 * ((size_t) n_faces + n_extra));
+            for (i = 0; i < n_threads; ++i)
+            {
+                memcpy(indices + (size_t) n_faces * 3, chunks[i].extra,
+                        sizeof (GLuint) * 3 * chunks[i].n_extra);
+                n_faces += (int) chunks[i].n_extra;
+            }
+        }
+    }
+    for (i = 0; i < n_threads; ++i)
+        free(chunks[i].extra);
+
+    return invalid ? -1 : 0;
+#else // _WIN32
+    UNUSED(header);
+    return 1;
+#endif // defined(__APPLE__) || defined(__linux__)
+}
+
+/*!
+ * Define a decoder for a block of binary vertex records in host byte order,
+ * starting with the coordinates as floats, followed by the normal as floats
+ * when `NORMALS` is nonzero and by the color as uchar when `COLOR` is
+ * nonzero; further properties at the end of the record are skipped. Each
+ * layout gets its own function, where the compiler knows the position of
+ * every value.
+ */
+#define DEFINE_VERTEX_DECODER(name, NORMALS, COLOR) \
+static void name(const unsigned char *rec, int stride, size_t first, \
+        int count) \
+{ \
+    GLfloat f[(NORMALS) ? 6 : 3]; \
+    GLfloat *v = vertexp + first * 3; \
+    int j, k; \
+    \
+    for (j = 0; j < count; ++j, rec += stride, v += 3) \
+    { \
+        memcpy(f, rec, sizeof f); \
+        for (k = 0; k < 3; ++k) \
+        { \
+            v[k] = f[k]; \
+            if (f[k] > max_coord[k]) \
+                max_coord[k] = f[k]; \
+            if (f[k] < min_coord[k]) \
+                min_coord[k] = f[k]; \
+        } \
+        if (NORMALS) \
+            memcpy(normals + (first + j) * 3, f + 3, 3 * sizeof (GLfloat)); \
+        if (COLOR) \
+            for (k = 0; k < 3; ++k) \
+                color[(first + j) * 3 + k] = rec[sizeof f + k]; \
+    } \
+}
+
+DEFINE_VERTEX_DECODER(decode_vertex_p, 0, 0)
+DEFINE_VERTEX_DECODER(decode_vertex_pn, 1, 0)
+DEFINE_VERTEX_DECODER(decode_vertex_pc, 0, 1)
+DEFINE_VERTEX_DECODER(decode_vertex_pnc, 1, 1)
+
+/*!
+ * Define a decoder for a block of binary face records in host byte order,
+ * made only of the list of vertex indices, with the given count and index
+ * types. Decoding stops at the end of the block or at the first face which
+ * is not a triangle; the number of faces decoded is returned, and the
+ * number of bytes used is stored in `used`.
+ */
+#define DEFINE_FACE_DECODER(name, COUNT_T, INDEX_T) \
+static int name(const unsigned char *rec, size_t size, size_t first, \
+        int count, size_t *used) \
+{ \
+    const size_t stride = sizeof (COUNT_T) + 3 * sizeof (INDEX_T); \
+    INDEX_T t[3]; \
+    COUNT_T n; \
+    GLuint *out = indices + first * 3; \
+    int j; \
+    \
+    for (j = 0; j < count && size >= stride; ++j, size -= stride) \
+    { \
+        memcpy(&n, rec, sizeof n); \
+        if (n != 3) \
+            break; \
+        memcpy(t, rec + sizeof n, sizeof t); \
+        *out++ = (GLuint) t[0]; \
+        *out++ = (GLuint) t[1]; \
+        *out++ = (GLuint) t[2]; \
+        rec += stride; \
+    } \
+    *used = j * stride; \
+    return j; \
+}
+
+DEFINE_FACE_DECODER(decode_face_uchar_int, unsigned char, int)
+DEFINE_FACE_DECODER(decode_face_uchar_uint, unsigned char, unsigned int)
+DEFINE_FACE_DECODER(decode_face_int_int, int, int)
+DEFINE_FACE_DECODER(decode_face_uchar_ushort, unsigned char, unsigned short)
+
+/*!
+ * Type of the specialized vertex decoders.
+ */
+typedef void Vertex_decoder(const unsigned char*, int, size_t, int);
+
+/*!
+ * Type of the specialized face decoders.
+ */
+typedef int Face_decoder(const unsigned char*, size_t, size_t, int, size_t*);
+
+/*!
+ * Return the specialized decoder for the vertex records of a binary body,
+ * or NULL if their layout has none. The model components must come first,
+ * in their natural order, and any other property must follow them.
+ */
+static Vertex_decoder *vertex_decoder(const Ply_header *h)
+{
+    const Ply_element *e = &h->elements[h->vertex_element];
+    const int n_floats = h->has_normals ? 6 : 3;
+    const int n_used = n_floats + (h->is_colored ? 3 : 0);
+    int i;
+
+    if ((h->format == PLY_BINARY_LE) != host_is_little_endian()
+            || !e->stride || e->n_props < n_used)
+        return NULL;
+    for (i = 0; i < e->n_props; ++i)
+        if (e->props[i].slot != (i < n_used ? i : PLY_UNUSED)
+                || (i < n_used && e->props[i].type
+                    != (i < n_floats ? PLY_FLOAT : PLY_UCHAR)))
+            return NULL;
+
+    if (h->has_normals)
+        return h->is_colored ? decode_vertex_pnc : decode_vertex_pn;
+    return h->is_colored ? decode_vertex_pc : decode_vertex_p;
+}
+
+/*!
+ * Return the specialized decoder for the face records of a binary body, or
+ * NULL if their layout has none. The records must hold only the list of
+ * vertex indices.
+ */
+static Face_decoder *face_decoder(const Ply_header *h)
+{
+    const Ply_element *e = &h->elements[h->face_element];
+    Ply_type count_type = e->props[0].count_type;
+    Ply_type type = e->props[0].type;
+
+    if ((h->format == PLY_BINARY_LE) != host_is_little_endian()
+            || e->n_props != 1)
+        return NULL;
+    if (count_type == PLY_UCHAR && type == PLY_INT)
+        return decode_face_uchar_int;
+    if (count_type == PLY_UCHAR && type == PLY_UINT)
+        return decode_face_uchar_uint;
+    if (count_type == PLY_INT && type == PLY_INT)
+        return decode_face_int_int;
+    if (count_type == PLY_UCHAR && type == PLY_USHORT)
+        return decode_face_uchar_ushort;
+    return NULL;
+}
+
+/*!
+ * The elements are read in the order they are declared, through a buffered
+ * reader. Vertex and face records are decoded straight from its buffer by
+ * the specialized decoder for their layout, when there is one, and by
+ * read_ply_record() otherwise; the decoders handle the common layouts, so
+ * that they pay nothing for the generality of the format. Records of
+ * other elements are skipped, and reading ends after the vertices and
+ * faces.
+ *
+ * Polygonal faces are split into triangles by the generic reader, which
+ * also handles the records where a face decoder stops.
+ */
+int parse_binary_body(const Ply_header *header)
+{
+    Vertex_decoder *decode_vertices = vertex_decoder(header);
+    Face_decoder *decode_faces = face_decoder(header);
+    const Ply_element *e;
+    Text_reader reader;
+    float values[9] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+    GLuint polygon[MAX_FACE_VERTICES];
+    size_t n_triangles = 0, capacity = n_faces, used;
+    int i, chunk, n, line;
+    int remaining = 2;  // number of elements still to be read
+    int invalid = 0;
+
+    reader.file = f_ply;
+    reader.size = reader.pos = 0;
+    reader.eof = 0;
+    line = __LINE__ + 1;
+    reader.buf = (char*) malloc(TEXT_BLOCK_SIZE + 1);
+    if (reader.buf == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    for (e = header->elements; remaining > 0 && !invalid; ++e)
+    {
+        if (e - header->elements == header->vertex_element)
+        {
+            for (i = 0; i < n_vertex && !invalid; i += chunk)
+            {
+                if (decode_vertices == NULL)
+                {
+                    // generic layout, one record at a time
+                    chunk = n_vertex - i < PLY_CHUNK_RECORDS
+                            ? n_vertex - i : PLY_CHUNK_RECORDS;
+                    for (n = 0; n < chunk && !invalid; ++n)
+                    {
+                        invalid = read_ply_record(&reader, header->format,
+                                e, values, NULL, 0) < 0;
+                        store_vertex((size_t) i + n, values);
+                    }
+                }
+                else
+                {
+                    // the records available in the buffer at once
+                    if (reader.size - reader.pos < (size_t) e->stride)
+                        text_reader_fill(&reader);
+                    chunk = (reader.size - reader.pos) / e->stride;
+                    if (chunk > n_vertex - i)
+                        chunk = n_vertex - i;
+                    if (chunk > PLY_CHUNK_RECORDS)
+                        chunk = PLY_CHUNK_RECORDS;
+                    invalid = chunk == 0;
+                    decode_vertices((unsigned char*) reader.buf + reader.pos,
+                            e->stride, i, chunk);
+                    reader.pos += (size_t) chunk * e->stride;
+                }
+
+                // show the vertices read so far
+                if (!invalid)
+                    add_preview(vertexp + (size_t) i * 3,
+                            3 * sizeof (GLfloat), i, chunk);
+            }
+            remaining--;
+        }
+        else if (e - header->elements == header->face_element)
+        {
+            for (i = 0; i < e->count && !invalid; i += chunk)
+            {
+                chunk = 0;
+                if (decode_faces != NULL)
+                {
+                    if (reader.size - reader.pos < TEXT_BLOCK_SIZE / 2
+                            && !reader.eof)
+                        text_reader_fill(&reader);
+                    chunk = decode_faces(
+                            (unsigned char*) reader.buf + reader.pos,
+                            reader.size - reader.pos, n_triangles,
+                            (int) e->count - i, &used);
+                    reader.pos += used;
+                    n_triangles += chunk;
+                }
+
+                // the record the decoder stopped at, if any
+                if (chunk == 0)
+                {
+                    n = read_ply_record(&reader, header->format, e,
+                            values, polygon, MAX_FACE_VERTICES);
+                    invalid = n < 0;
+                    if (!invalid && store_face(polygon, n, &n_triangles,
+                                &capacity, e->count - i - 1))
+                    {
+                        free(reader.buf);
+                        return -1;
+                    }
+                    chunk = 1;
+                }
+            }
+            n_faces = (int) n_triangles;
+            remaining--;
+        }
+        else
+            for (i = 0; i < e->count && !invalid; ++i)
+                invalid = read_ply_record(&reader, header->format, e,
+                        values, NULL, 0) < 0;
+    }
+
+    free(reader.buf);
+
+    if (invalid)
+    {
+        printf("Unexpected end of file in model data.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+ * The whole file is mapped read-only and shared, so several viewer instances
+ * opening the same model share one copy of it in the page cache.
+ *
+ * The mapping is used only when the vertex element comes first, followed by
+ * the face element, and the vertex record starts with the coordinates and
+ * the normals, in this order, as floats in host byte order, optionally
+ * followed by the color components as uchar (float colors are scaled in
+ * place by init_model(void), which cannot be done in a read-only mapping).
+ * The records and the body must be aligned for floats. In that case the
+ * vertex, normal and color arrays point directly inside the mapping, with a
+ * stride equal to the record size, and only the indices are copied out of
+ * the face records, which must hold only the list of vertices.
+ *
+ * The arrays allocated while parsing the header are released on success.
+ * On failure nothing is changed and the file position is left untouched,
+ * so the caller can fall back to parse_binary_body().
+ */
+int map_binary_body(const Ply_header *header)
+{
+#if defined(__APPLE__) || defined(__linux__)
+    const Ply_element *ve = &header->elements[header->vertex_element];
+    const Ply_element *fe = &header->elements[header->face_element];
+    Face_decoder *decode_faces = face_decoder(header);
+    struct stat st;
+    long body;          // offset of the body from the start of the file
+    int stride = ve->stride; // size of a vertex record
+    int count_size = ply_type_size(fe->props[0].count_type);
+    int index_size = ply_type_size(fe->props[0].type);
+    size_t face_stride = count_size + 3 * index_size;
+    size_t used;
+    unsigned char *map, *faces, *rec;
+    int i, k;
+
+    // check that the layout is suitable for direct usage
+    if ((header->format == PLY_BINARY_LE) != host_is_little_endian()
+            || header->vertex_element != 0
+            || header->face_element != 1
+            || fe->n_props != 1
+            || !stride
+            || ve->n_props < (isColored ? 9 : 6))
+        return -1;
+    for (i = 0; i < (isColored ? 9 : 6); ++i)
+        if (ve->props[i].slot != i)
+            return -1;
+    for (i = 0; i < 6; ++i)
+        if (ve->props[i].type != PLY_FLOAT)
+            return -1;
+    if (isColored)
+        for (i = 6; i < 9; ++i)
+            if (ve->props[i].type != PLY_UCHAR)
+                return -1;
+
+    // check that the file contains the whole body, aligned for floats
+    body = ftell(f_ply);
+    if (body < 0 || fstat(fileno(f_ply), &st)
+            || stride % sizeof (GLfloat) || body % sizeof (GLfloat))
+        return -1;
+    if ((size_t) st.st_size < (size_t) body
+            + (size_t) n_vertex * stride
+            + (size_t) n_faces * face_stride)
+        return -1;
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fileno(f_ply), 0);
+    if (map == MAP_FAILED)
+        return -1;
+
+    // the vertices are available at once, show them while copying indices
+    add_preview(map + body, stride, 0, n_vertex);
+
+    // copy indices out of the face records
+    faces = map + body + (size_t) n_vertex * stride;
+    if (decode_faces != NULL)
+        i = decode_faces(faces, (size_t) n_faces * face_stride, 0, n_faces,
+                &used);
+    else
+        for (i = 0; i < n_faces; ++i)
+        {
+            rec = faces + (size_t) i * face_stride;
+            if (ply_get_value(rec, fe->props[0].count_type, 0) != 3)
+                break;
+            for (k = 0; k < 3; ++k)
+                indices[(size_t) i * 3 + k] = (GLuint) ply_get_value(
+                        rec + count_size + k * index_size,
+                        fe->props[0].type, 0);
+        }
+    if (i < n_faces)
+    {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    // point model arrays inside the mapping
+    free_array(vertexp);
+    free_array(normals);
+    free_array(color);
+    mapping = map;
+    mapping_size = st.st_size;
+    vertex_stride = stride;
+    vertexp = (GLfloat*) (map + body);
+    normals = (GLfloat*) (map + body + 3 * sizeof (GLfloat));
+    color = isColored ? (GLfloat*) (map + body + 6 * sizeof (GLfloat)) : NULL;
+    color_type = isColored ? GL_UNSIGNED_BYTE : GL_FLOAT;
+
+    // search greatest and smallest coords
+    for (i = 0; i < n_vertex; ++i)
+    {
+        GLfloat v[3];
+        memcpy(v, map + body + (size_t) i * stride, sizeof v);
+        for (k = 0; k < 3; ++k)
+        {
+            if (v[k] > max_coord[k])
+                max_coord[k] = v[k];
+            if (v[k] < min_coord[k])
+                min_coord[k] = v[k];
+        }
+    }
+
+    return 0;
+#else // _WIN32
+    UNUSED(header);
+    return -1;
+#endif // defined(__APPLE__) || defined(__linux__)
+}
+
+void set_crease_angle(float degrees)
+{
+    crease_angle = degrees;
+}
+
+void set_cache_writing(int enabled)
+{
+    cache_writing = enabled;
+}
+
+/*!
+ * Number of threads for a parallel pass over the faces, each one getting at
+ * least `NORMAL_MIN_FACES` faces.
+ */
+static int normal_threads(void)
+{
+    int n = 1;
+
+#if defined(__APPLE__) || defined(__linux__)
+    n = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > MAX_PARSE_THREADS)
+        n = MAX_PARSE_THREADS;
+    if (n > n_faces / NORMAL_MIN_FACES)
+        n = n_faces / NORMAL_MIN_FACES;
+#endif // defined(__APPLE__) || defined(__linux__)
+
+    return n < 1 ? 1 : n;
+}
+
+/*!
+ * Split the faces or the vertices into one range for each task.
+ */
+static void split_tasks(Normal_task *t, int n_tasks, int n_items)
+{
+    int i;
+
+    for (i = 0; i < n_tasks; ++i)
+    {
+        t[i].first = (int) ((long long) n_items * i / n_tasks);
+        t[i].end = (int) ((long long) n_items * (i + 1) / n_tasks);
+    }
+}
+
+/*!
+ * Return nonzero if all the vertices of a face exist.
+ */
+static int valid_face(int f)
+{
+    return indices[3 * f] < (GLuint) n_vertex
+           && indices[3 * f + 1] < (GLuint) n_vertex
+           && indices[3 * f + 2] < (GLuint) n_vertex;
+}
+
+/*!
+ * Compute the normal of each face of the range, as the cross product of
+ * two edges, whose length is twice the face area. Faces referring to
+ * missing vertices get a null normal.
+ */
+static void *face_normals_task(void *arg)
+{
+    Normal_task *t = (Normal_task*) arg;
+    GLfloat *n = t->face_normals + (size_t) t->first * 3;
+    int f;
+
+    for (f = t->first; f < t->end; ++f, n += 3)
+    {
+        const GLfloat *a, *b, *c;
+        float u[3], v[3];
+        int k;
+
+        if (!valid_face(f))
+        {
+            n[0] = n[1] = n[2] = 0;
+            continue;
+        }
+        a = vertexp + (size_t) indices[3 * f] * 3;
+        b = vertexp + (size_t) indices[3 * f + 1] * 3;
+        c = vertexp + (size_t) indices[3 * f + 2] * 3;
+        for (k = 0; k < 3; ++k)
+        {
+            u[k] = b[k] - a[k];
+            v[k] = c[k] - a[k];
+        }
+        n[0] = u[1] * v[2] - u[2] * v[1];
+        n[1] = u[2] * v[0] - u[0] * v[2];
+        n[2] = u[0] * v[1] - u[1] * v[0];
+    }
+
+    return NULL;
+}
+
+/*!
+ * Normalize the vectors of a range, leaving the null ones untouched.
+ */
+static void normalize_range(GLfloat *n, int count)
+{
+    int i;
+
+    for (i = 0; i < count; ++i, n += 3)
+    {
+        float length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        float inverse = length > 0 ? 1 / length : 0;
+        n[0] *= inverse;
+        n[1] *= inverse;
+        n[2] *= inverse;
+    }
+}
+
+/*!
+ * Sum the normals of the faces around each vertex of the range, then
+ * normalize them. When the corners around each vertex are listed, they are
+ * gathered for the vertices of the range only, so that each task reads
+ * just the faces around its own vertices and no synchronization is needed.
+ * Otherwise the task covers all the vertices, and scatters the normal of
+ * each face to its corners. Either way the faces are added in the order of
+ * their corners, so the result does not depend on the number of tasks.
+ */
+static void *vertex_normals_task(void *arg)
+{
+    Normal_task *t = (Normal_task*) arg;
+    const GLfloat *f;
+    GLfloat *n;
+    int v, j;
+
+    memset(normals + (size_t) t->first * 3, 0,
+            sizeof (GLfloat) * 3 * (t->end - t->first));
+    if (t->corner_first == NULL)
+        for (j = 0; j < n_faces * 3; ++j)
+        {
+            if (indices[j] >= (GLuint) n_vertex)
+                continue;
+            f = t->face_normals + (size_t) (j / 3) * 3;
+            n = normals + (size_t) indices[j] * 3;
+            n[0] += f[0];
+            n[1] += f[1];
+            n[2] += f[2];
+        }
+    else
+        for (v = t->first; v < t->end; ++v)
+        {
+            n = normals + (size_t) v * 3;
+            for (j = t->corner_first[v]; j < t->corner_first[v + 1]; ++j)
+            {
+                f = t->face_normals + (size_t) (t->corners[j] / 3) * 3;
+                n[0] += f[0];
+                n[1] += f[1];
+                n[2] += f[2];
+            }
+        }
+    normalize_range(normals + (size_t) t->first * 3, t->end - t->first);
+
+    return NULL;
+}
+
+/*!
+ * Group the corners of a vertex by their normal. The normal of a corner is
+ * the sum of the normals of the faces around the vertex forming with its
+ * own face an angle not larger than the crease angle; corners with equal
+ * normals share a group. Write the group of each corner and the normal of
+ * each group, and return the number of groups.
+ */
+static int crease_groups(const Normal_task *t, int v, int *group,
+        GLfloat *group_normals)
+{
+    const int *corners = t->corners + t->corner_first[v];
+    const int n = t->corner_first[v + 1] - t->corner_first[v];
+    const int m = t->max_corners + 1;
+    GLfloat *face = group_normals + 3 * m; // face normals, contiguous
+    float *length = group_normals + 6 * m; // face normal lengths
+    int i, j, g, n_groups = 0;
+
+    for (i = 0; i < n; ++i)
+    {
+        memcpy(face + 3 * i,
+                t->face_normals + (size_t) (corners[i] / 3) * 3,
+                sizeof (GLfloat) * 3);
+        length[i] = sqrt(face[3 * i] * face[3 * i]
+                         + face[3 * i + 1] * face[3 * i + 1]
+                         + face[3 * i + 2] * face[3 * i + 2]);
+    }
+
+    for (i = 0; i < n; ++i)
+    {
+        const GLfloat *a = face + 3 * i;
+        const float limit = t->cos_crease * length[i];
+        GLfloat sum[3] = {0, 0, 0};
+
+        for (j = 0; j < n; ++j)
+        {
+            const GLfloat *b = face + 3 * j;
+            if (a[0] * b[0] + a[1] * b[1] + a[2] * b[2] >= limit * length[j])
+            {
+                sum[0] += b[0];
+                sum[1] += b[1];
+                sum[2] += b[2];
+            }
+        }
+        normalize_range(sum, 1);
+
+        for (g = 0; g < n_groups; ++g)
+            if (!memcmp(group_normals + g * 3, sum, sizeof sum))
+                break;
+        if (g == n_groups)
+            memcpy(group_normals + 3 * n_groups++, sum, sizeof sum);
+        group[i] = g;
+    }
+
+    return n_groups;
+}
+
+/*!
+ * Allocate the scratch arrays of crease_groups() for a task: the groups
+ * of the corners and, for each corner, the normal of its group, the normal
+ * of its face and the length of the latter.
+ */
+static void alloc_crease_scratch(const Normal_task *t, int **group,
+        GLfloat **group_normals)
+{
+    int line;
+
+    line = __LINE__ + 1;
+    *group = (int*) malloc(sizeof (int) * (t->max_corners + 1));
+    if (*group == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    *group_normals = (GLfloat*) malloc(
+            sizeof (GLfloat) * 7 * (t->max_corners + 1));
+    if (*group_normals == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+}
+
+/*!
+ * Count the copies needed by each vertex of the range, one for each group
+ * of its corners.
+ */
+static void *count_split_task(void *arg)
+{
+    Normal_task *t = (Normal_task*) arg;
+    GLfloat *group_normals;
+    int *group;
+    int v;
+
+    alloc_crease_scratch(t, &group, &group_normals);
+    for (v = t->first; v < t->end; ++v)
+    {
+        t->split_first[v] = crease_groups(t, v, group, group_normals);
+        if (t->split_first[v] == 0) // unused vertex, kept as it is
+            t->split_first[v] = 1;
+    }
+    free(group);
+    free(group_normals);
+
+    return NULL;
+}
+
+/*!
+ * Write the copies of each vertex of the range, with the normal of their
+ * group, and point the corners of the vertex to them.
+ */
+static void *write_split_task(void *arg)
+{
+    Normal_task *t = (Normal_task*) arg;
+    GLfloat *group_normals;
+    int *group;
+    int v, i, g;
+
+    alloc_crease_scratch(t, &group, &group_normals);
+    for (v = t->first; v < t->end; ++v)
+    {
+        const int first = t->split_first[v];
+        const int n = t->split_first[v + 1] - first;
+
+        if (crease_groups(t, v, group, group_normals) == 0)
+            group_normals[0] = group_normals[1] = group_normals[2] = 0;
+        for (i = t->corner_first[v]; i < t->corner_first[v + 1]; ++i)
+            indices[t->corners[i]] = first + group[i - t->corner_first[v]];
+
+        for (g = 0; g < n; ++g)
+        {
+            memcpy(t->split_vertexp + (size_t) (first + g) * 3,
+                    vertexp + (size_t) v * 3, sizeof (GLfloat) * 3);
+            memcpy(t->split_normals + (size_t) (first + g) * 3,
+                    group_normals + g * 3, sizeof (GLfloat) * 3);
+            if (isColored)
+                memcpy(t->split_color + (size_t) (first + g) * 3,
+                        color + (size_t) v * 3, sizeof (GLfloat) * 3);
+        }
+    }
+    free(group);
+    free(group_normals);
+
+    return NULL;
+}
+
+/*!
+ * List the corners around each vertex through a counting sort: the corners
+ * of vertex v are <code>corners[corner_first[v]]</code> up to
+ * <code>corners[corner_first[v + 1] - 1]</code>, in increasing order.
+ * Corners referring to missing vertices are left out. Return the maximum
+ * number of corners of a vertex.
+ */
+static int list_corners(int **corner_first, int **corners)
+{
+    int *first, *list;
+    int i, v, max = 0, line;
+
+    line = __LINE__ + 1;
+    first = (int*) calloc(n_vertex + 1, sizeof (int));
+    if (first == NULL)
+        error_handler("calloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    list = (int*) malloc(sizeof (int) * 3 * n_faces);
+    if (list == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    for (i = 0; i < n_faces * 3; ++i)
+        if (indices[i] < (GLuint) n_vertex)
+            first[indices[i] + 1]++;
+    for (v = 0; v < n_vertex; ++v)
+    {
+        if (first[v + 1] > max)
+            max = first[v + 1];
+        first[v + 1] += first[v];
+    }
+    for (i = 0; i < n_faces * 3; ++i)
+        if (indices[i] < (GLuint) n_vertex)
+            list[first[indices[i]]++] = i;
+    memmove(first + 1, first, sizeof (int) * n_vertex);
+    first[0] = 0;
+
+    *corner_first = first;
+    *corners = list;
+    return max;
+}
+
+/*!
+ * Split the vertices on the creases. Each vertex is replaced by one copy
+ * for each group of its corners with the same normal, in two parallel
+ * passes over the vertices: the first one counts the copies, the second
+ * one, once their position is known, writes them.
+ */
+static void split_creases(Normal_task *t, int n_tasks)
+{
+    int *split_first;
+    int i, v, n_split, line;
+
+    line = __LINE__ + 1;
+    split_first = (int*) malloc(sizeof (int) * (n_vertex + 1));
+    if (split_first == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    for (i = 0; i < n_tasks; ++i)
+    {
+        t[i].cos_crease = cos(crease_angle * PI / 180);
+        t[i].split_first = split_first;
+    }
+    split_tasks(t, n_tasks, n_vertex);
+
+    // number and position of the copies of each vertex
+    run_tasks(count_split_task, t, sizeof (Normal_task), n_tasks);
+    for (v = 0, n_split = 0; v < n_vertex; ++v)
+    {
+        int n = split_first[v];
+        split_first[v] = n_split;
+        n_split += n;
+    }
+    split_first[n_vertex] = n_split;
+
+    line = __LINE__ + 1;
+    t[0].split_vertexp = (GLfloat*) malloc(sizeof (GLfloat) * 3 * n_split);
+    if (t[0].split_vertexp == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    t[0].split_normals = (GLfloat*) malloc(sizeof (GLfloat) * 3 * n_split);
+    if (t[0].split_normals == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    t[0].split_color = NULL;
+    if (isColored)
+    {
+        line = __LINE__ + 1;
+        t[0].split_color = (GLfloat*) malloc(
+                sizeof (GLfloat) * 3 * n_split);
+        if (t[0].split_color == NULL)
+            error_handler("malloc", __func__, __FILE__, line);
+    }
+    for (i = 1; i < n_tasks; ++i)
+    {
+        t[i].split_vertexp = t[0].split_vertexp;
+        t[i].split_normals = t[0].split_normals;
+        t[i].split_color = t[0].split_color;
+    }
+
+    run_tasks(write_split_task, t, sizeof (Normal_task), n_tasks);
+
+    free_array(vertexp);
+    free_array(normals);
+    free_array(color);
+    vertexp = t[0].split_vertexp;
+    normals = t[0].split_normals;
+    color = t[0].split_color;
+    n_vertex = n_split;
+
+    free(split_first);
+}
+
+/*!
+ * Face normals are computed first, in parallel over the faces. Without a
+ * crease angle, each vertex normal is then the sum of the normals of its
+ * faces, which weights them by their area, normalized. With several
+ * threads, the corners around each vertex are listed with list_corners(),
+ * and the sum is computed in parallel over ranges of vertices, each one
+ * reading only the faces around its vertices; a single thread rather adds
+ * each face to its vertices, saving the listing. With a crease angle, the
+ * corners are always listed, and the vertices where faces meet at a
+ * sharper angle are split with split_creases(), so that the edge keeps a
+ * different normal on each side.
+ *
+ * Vertices not used by any face get a null normal.
+ */
+void compute_normals(void)
+{
+    Normal_task t[MAX_PARSE_THREADS];
+    int n_tasks = normal_threads();
+    int *corner_first = NULL, *corners = NULL; // corners around vertices
+    int max_corners = 0;
+    int crease;                   // nonzero to split the vertices
+    int i, line;
+
+    set_load_progress("Computing normals", 0);
+
+    memset(t, 0, sizeof (t));
+    line = __LINE__ + 1;
+    t[0].face_normals = (GLfloat*) malloc(sizeof (GLfloat) * 3 * n_faces);
+    if (t[0].face_normals == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    for (i = 1; i < n_tasks; ++i)
+        t[i].face_normals = t[0].face_normals;
+
+    split_tasks(t, n_tasks, n_faces);
+    run_tasks(face_normals_task, t, sizeof (Normal_task), n_tasks);
+
+    // creases need all the corners around each vertex, i.e. valid indices
+    for (i = 0; i < n_faces && valid_face(i); ++i) {}
+    crease = crease_angle > 0 && crease_angle < 180 && i == n_faces;
+    if (crease || n_tasks > 1)
+        max_corners = list_corners(&corner_first, &corners);
+    for (i = 0; i < n_tasks; ++i)
+    {
+        t[i].corner_first = corner_first;
+        t[i].corners = corners;
+        t[i].max_corners = max_corners;
+    }
+
+    if (crease)
+        split_creases(t, n_tasks);
+    else
+    {
+        split_tasks(t, n_tasks, n_vertex);
+        run_tasks(vertex_normals_task, t, sizeof (Normal_task), n_tasks);
+    }
+
+    free(corner_first);
+    free(corners);
+    free(t[0].face_normals);
+}
+
+/*!
+ * The indices are fed to a simulated FIFO cache of `cache_size` entries,
+ * counting each index not found in the cache as a miss.
+ */
+float compute_acmr(int cache_size)
+{
+    int *fifo;      // cache entries, as a circular buffer
+    int *in_cache;  // last time each vertex entered the cache, or -1
+    int head = 0;   // next cache entry to be replaced
+    int misses = 0;
+    int i, line;
+
+    if (n_faces == 0)
+        return 0;
+
+    line = __LINE__ + 1;
+    fifo = (int*) malloc(sizeof (int) * cache_size);
+    if (fifo == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    in_cache = (int*) malloc(sizeof (int) * n_vertex);
+    if (in_cache == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    for (i = 0; i < cache_size; ++i)
+        fifo[i] = -1;
+    for (i = 0; i < n_vertex; ++i)
+        in_cache[i] = -1;
+
+    // a vertex is in cache iff its slot has not been overwritten since
+    for (i = 0; i < n_faces * 3; ++i)
+    {
+        int v = indices[i];
+        if (in_cache[v] < 0 || fifo[in_cache[v]] != v)
+        {
+            misses++;
+            fifo[head] = v;
+            in_cache[v] = head;
+            head = (head + 1) % cache_size;
+        }
+    }
+
+    free(fifo);
+    free(in_cache);
+
+    return (float) misses / n_faces;
+}
+
+/*!
+ * Triangles are reordered with the Tipsify algorithm (Sander, Nehab and
+ * Barczak, "Fast triangle reordering for vertex locality and reduced
+ * overdraw", 2007), which fans around a vertex at a time, choosing the next
+ * fanning vertex among the recently used ones still having triangles to be
+ * emitted, so that its triangles are likely to hit the cache. It runs in
+ * linear time.
+ *
+ * Vertices are then renumbered in order of first usage by the new index
+ * sequence, so that vertex fetch proceeds almost sequentially. This step is
+ * skipped when the model arrays are interleaved, i.e. pointing inside a
+ * read-only file mapping.
+ *
+ * The average cache miss ratio is printed before and after the pass. The
+ * model is left untouched if `optimize_vertex_cache` is zero or the model
+ * contains invalid indices.
+ */
+void optimize_model(void)
+{
+    int *offset;     // start of the triangle list of each vertex
+    int *adjacency;  // triangles adjacent to each vertex
+    int *live;       // number of triangles still to emit for each vertex
+    int *cache_time; // time each vertex entered the cache
+    int *dead_end;   // stack of recently used vertices
+    char *emitted;   // nonzero for triangles already emitted
+    GLuint *output;  // reordered indices
+    int n_dead = 0, n_out = 0;
+    int time, cursor = 1, f = 0;
+    int i, j, k, line;
+    float acmr_before;
+
+    if (!optimize_vertex_cache || n_faces == 0 || n_vertex == 0)
+        return;
+    for (i = 0; i < n_faces * 3; ++i)
+        if (indices[i] >= (GLuint) n_vertex)
+            return;
+
+    acmr_before = compute_acmr(VERTEX_CACHE_SIZE);
+
+    line = __LINE__ + 1;
+    offset = (int*) calloc(n_vertex + 1, sizeof (int));
+    if (offset == NULL)
+        error_handler("calloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    adjacency = (int*) malloc(sizeof (int) * n_faces * 3);
+    if (adjacency == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    live = (int*) calloc(n_vertex, sizeof (int));
+    if (live == NULL)
+        error_handler("calloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    cache_time = (int*) calloc(n_vertex, sizeof (int));
+    if (cache_time == NULL)
+        error_handler("calloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    dead_end = (int*) malloc(sizeof (int) * n_faces * 3);
+    if (dead_end == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    emitted = (char*) calloc(n_faces, sizeof (char));
+    if (emitted == NULL)
+        error_handler("calloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    output = (GLuint*) malloc(sizeof (GLuint) * n_faces * 3);
+    if (output == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    // build vertex-triangle adjacency, with a counting sort
+    for (i = 0; i < n_faces * 3; ++i)
+        live[indices[i]]++;
+    for (i = 0; i < n_vertex; ++i)
+        offset[i + 1] = offset[i] + live[i];
+    for (i = 0; i < n_faces * 3; ++i)
+        adjacency[offset[indices[i]] + cache_time[indices[i]]++] = i / 3;
+    memset(cache_time, 0, sizeof (int) * n_vertex);
+
+    time = VERTEX_CACHE_SIZE + 1;
+    while (f >= 0)
+    {
+        int best = -1, best_priority = -1;
+        int ring_start = n_dead;
+
+        // emit all the remaining triangles around the fanning vertex
+        for (i = offset[f]; i < offset[f + 1]; ++i)
+        {
+            int t = adjacency[i];
+            if (emitted[t])
+                continue;
+            for (k = 0; k < 3; ++k)
+            {
+                int v = indices[t * 3 + k];
+                output[n_out++] = v;
+                dead_end[n_dead++] = v;
+                live[v]--;
+                if (time - cache_time[v] > VERTEX_CACHE_SIZE)
+                    cache_time[v] = time++;
+            }
+            emitted[t] = 1;
+        }
+
+        // choose next fanning vertex among the 1-ring of the current one:
+        // prefer vertices still in cache after emitting their triangles
+        for (i = ring_start; i < n_dead; ++i)
+        {
+            int v = dead_end[i];
+            int priority = 0;
+            if (live[v] <= 0)
+                continue;
+            if (time - cache_time[v] + 2 * live[v] <= VERTEX_CACHE_SIZE)
+                priority = time - cache_time[v];
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                best = v;
+            }
+        }
+
+        // dead end: fall back to recently used vertices, then to the
+        // next vertex in input order still having triangles
+        if (best < 0)
+        {
+            while (n_dead > 0 && best < 0)
+                if (live[dead_end[--n_dead]] > 0)
+                    best = dead_end[n_dead];
+            while (best < 0 && cursor < n_vertex)
+                if (live[cursor++] > 0)
+                    best = cursor - 1;
+        }
+
+        f = best;
+    }
+
+    memcpy(indices, output, sizeof (GLuint) * n_faces * 3);
+
+    // renumber vertices in order of first usage
+    if (!vertex_stride)
+    {
+        int *new_index = live; // reuse storage, all counters are zero now
+        int n_new = 0;
+        GLfloat *tmp;
+
+        for (i = 0; i < n_vertex; ++i)
+            new_index[i] = -1;
+        for (i = 0; i < n_faces * 3; ++i)
+            if (new_index[indices[i]] < 0)
+                new_index[indices[i]] = n_new++;
+        for (i = 0; i < n_vertex; ++i)
+            if (new_index[i] < 0)
+                new_index[i] = n_new++;
+        for (i = 0; i < n_faces * 3; ++i)
+            indices[i] = new_index[indices[i]];
+
+        // permute each array through a temporary copy
+        line = __LINE__ + 1;
+        tmp = (GLfloat*) malloc(sizeof (GLfloat) * n_vertex * 3);
+        if (tmp == NULL)
+            error_handler("malloc", __func__, __FILE__, line);
+        for (j = 0; j < 3; ++j)
+        {
+            GLfloat *array = j == 0 ? vertexp : (j == 1 ? normals : color);
+            if (array == NULL)
+                continue;
+            for (i = 0; i < n_vertex; ++i)
+                for (k = 0; k < 3; ++k)
+                    tmp[new_index[i] * 3 + k] = array[i * 3 + k];
+            memcpy(array, tmp, sizeof (GLfloat) * n_vertex * 3);
+        }
+        free(tmp);
+    }
+
+    free(offset);
+    free(adjacency);
+    free(live);
+    free(cache_time);
+    free(dead_end);
+    free(emitted);
+    free(output);
+
+    printf("Vertex cache ACMR: %.3f before, %.3f after optimization.\n",
+            acmr_before,
+            compute_acmr(VERTEX_CACHE_SIZE));
+}
+
+/*!
+ * Set the initial camera distance, out of the bounding box of the model.
+ */
+void init_camera(void)
+{
+    eye.rho = INITIAL_DISTANCE_RATIO * bb_radius;
+
+    // scale initial position for very small models
+    if (bb_radius < MIN_BB_RADIUS)
+        eye.rho *= MIN_BB_RADIUS / bb_radius;
+}
+
+/*!
+ * Compute the center of a bounding box and its radius, used to place the
+ * model and the camera.
+ */
+static void bounding_sphere(const float max[3], const float min[3],
+        Vector_3D *c, float *radius)
+{
+    // find the center of the model bounding box
+    c->x = (max[0] + min[0]) / 2;
+    c->y = (max[1] + min[1]) / 2;
+    c->z = (max[2] + min[2]) / 2;
+
+    // set bounding box radius
+    *radius = 1.0f / 4.0f * sqrt(
+              (max[0] - min[0]) * (max[0] - min[0])
+            + (max[1] - min[1]) * (max[1] - min[1])
+            + (max[2] - min[2]) * (max[2] - min[2]));
+}
+
+/*!
+ * This procedure determines the bounding box center and radius. Radius
+ * is also used to to setup initial camera position by init_camera(void),
+ * which is not called here, so that a reloaded model keeps the camera.
+ */
+void frame_model(const Mesh *m)
+{
+    bounding_sphere(m->max_coord, m->min_coord, &center, &bb_radius);
+}
+
+/*!
+ * If the model is colored, this procedure converts the color from
+ * [0, 255] to [0, 1]. The model is framed only when it is published,
+ * since the model shown meanwhile is still drawn.
+ */
+void init_model(void)
+{
+    const size_t stride = vertex_stride ? (size_t) vertex_stride
+                                        : 3 * sizeof (GLfloat);
+    int i, k;
+
+    // convert color into [0,1] (byte colors are normalized by OpenGL)
+    if (isColored && color_type == GL_FLOAT)
+        for(i = 0; i < n_vertex; i++)
+        {
+            GLfloat *c = (GLfloat*) ((char*) color + i * stride);
+            for (k = 0; k < 3; k++)
+                c[k] /= 255;
+        }
+}
+
+/*!
+ * Reset the model globals to their initial values, without releasing
+ * anything.
+ */
+static void reset_model(void)
+{
+    int k;
+
+    vertexp = normals = color = NULL;
+    indices = NULL;
+    n_vertex = n_faces = 0;
+    isColored = 1;
+    vertex_stride = 0;
+    normal_type = GL_FLOAT;
+    color_type = GL_FLOAT;
+    element_type = GL_UNSIGNED_INT;
+    n_lod = 0;
+    memset(&clusters, 0, sizeof (clusters));
+    mapping = cache_mapping = arena = NULL;
+    mapping_size = cache_mapping_size = arena_size = 0;
+    vertex_buffer = index_buffer = 0;
+    vertex_ptr = normal_ptr = color_ptr = index_ptr = NULL;
+    chunked_model = 0;
+    for (k = 0; k < 3; ++k)
+    {
+        max_coord[k] = -FLT_MAX;
+        min_coord[k] = FLT_MAX;
+    }
+}
+
+/*!
+ * The model may own, depending on how it was loaded:
+ * - an arena, holding its arrays when parsed, decoded or packed;
+ * - a mapping of the model file, holding its vertex arrays;
+ * - a mapping of the cache file, holding its arrays and cluster data;
+ * - arrays allocated on their own, e.g. when they grew out of the arena;
+ * - cluster data, buffer objects and, if chunked, the chunk hierarchy.
+ * Each array is released unless it lies in one of the blocks, which are
+ * released as a whole.
+ */
+void release_model(void)
+{
+    if (chunked_model)
+        close_chunks();
+
+    if (vertex_buffer)
+        glDeleteBuffers(1, &vertex_buffer);
+    if (index_buffer)
+        glDeleteBuffers(1, &index_buffer);
+
+    if (!in_block(clusters.center[0], cache_mapping, cache_mapping_size))
+        free(clusters.center[0]);
+    if (!in_block(clusters.first, cache_mapping, cache_mapping_size))
+        free(clusters.first);
+    free(clusters.draw_start);
+
+    // interleaved arrays lie in a block, separate ones may not
+    if (!vertex_stride)
+    {
+        free_array(vertexp);
+        free_array(normals);
+        free_array(color);
+    }
+    if (!in_block(indices, cache_mapping, cache_mapping_size))
+        free_array(indices);
+
+    #if defined(__APPLE__) || defined(__linux__)
+    if (mapping != NULL)
+        munmap(mapping, mapping_size);
+    if (cache_mapping != NULL)
+        munmap(cache_mapping, cache_mapping_size);
+    #endif // defined(__APPLE__) || defined(__linux__)
+    free(arena);
+
+    reset_model();
+}
+
+/*!
+ * The mesh is made current, then released with release_model(void).
+ */
+void release_mesh(Mesh *m)
+{
+    select_mesh(m);
+    release_model();
+    store_mesh(m);
+}
+
+/*!
+ * The mesh takes the ownership of the model arrays, mappings and buffer
+ * objects, and the model globals are reset to their initial values, so
+ * that another model can be loaded.
+ */
+void store_mesh(Mesh *m)
+{
+    m->vertexp = vertexp;
+    m->normals = normals;
+    m->color = color;
+    m->indices = indices;
+    m->n_vertex = n_vertex;
+    m->n_faces = n_faces;
+    m->is_colored = isColored;
+    m->chunked = chunked_model;
+    m->vertex_stride = vertex_stride;
+    m->normal_type = normal_type;
+    m->color_type = color_type;
+    m->element_type = element_type;
+    memcpy(m->lod, lod, sizeof (lod));
+    m->n_lod = n_lod;
+    m->clusters = clusters;
+    m->mapping = mapping;
+    m->mapping_size = mapping_size;
+    m->cache_mapping = cache_mapping;
+    m->cache_mapping_size = cache_mapping_size;
+    m->arena = arena;
+    m->arena_size = arena_size;
+    m->vertex_buffer = vertex_buffer;
+    m->index_buffer = index_buffer;
+    m->vertex_ptr = vertex_ptr;
+    m->normal_ptr = normal_ptr;
+    m->color_ptr = color_ptr;
+    m->index_ptr = index_ptr;
+    memcpy(m->max_coord, max_coord, sizeof (max_coord));
+    memcpy(m->min_coord, min_coord, sizeof (min_coord));
+
+    reset_model();
+}
+
+/*!
+ * The model globals point to the arrays of the mesh, which keeps their
+ * ownership: the mesh must be stored back with store_mesh(Mesh*) if they
+ * are changed (e.g. uploaded). Center and radius of the bounding box are
+ * not computed again, so that the meshes of a scene can be drawn in turn
+ * in the frame of the whole scene.
+ */
+void select_mesh(const Mesh *m)
+{
+    vertexp = m->vertexp;
+    normals = m->normals;
+    color = m->color;
+    indices = m->indices;
+    n_vertex = m->n_vertex;
+    n_faces = m->n_faces;
+    isColored = m->is_colored;
+    chunked_model = m->chunked;
+    vertex_stride = m->vertex_stride;
+    normal_type = m->normal_type;
+    color_type = m->color_type;
+    element_type = m->element_type;
+    memcpy(lod, m->lod, sizeof (lod));
+    n_lod = m->n_lod;
+    clusters = m->clusters;
+    mapping = m->mapping;
+    mapping_size = m->mapping_size;
+    cache_mapping = m->cache_mapping;
+    cache_mapping_size = m->cache_mapping_size;
+    arena = m->arena;
+    arena_size = m->arena_size;
+    vertex_buffer = m->vertex_buffer;
+    index_buffer = m->index_buffer;
+    vertex_ptr = m->vertex_ptr;
+    normal_ptr = m->normal_ptr;
+    color_ptr = m->color_ptr;
+    index_ptr = m->index_ptr;
+    memcpy(max_coord, m->max_coord, sizeof (max_coord));
+    memcpy(min_coord, m->min_coord, sizeof (min_coord));
+}
+
+/*!
+ * Return the address of the i-th tuple of a model array, taking into
+ * account the interleaving of the arrays.
+ */
+static const char *tuple_at(const void *array, int i, size_t tuple_size)
+{
+    return (const char*) array
+           + (size_t) i * (vertex_stride ? (size_t) vertex_stride : tuple_size);
+}
+
+/*!
+ * Return the number of indices stored in the index array, including the
+ * ones of all the levels of detail.
+ */
+static int total_indices(void)
+{
+    return n_lod ? lod[n_lod - 1].first + lod[n_lod - 1].count : n_faces * 3;
+}
+
+/*!
+ * Normals and colors are converted from the types of the packed format,
+ * and colors from [0, 255] when they are still integer values.
+ */
+void get_vertex(int i, float position[3], float normal[3], float rgb[3])
+{
+    int k;
+
+    memcpy(position, tuple_at(vertexp, i, 3 * sizeof (GLfloat)),
+            3 * sizeof (GLfloat));
+
+    if (normal_type == GL_BYTE)
+        for (k = 0; k < 3; ++k)
+            normal[k] = ((const GLbyte*) tuple_at(normals, i, 3))[k] / 127.0f;
+    else
+        memcpy(normal, tuple_at(normals, i, 3 * sizeof (GLfloat)),
+                3 * sizeof (GLfloat));
+
+    if (!isColored)
+        return;
+    if (color_type == GL_UNSIGNED_BYTE)
+        for (k = 0; k < 3; ++k)
+            rgb[k] = ((const GLubyte*) tuple_at(color, i, 3))[k]
+                           / 255.0f;
+    else
+        memcpy(rgb, tuple_at(color, i, 3 * sizeof (GLfloat)),
+                3 * sizeof (GLfloat));
+}
+
+GLuint get_index(int i)
+{
+    return element_type == GL_UNSIGNED_SHORT ? ((const GLushort*) indices)[i]
+                                             : indices[i];
+}
+
+/*!
+ * Sort three indices in ascending order.
+ */
+static void sort_triple(GLuint *t)
+{
+    GLuint tmp;
+    int k;
+
+    for (k = 0; k < 3; ++k)
+        if (t[k % 2] > t[k % 2 + 1])
+        {
+            tmp = t[k % 2];
+            t[k % 2] = t[k % 2 + 1];
+            t[k % 2 + 1] = tmp;
+        }
+}
+
+/*!
+ * Each level of detail is obtained by vertex clustering: the bounding box
+ * of the model is divided by a regular grid, every vertex is replaced by a
+ * representative of its cell (the vertex nearest to the mean of the cell),
+ * and triangles collapsing into less than three distinct vertices are
+ * dropped, as well as duplicated ones. Since representatives are original
+ * vertices, levels are just different index ranges over the same vertex
+ * arrays, and are appended to the index array.
+ *
+ * The first level uses a `LOD_MAX_GRID` grid, then resolution is halved at
+ * each level. A level is kept only if it halves at least the number of
+ * faces of the previous one, and no level is built below `LOD_MIN_FACES`
+ * faces.
+ */
+void build_lod(void)
+{
+    unsigned int *cell;   // cell of each vertex
+    unsigned int *keys;   // hash table keys (cell + 1, zero if empty)
+    float *sum;           // sum of the coordinates of each cell
+    int *rep;             // representative vertex of each table entry
+    float *best;          // distance from the representative to the mean
+    int *slot;            // table entry of each vertex
+    GLuint *triangles;    // hash set of the triangles of the current level
+    size_t table_size = 1, tri_table_size = 1;
+    float extent = 0;
+    int grid, i, k, line;
+
+    n_lod = 1;
+    lod[0].first = 0;
+    lod[0].count = n_faces * 3;
+    lod[0].error = 0;
+
+    if (!lod_enabled || n_faces < 2 * LOD_MIN_FACES)
+        return;
+    for (i = 0; i < n_faces * 3; ++i)
+        if (indices[i] >= (GLuint) n_vertex)
+            return;
+
+    for (k = 0; k < 3; ++k)
+        if (max_coord[k] - min_coord[k] > extent)
+            extent = max_coord[k] - min_coord[k];
+    if (extent <= 0)
+        return;
+
+    while (table_size < 2 * (size_t) n_vertex)
+        table_size *= 2;
+    while (tri_table_size < 2 * (size_t) n_faces)
+        tri_table_size *= 2;
+
+    line = __LINE__ + 1;
+    cell = (unsigned int*) malloc(sizeof (unsigned int) * n_vertex);
+    if (cell == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    slot = (int*) malloc(sizeof (int) * n_vertex);
+    if (slot == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    keys = (unsigned int*) malloc(sizeof (unsigned int) * table_size);
+    if (keys == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    sum = (float*) malloc(sizeof (float) * 4 * table_size);
+    if (sum == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    rep = (int*) malloc(sizeof (int) * table_size);
+    if (rep == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    best = (float*) malloc(sizeof (float) * table_size);
+    if (best == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    triangles = (GLuint*) malloc(sizeof (GLuint) * 3 * tri_table_size);
+    if (triangles == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    for (grid = LOD_MAX_GRID; grid >= 2 && n_lod < MAX_LOD_LEVELS; grid /= 2)
+    {
+        const Lod_level *prev = &lod[n_lod - 1];
+        float cell_size = extent / grid;
+        int count = 0;
+
+        memset(keys, 0, sizeof (unsigned int) * table_size);
+
+        // assign vertices to cells, accumulating the sum of each cell
+        for (i = 0; i < n_vertex; ++i)
+        {
+            const GLfloat *v =
+                (const GLfloat*) tuple_at(vertexp, i, 3 * sizeof (GLfloat));
+            unsigned int c[3], h;
+
+            for (k = 0; k < 3; ++k)
+            {
+                c[k] = (unsigned int) ((v[k] - min_coord[k]) / cell_size);
+                if (c[k] >= (unsigned int) grid)
+                    c[k] = grid - 1;
+            }
+            cell[i] = (c[0] * grid + c[1]) * grid + c[2];
+
+            // linear probing on a multiplicative hash of the cell
+            h = (cell[i] * 2654435761u) & (table_size - 1);
+            while (keys[h] && keys[h] != cell[i] + 1)
+                h = (h + 1) & (table_size - 1);
+            if (!keys[h])
+            {
+                keys[h] = cell[i] + 1;
+                sum[h * 4] = sum[h * 4 + 1] = sum[h * 4 + 2] = 0;
+                sum[h * 4 + 3] = 0;
+                best[h] = FLT_MAX;
+            }
+            for (k = 0; k < 3; ++k)
+                sum[h * 4 + k] += v[k];
+            sum[h * 4 + 3] += 1;
+            slot[i] = h;
+        }
+
+        // choose the representative of each cell
+        for (i = 0; i < n_vertex; ++i)
+        {
+            const GLfloat *v =
+                (const GLfloat*) tuple_at(vertexp, i, 3 * sizeof (GLfloat));
+            int h = slot[i];
+            float d = 0;
+
+            for (k = 0; k < 3; ++k)
+            {
+                float diff = v[k] - sum[h * 4 + k] / sum[h * 4 + 3];
+                d += diff * diff;
+            }
+            if (d < best[h])
+            {
+                best[h] = d;
+                rep[h] = i;
+            }
+        }
+
+        // collapse triangles of the full model, appending the new level
+        resize_indices((size_t) prev->first + prev->count + n_faces * 3);
+
+        memset(triangles, 0xFF, sizeof (GLuint) * 3 * tri_table_size);
+        for (i = 0; i < n_faces; ++i)
+        {
+            GLuint a = rep[slot[indices[i * 3]]];
+            GLuint b = rep[slot[indices[i * 3 + 1]]];
+            GLuint c = rep[slot[indices[i * 3 + 2]]];
+            GLuint *dest = indices + prev->first + prev->count + count;
+            GLuint t[3];
+            size_t h;
+
+            if (a == b || b == c || a == c)
+                continue;
+
+            // skip triangles already emitted, compared as sorted triples
+            t[0] = a;
+            t[1] = b;
+            t[2] = c;
+            sort_triple(t);
+            h = (t[0] * 73856093u ^ t[1] * 19349663u ^ t[2] * 83492791u)
+                & (tri_table_size - 1);
+            while (triangles[h * 3] != 0xFFFFFFFFu
+                    && memcmp(&triangles[h * 3], t, sizeof t))
+                h = (h + 1) & (tri_table_size - 1);
+            if (triangles[h * 3] != 0xFFFFFFFFu)
+                continue;
+            memcpy(&triangles[h * 3], t, sizeof t);
+
+            dest[0] = a;
+            dest[1] = b;
+            dest[2] = c;
+            count += 3;
+        }
+
+        if (count / 3 < LOD_MIN_FACES)
+            break;
+        if (count > prev->count / 2)
+            continue;
+
+        lod[n_lod].first = prev->first + prev->count;
+        lod[n_lod].count = count;
+        lod[n_lod].error = cell_size * sqrt(3);
+        n_lod++;
+    }
+
+    // trim the index array to the levels actually kept
+    resize_indices(total_indices());
+
+    free(cell);
+    free(slot);
+    free(keys);
+    free(sum);
+    free(rep);
+    free(best);
+    free(triangles);
+
+    #ifdef __DEBUG__
+    for (i = 0; i < n_lod; ++i)
+        printf("LOD %d: %d faces, error %f\n",
+                i, lod[i].count / 3, lod[i].error);
+    #endif // __DEBUG__
+}
+
+/*!
+ * Compute the unit normal of the triangle whose indices start at position
+ * <code>i</code> of the index array, oriented according to the
+ * counterclockwise winding. Return zero for degenerate triangles.
+ */
+static int triangle_normal(int i, float n[3])
+{
+    const GLfloat *a, *b, *c;
+    float u[3], v[3], length;
+    int k;
+
+    a = (const GLfloat*) tuple_at(vertexp, indices[i], 3 * sizeof (GLfloat));
+    b = (const GLfloat*) tuple_at(vertexp, indices[i + 1],
+            3 * sizeof (GLfloat));
+    c = (const GLfloat*) tuple_at(vertexp, indices[i + 2],
+            3 * sizeof (GLfloat));
+    for (k = 0; k < 3; ++k)
+    {
+        u[k] = b[k] - a[k];
+        v[k] = c[k] - a[k];
+    }
+
+    n[0] = u[1] * v[2] - u[2] * v[1];
+    n[1] = u[2] * v[0] - u[0] * v[2];
+    n[2] = u[0] * v[1] - u[1] * v[0];
+    length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length == 0)
+        return 0;
+
+    n[0] /= length;
+    n[1] /= length;
+    n[2] /= length;
+    return 1;
+}
+
+/*!
+ * Allocate the arrays written while culling the clusters, in a single
+ * block starting at `draw_start`.
+ */
+static void alloc_cluster_scratch(void)
+{
+    int line = __LINE__ + 1;
+    clusters.draw_start = (const GLvoid**) malloc(
+            (sizeof (GLvoid*) + sizeof (GLsizei) + sizeof (char))
+            * clusters.n);
+    if (clusters.draw_start == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    clusters.draw_count = (GLsizei*) (clusters.draw_start + clusters.n);
+    clusters.visible = (char*) (clusters.draw_count + clusters.n);
+}
+
+/*!
+ * Each level of detail is cut into clusters of `CLUSTER_FACES` consecutive
+ * triangles. Since the full model is reordered for the vertex cache, which
+ * emits triangles fanning around neighbouring vertices, consecutive
+ * triangles are spatially close, so the clusters are compact while the
+ * triangle order (and the cache efficiency) is left untouched.
+ *
+ * The bounding sphere of a cluster is centered in the center of its
+ * bounding box. Its normal cone has as axis the mean of the unit normals of
+ * the triangles (computed from the vertex winding, consistently with
+ * back-face culling), and the cosine of its half-angle is the minimum dot
+ * product between the axis and the normals. The cluster can be back-facing
+ * only when all the normals are inside the same half-space, i.e. when the
+ * half-angle is less than 90 degrees.
+ *
+ * No cluster is built if `cluster_culling` is zero or the model contains
+ * invalid indices.
+ */
+void build_clusters(void)
+{
+    float *data;
+    int c, i, k, l, line;
+
+    free(clusters.center[0]);
+    free(clusters.first);
+    free(clusters.draw_start);
+    memset(&clusters, 0, sizeof (clusters));
+    for (l = 0; l < n_lod; ++l)
+        lod[l].first_cluster = lod[l].n_clusters = 0;
+
+    if (!cluster_culling || n_lod == 0)
+        return;
+    for (i = 0; i < total_indices(); ++i)
+        if (indices[i] >= (GLuint) n_vertex)
+            return;
+
+    for (l = 0; l < n_lod; ++l)
+    {
+        lod[l].first_cluster = clusters.n;
+        lod[l].n_clusters =
+            (lod[l].count / 3 + CLUSTER_FACES - 1) / CLUSTER_FACES;
+        clusters.n += lod[l].n_clusters;
+    }
+    if (clusters.n == 0)
+        return;
+
+    // a single block for the culling data, a single one for the ranges
+    line = __LINE__ + 1;
+    data = (float*) malloc(sizeof (float) * 8 * clusters.n);
+    if (data == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    for (k = 0; k < 3; ++k)
+    {
+        clusters.center[k] = data + k * clusters.n;
+        clusters.axis[k] = data + (4 + k) * clusters.n;
+    }
+    clusters.radius = data + 3 * clusters.n;
+    clusters.cutoff = data + 7 * clusters.n;
+
+    line = __LINE__ + 1;
+    clusters.first = (int*) malloc(sizeof (int) * 2 * clusters.n);
+    if (clusters.first == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    clusters.count = clusters.first + clusters.n;
+    alloc_cluster_scratch();
+
+    for (l = 0; l < n_lod; ++l)
+    {
+        for (c = 0; c < lod[l].n_clusters; ++c)
+        {
+            const int id = lod[l].first_cluster + c;
+            const int first = lod[l].first + c * CLUSTER_FACES * 3;
+            const int end = first + CLUSTER_FACES * 3 < lod[l].first
+                                                        + lod[l].count
+                            ? first + CLUSTER_FACES * 3
+                            : lod[l].first + lod[l].count;
+            float max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+            float min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+            float axis[3] = {0, 0, 0};
+            float radius = 0, length, min_dot = 1;
+
+            clusters.first[id] = first;
+            clusters.count[id] = end - first;
+
+            // bounding sphere
+            for (i = first; i < end; ++i)
+            {
+                const GLfloat *v = (const GLfloat*) tuple_at(
+                        vertexp, indices[i], 3 * sizeof (GLfloat));
+                for (k = 0; k < 3; ++k)
+                {
+                    if (v[k] > max[k])
+                        max[k] = v[k];
+                    if (v[k] < min[k])
+                        min[k] = v[k];
+                }
+            }
+            for (k = 0; k < 3; ++k)
+                clusters.center[k][id] = (max[k] + min[k]) / 2;
+            for (i = first; i < end; ++i)
+            {
+                const GLfloat *v = (const GLfloat*) tuple_at(
+                        vertexp, indices[i], 3 * sizeof (GLfloat));
+                float d = 0;
+                for (k = 0; k < 3; ++k)
+                    d += (v[k] - clusters.center[k][id])
+                         * (v[k] - clusters.center[k][id]);
+                if (d > radius)
+                    radius = d;
+            }
+            clusters.radius[id] = sqrt(radius);
+
+            // normal cone, in two passes: mean axis, then aperture
+            for (k = 0; k < 2; ++k)
+            {
+                for (i = first; i < end; i += 3)
+                {
+                    float n[3];
+                    if (!triangle_normal(i, n))
+                        continue;
+                    if (k == 0)
+                    {
+                        axis[0] += n[0];
+                        axis[1] += n[1];
+                        axis[2] += n[2];
+                    }
+                    else if (n[0] * axis[0] + n[1] * axis[1]
+                             + n[2] * axis[2] < min_dot)
+                        min_dot = n[0] * axis[0] + n[1] * axis[1]
+                                  + n[2] * axis[2];
+                }
+                length = sqrt(axis[0] * axis[0] + axis[1] * axis[1]
+                              + axis[2] * axis[2]);
+                if (k == 0 && length > 0)
+                {
+                    axis[0] /= length;
+                    axis[1] /= length;
+                    axis[2] /= length;
+                }
+            }
+            for (k = 0; k < 3; ++k)
+                clusters.axis[k][id] = axis[k];
+            clusters.cutoff[id] = min_dot > 0 && length > 0
+                                  ? sqrt(1 - min_dot * min_dot) : 1;
+        }
+    }
+
+    #ifdef __DEBUG__
+    printf("%d clusters built.\n", clusters.n);
+    #endif // __DEBUG__
+}
+
+/*!
+ * A cluster is outside the frustum when its bounding sphere lies entirely
+ * on the outer side of a plane. It is back-facing when, from the eye, all
+ * the normals in its cone point away for every point of its bounding
+ * sphere, i.e. when
+ * \f[
+ *      (c - e) \cdot a \geq s \, \lVert c - e \rVert + r
+ * \f]
+ * with \f$ c \f$ and \f$ r \f$ center and radius of the sphere,
+ * \f$ e \f$ the eye, \f$ a \f$ the cone axis and \f$ s \f$ the cone
+ * cutoff (see build_clusters(void)).
+ *
+ * Four clusters are tested at once with SSE instructions, when available.
+ * The visible clusters are then merged into ranges of consecutive indices,
+ * so that they can be drawn with a single glMultiDrawElements call.
+ */
+int cull_clusters(const Mesh *m, int level, float planes[6][4],
+        const float *eye)
+{
+    const Cluster_set *set = &m->clusters;
+    const int first = m->lod[level].first_cluster;
+    const int end = first + m->lod[level].n_clusters;
+    const size_t index_size = m->element_type == GL_UNSIGNED_SHORT
+                              ? sizeof (GLushort) : sizeof (GLuint);
+    int i = first, p, n_ranges = 0;
+
+    #if defined(__SSE__)
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(set->center[0] + i);
+        __m128 cy = _mm_loadu_ps(set->center[1] + i);
+        __m128 cz = _mm_loadu_ps(set->center[2] + i);
+        __m128 r = _mm_loadu_ps(set->radius + i);
+        __m128 minus_r = _mm_sub_ps(zero, r);
+        __m128 visible = _mm_cmpeq_ps(zero, zero);
+        int mask;
+
+        for (p = 0; p < 6; ++p)
+        {
+            __m128 d = _mm_add_ps(
+                    _mm_add_ps(
+                        _mm_mul_ps(cx, _mm_set1_ps(planes[p][0])),
+                        _mm_mul_ps(cy, _mm_set1_ps(planes[p][1]))),
+                    _mm_add_ps(
+                        _mm_mul_ps(cz, _mm_set1_ps(planes[p][2])),
+                        _mm_set1_ps(planes[p][3])));
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(d, minus_r));
+        }
+
+        if (eye != NULL)
+        {
+            __m128 dx = _mm_sub_ps(cx, _mm_set1_ps(eye[0]));
+            __m128 dy = _mm_sub_ps(cy, _mm_set1_ps(eye[1]));
+            __m128 dz = _mm_sub_ps(cz, _mm_set1_ps(eye[2]));
+            __m128 dot = _mm_add_ps(
+                    _mm_add_ps(
+                        _mm_mul_ps(dx, _mm_loadu_ps(set->axis[0] + i)),
+                        _mm_mul_ps(dy, _mm_loadu_ps(set->axis[1] + i))),
+                    _mm_mul_ps(dz, _mm_loadu_ps(set->axis[2] + i)));
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                    _mm_mul_ps(dz, dz)));
+            __m128 limit = _mm_add_ps(
+                    _mm_mul_ps(_mm_loadu_ps(set->cutoff + i), length),
+                    r);
+            visible = _mm_andnot_ps(_mm_cmpge_ps(dot, limit), visible);
+        }
+
+        mask = _mm_movemask_ps(visible);
+        set->visible[i] = mask & 1;
+        set->visible[i + 1] = (mask >> 1) & 1;
+        set->visible[i + 2] = (mask >> 2) & 1;
+        set->visible[i + 3] = (mask >> 3) & 1;
+    }
+    #endif // defined(__SSE__)
+
+    // remaining clusters (all of them without SSE)
+    for (; i < end; ++i)
+    {
+        const float c[3] = {
+            set->center[0][i],
+            set->center[1][i],
+            set->center[2][i]
+        };
+        const float r = set->radius[i];
+
+        set->visible[i] = 1;
+        for (p = 0; p < 6; ++p)
+            if (planes[p][0] * c[0] + planes[p][1] * c[1]
+                    + planes[p][2] * c[2] + planes[p][3] < -r)
+                set->visible[i] = 0;
+
+        if (eye != NULL)
+        {
+            float d[3] = {c[0] - eye[0], c[1] - eye[1], c[2] - eye[2]};
+            float dot = d[0] * set->axis[0][i]
+                        + d[1] * set->axis[1][i]
+                        + d[2] * set->axis[2][i];
+            float length = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            if (dot >= set->cutoff[i] * length + r)
+                set->visible[i] = 0;
+        }
+    }
+
+    // merge consecutive visible clusters
+    for (i = first; i < end; ++i)
+    {
+        if (!set->visible[i])
+            continue;
+        if (i > first && set->visible[i - 1])
+            set->draw_count[n_ranges - 1] += set->count[i];
+        else
+        {
+            set->draw_start[n_ranges] =
+                (const char*) m->index_ptr + set->first[i] * index_size;
+            set->draw_count[n_ranges] = set->count[i];
+            n_ranges++;
+        }
+    }
+
+    return n_ranges;
+}
+
+/*!
+ * The error of each level is projected on screen, given the current camera
+ * distance and the perspective set in resize(int, int), and the coarsest
+ * level whose error does not exceed `LOD_PIXEL_ERROR` is chosen.
+ */
+int choose_lod(const Mesh *m)
+{
+    float scale = bb_radius < MIN_BB_RADIUS ? MIN_BB_RADIUS / bb_radius : 1;
+    float distance = eye.rho - bb_radius * scale; // nearest model point
+    int l;
+
+    if (distance < 2.0f) // near clipping plane
+        distance = 2.0f;
+
+    // glFrustum maps [-1, 1] at distance 2 onto the viewport height
+    for (l = m->n_lod - 1; l > 0; --l)
+        if (m->lod[l].error * scale / distance * viewport_height
+                <= LOD_PIXEL_ERROR)
+            break;
+
+    return l;
+}
+
+/*!
+ * Quantize a normal component in [-1, 1] to a signed integer in
+ * [-max, max].
+ */
+static int quantize_unit(float v, int max)
+{
+    int q = (int) floor(v * max + 0.5f);
+    return q > max ? max : (q < -max ? -max : q);
+}
+
+/*!
+ * The normal is normalized and quantized to signed bytes, the color is
+ * quantized to unsigned bytes.
+ */
+void pack_vertex(Packed_vertex *p, const float position[3],
+        const float normal[3], const float color[3])
+{
+    float len = sqrt(normal[0] * normal[0] + normal[1] * normal[1]
+                     + normal[2] * normal[2]);
+    int k;
+
+    memcpy(p->position, position, sizeof (p->position));
+    for (k = 0; k < 3; ++k)
+    {
+        p->normal[k] = (GLbyte) quantize_unit(
+                len > 0 ? normal[k] / len : normal[k], 127);
+        p->color[k] = color ? (GLubyte) quantize_unit(color[k], 255) : 255;
+    }
+    p->normal[3] = 0;
+    p->color[3] = 255;
+}
+
+/*!
+ * Convert the indices to 16 bits when the model has less than 65536
+ * vertices. The conversion is done in place, since each 16 bit index is
+ * written over 32 bit ones already read, and the second half of the array
+ * is left unused in the arena.
+ */
+static void shrink_indices(void)
+{
+    int i;
+
+    if (n_vertex > 65536 || element_type != GL_UNSIGNED_INT)
+        return;
+
+    for (i = 0; i < total_indices(); ++i)
+    {
+        GLuint index;
+        GLushort short_index;
+
+        memcpy(&index, indices + i, sizeof (index));
+        short_index = (GLushort) index;
+        memcpy((GLushort*) indices + i, &short_index, sizeof (short_index));
+    }
+    element_type = GL_UNSIGNED_SHORT;
+}
+
+/*!
+ * Return the position of each vertex in order of first usage by the
+ * indices of all levels of detail, as optimize_model(void) numbers them,
+ * for interleaved arrays which it left in file order. NULL is returned if
+ * the vertices need no renumbering, the vertex cache optimization is
+ * disabled, an index is invalid or there is no memory for the order.
+ */
+static int *first_usage_order(void)
+{
+    int *order;
+    int i, n_new = 0;
+
+    if (!optimize_vertex_cache || !vertex_stride
+            || element_type != GL_UNSIGNED_INT)
+        return NULL;
+    for (i = 0; i < total_indices(); ++i)
+        if (indices[i] >= (GLuint) n_vertex)
+            return NULL;
+
+    order = (int*) malloc(sizeof (int) * n_vertex);
+    if (order == NULL)
+        return NULL;
+
+    for (i = 0; i < n_vertex; ++i)
+        order[i] = -1;
+    for (i = 0; i < total_indices(); ++i)
+        if (order[indices[i]] < 0)
+            order[indices[i]] = n_new++;
+    for (i = 0; i < n_vertex; ++i)
+        if (order[i] < 0)
+            order[i] = n_new++;
+
+    return order;
+}
+
+/*!
+ * Each vertex is stored in a Packed_vertex: coordinates stay as floats,
+ * the normal is normalized and quantized to signed bytes and the color is
+ * stored as four bytes. Byte normals are accepted by glNormalPointer() since
+ * OpenGL 1.1, while packed 10:10:10:2 ones are not usable with the fixed
+ * function pipeline on every implementation. Since the file stores colors
+ * as integers in [0, 255], the only loss of precision is on normals.
+ * Indices are shrunk to 16 bits when the model has less than 65536
+ * vertices.
+ *
+ * The packed vertices and the indices are stored in a new arena, so that
+ * the processed model is held by a single block. The model arrays are then
+ * pointed inside it, with the stride of a Packed_vertex, and the original
+ * arrays (or the file mapping) are released with their arena. Vertices
+ * read from a file mapping, which optimize_model(void) could not renumber,
+ * are renumbered by the copy.
+ */
+void pack_model(void)
+{
+    const size_t v_size = arena_pad(sizeof (Packed_vertex) * n_vertex);
+    const size_t i_size = (size_t) total_indices()
+                          * (element_type == GL_UNSIGNED_SHORT
+                             ? sizeof (GLushort) : sizeof (GLuint));
+    Packed_vertex *packed;
+    char *block;
+    int *order;  // position of each vertex in the packed array, if moved
+    int i, k;
+
+    // without memory for the copy, the model is kept as it is
+    block = (char*) alloc_arena(v_size + i_size);
+    if (block == NULL)
+        return;
+    packed = (Packed_vertex*) block;
+    order = first_usage_order();
+
+    for (i = 0; i < n_vertex; ++i)
+    {
+        float v[3], n[3], c[3];
+
+        memcpy(v, tuple_at(vertexp, i, 3 * sizeof (GLfloat)), sizeof v);
+        memcpy(n, tuple_at(normals, i, 3 * sizeof (GLfloat)), sizeof n);
+        if (isColored && color_type == GL_UNSIGNED_BYTE)
+            for (k = 0; k < 3; ++k)
+                c[k] = ((const GLubyte*) tuple_at(color, i, 3))[k] / 255.0f;
+        else if (isColored)
+            memcpy(c, tuple_at(color, i, 3 * sizeof (GLfloat)), sizeof c);
+
+        pack_vertex(&packed[order != NULL ? order[i] : i], v, n,
+                isColored ? c : NULL);
+    }
+    memcpy(block + v_size, indices, i_size);
+    if (order != NULL)
+    {
+        GLuint *packed_indices = (GLuint*) (block + v_size);
+        for (i = 0; i < total_indices(); ++i)
+            packed_indices[i] = order[packed_indices[i]];
+        free(order);
+    }
+
+    // release original arrays (or the file mapping) and their arena
+    #if defined(__APPLE__) || defined(__linux__)
+    if (mapping != NULL)
+    {
+        munmap(mapping, mapping_size);
+        mapping = NULL;
+        mapping_size = 0;
+    }
+    else
+    #endif // defined(__APPLE__) || defined(__linux__)
+    {
+        free_array(vertexp);
+        free_array(normals);
+        free_array(color);
+    }
+    free_array(indices);
+    free(arena);
+    arena = block;
+    arena_size = v_size + i_size;
+
+    // point model arrays inside the packed array
+    vertexp = packed[0].position;
+    normals = (GLfloat*) ((char*) packed + offsetof(Packed_vertex, normal));
+    color = (GLfloat*) ((char*) packed + offsetof(Packed_vertex, color));
+    indices = (GLuint*) (block + v_size);
+    vertex_stride = sizeof (Packed_vertex);
+    normal_type = GL_BYTE;
+    color_type = GL_UNSIGNED_BYTE;
+
+    shrink_indices();
+}
+
+/*!
+ * Set the OpenGL state used to draw the model: background color, depth
+ * test, light and material properties.
+ */
+void init_gl(void)
+{
+    glClearColor(0, 0, 0, 1); // viewport background color (rgba)
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+
+    // back faces are hidden if asked, consistently with cluster culling,
+    // since open or badly oriented models would show holes
+    if (cull_backfaces)
+        glEnable(GL_CULL_FACE);
+
+    glEnable(GL_LIGHT0);
+    glEnable(GL_COLOR_MATERIAL);
+    glEnable(GL_LIGHTING);
+
+    // LIGHT0 properties
+    glLightfv(GL_LIGHT0, GL_AMBIENT,  light_ambient);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE,  light_diffuse);
+    glLightfv(GL_LIGHT0, GL_SPECULAR, light_specular);
+
+    // material properties
+    glMaterialfv(GL_FRONT, GL_AMBIENT,   mat_ambient);
+    glMaterialfv(GL_FRONT, GL_DIFFUSE,   mat_diffuse);
+    glMaterialfv(GL_FRONT, GL_SPECULAR,  mat_specular);
+    glMaterialfv(GL_FRONT, GL_SHININESS, high_shininess);
+}
+
+/*!
+ * Buffer objects are part of the core since OpenGL 1.5.
+ */
+int buffer_objects_supported(void)
+{
+    int major = 1, minor = 0;
+    const char *version = (const char*) glGetString(GL_VERSION);
+
+    if (version != NULL)
+        sscanf(version, "%d.%d", &major, &minor);
+
+    return major > 1 || (major == 1 && minor >= 5);
+}
+
+/*!
+ * The model is uploaded once into a vertex buffer object, holding vertices,
+ * normals and color, and an index buffer object, so that display(void) does
+ * not need to send the whole mesh to the server at each frame.
+ *
+ * When the model arrays are interleaved (i.e. they are packed or they point
+ * inside a file mapping) the vertex block is uploaded as it is, keeping its
+ * layout; otherwise the three arrays are stored one after the other.
+ *
+ * If buffer objects are not supported (OpenGL older than 1.5) or the upload
+ * fails, the host arrays are used directly as client side arrays.
+ */
+void upload_model(void)
+{
+    size_t v_size = (size_t) n_vertex * 3 * sizeof (GLfloat);
+    size_t i_size;
+
+    i_size = (size_t) total_indices()
+             * (element_type == GL_UNSIGNED_SHORT
+                ? sizeof (GLushort) : sizeof (GLuint));
+
+    // chunks are uploaded while drawing
+    if (chunked_model)
+        return;
+
+    // client side arrays by default
+    vertex_ptr = vertexp;
+    normal_ptr = normals;
+    color_ptr = color;
+    index_ptr = indices;
+
+    if (!buffer_objects_supported())
+        return;
+
+    while (glGetError() != GL_NO_ERROR) {} // clear previous errors
+
+    glGenBuffers(1, &vertex_buffer);
+    glGenBuffers(1, &index_buffer);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+    if (vertex_stride)
+    {
+        // interleaved arrays, keep offsets respect to the vertex array
+        glBufferData(GL_ARRAY_BUFFER, (size_t) n_vertex * vertex_stride,
+                vertexp, GL_STATIC_DRAW);
+        vertex_ptr = BUFFER_OFFSET(0);
+        normal_ptr = BUFFER_OFFSET((char*) normals - (char*) vertexp);
+        color_ptr = BUFFER_OFFSET((char*) color - (char*) vertexp);
+    }
+    else
+    {
+        // separate arrays, stored one after the other
+        glBufferData(GL_ARRAY_BUFFER, (isColored ? 3 : 2) * v_size,
+                NULL, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, v_size, vertexp);
+        glBufferSubData(GL_ARRAY_BUFFER, v_size, v_size, normals);
+        if (isColored)
+            glBufferSubData(GL_ARRAY_BUFFER, 2 * v_size, v_size, color);
+        vertex_ptr = BUFFER_OFFSET(0);
+        normal_ptr = BUFFER_OFFSET(v_size);
+        color_ptr = BUFFER_OFFSET(2 * v_size);
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, i_size, indices, GL_STATIC_DRAW);
+    index_ptr = BUFFER_OFFSET(0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // fall back to client side arrays if the upload failed
+    if (glGetError() != GL_NO_ERROR)
+    {
+        glDeleteBuffers(1, &vertex_buffer);
+        glDeleteBuffers(1, &index_buffer);
+        vertex_buffer = index_buffer = 0;
+        vertex_ptr = vertexp;
+        normal_ptr = normals;
+        color_ptr = color;
+        index_ptr = indices;
+    }
+
+    #ifdef __DEBUG__
+    printf("Buffer objects %s.\n", vertex_buffer ? "in use" : "not in use");
+    #endif // __DEBUG__
+}
+
+/*!
+ * Upload again the parts of a block of model data which differ from its
+ * previous version, comparing them in blocks of `RELOAD_BLOCK_SIZE` bytes
+ * and merging consecutive changed blocks into a single upload. Return the
+ * number of bytes uploaded.
+ */
+static size_t update_range(GLenum target, size_t offset, const void *old,
+        const void *data, size_t size)
+{
+    const char *a = (const char*) old;
+    const char *b = (const char*) data;
+    size_t start, end, next, uploaded = 0;
+
+    for (start = 0; start < size; start = end)
+    {
+        end = size - start > RELOAD_BLOCK_SIZE ? start + RELOAD_BLOCK_SIZE
+                                               : size;
+        if (!memcmp(a + start, b + start, end - start))
+            continue;
+
+        // extend the range over the following changed blocks
+        while (end < size)
+        {
+            next = size - end > RELOAD_BLOCK_SIZE ? end + RELOAD_BLOCK_SIZE
+                                                  : size;
+            if (!memcmp(a + end, b + end, next - end))
+                break;
+            end = next;
+        }
+
+        glBufferSubData(target, offset + start, end - start, b + start);
+        uploaded += end - start;
+    }
+
+    return uploaded;
+}
+
+/*!
+ * When a reloaded model has the same layout as the one shown (same
+ * counts, types and interleaving), typically because only some positions
+ * or colors were edited, its data is written into the buffer objects of
+ * the old one, uploading only the ranges which changed, and the buffers
+ * pass to the new model. Return -1, leaving both models untouched, if the
+ * layouts differ or the old model has no buffer objects.
+ */
+static int update_model(Mesh *old)
+{
+    const size_t v_size = (size_t) n_vertex * 3 * sizeof (GLfloat);
+    const size_t i_size = (size_t) total_indices()
+                          * (element_type == GL_UNSIGNED_SHORT
+                             ? sizeof (GLushort) : sizeof (GLuint));
+    const GLfloat *old_arrays[3] = {old->vertexp, old->normals, old->color};
+    const GLfloat *arrays[3] = {vertexp, normals, color};
+    size_t total, uploaded = 0;
+    int old_indices, k;
+
+    old_indices = old->n_lod ? old->lod[old->n_lod - 1].first
+                               + old->lod[old->n_lod - 1].count
+                             : old->n_faces * 3;
+    if (!old->vertex_buffer || old->chunked || chunked_model
+            || old->n_vertex != n_vertex
+            || old_indices != total_indices()
+            || old->is_colored != isColored
+            || old->vertex_stride != vertex_stride
+            || old->normal_type != normal_type
+            || old->color_type != color_type
+            || old->element_type != element_type)
+        return -1;
+
+    // interleaved arrays must lie at the same offsets in the vertex block
+    if (vertex_stride
+            && ((char*) normals - (char*) vertexp
+                != (char*) old->normals - (char*) old->vertexp
+                || (isColored && (char*) color - (char*) vertexp
+                    != (char*) old->color - (char*) old->vertexp)))
+        return -1;
+
+    glBindBuffer(GL_ARRAY_BUFFER, old->vertex_buffer);
+    if (vertex_stride)
+    {
+        total = (size_t) n_vertex * vertex_stride;
+        uploaded += update_range(GL_ARRAY_BUFFER, 0, old->vertexp, vertexp,
+                total);
+    }
+    else
+    {
+        total = (isColored ? 3 : 2) * v_size;
+        for (k = 0; k < (isColored ? 3 : 2); ++k)
+            uploaded += update_range(GL_ARRAY_BUFFER, k * v_size,
+                    old_arrays[k], arrays[k], v_size);
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, old->index_buffer);
+    uploaded += update_range(GL_ELEMENT_ARRAY_BUFFER, 0, old->indices,
+            indices, i_size);
+    total += i_size;
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // same layout, same offsets inside the buffers
+    vertex_buffer = old->vertex_buffer;
+    index_buffer = old->index_buffer;
+    vertex_ptr = old->vertex_ptr;
+    normal_ptr = old->normal_ptr;
+    color_ptr = old->color_ptr;
+    index_ptr = old->index_ptr;
+    old->vertex_buffer = old->index_buffer = 0;
+
+    printf("Model updated: %lu of %lu bytes uploaded.\n",
+            (unsigned long) uploaded, (unsigned long) total);
+
+    return 0;
+}
+
+/*!
+ * The model loaded last replaces the one shown, which is released. A
+ * reloaded model with the same layout reuses the buffer objects of the
+ * old one, updated only where it changed (see update_model(Mesh*)), so
+ * that small edits of large models are swapped in quickly. A scene is
+ * uploaded by upload_scene(void) and shown through its summary, which
+ * has no arrays. The bounding box is framed again in any case, so that
+ * the model stays centered.
+ */
+void publish_model(int keep_camera)
+{
+    Mesh loaded;
+
+    if (scene_loaded())
+        upload_scene();
+    else if (update_model(&shown_model))
+        upload_model();
+
+    store_mesh(&loaded);
+    release_mesh(&shown_model);
+    shown_model = loaded;
+    publish_scene(&shown_model);
+
+    frame_model(&shown_model);
+    if (!keep_camera)
+        init_camera();
+}
+
+/*!
+ * For a scene, the summary stands for the model shown.
+ */
+const Mesh *shown_mesh(void)
+{
+    return &shown_model;
+}
+
+/*!
+ * Return the size of a cache section of the given size, padded to
+ * `CACHE_ALIGN` bytes.
+ */
+static size_t cache_pad(size_t size)
+{
+    return (size + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+}
+
+/*!
+ * Fill a cache header for the given model file, with its identity, the
+ * current settings and (when <code>model</code> is nonzero) the current
+ * model properties. Return -1 if the file cannot be inspected.
+ */
+static int cache_header(const char *filename, Cache_header *h, int model)
+{
+#if defined(__APPLE__) || defined(__linux__)
+    struct stat st;
+
+    if (stat(filename, &st) || strlen(filename) > STR_LEN)
+        return -1;
+
+    memset(h, 0, sizeof (*h));
+    memcpy(h->magic, "MESHVWR", 8);
+    h->version = CACHE_VERSION;
+    h->byte_order = 0x01020304;
+    h->settings = optimize_vertex_cache
+                  | lod_enabled << 1
+                  | cluster_culling << 2
+                  | CLUSTER_FACES << 3
+                  | (int) crease_angle << 16;
+    strcpy(h->source, filename);
+    h->source_size = st.st_size;
+    #if defined(__APPLE__)
+    h->source_mtime = st.st_mtimespec.tv_sec * 1000000000LL
+                      + st.st_mtimespec.tv_nsec;
+    #else
+    h->source_mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    #endif // defined(__APPLE__)
+
+    if (model)
+    {
+        h->n_vertex = n_vertex;
+        h->n_faces = n_faces;
+        h->n_indices = total_indices();
+        h->n_lod = n_lod;
+        h->n_clusters = clusters.n;
+        h->is_colored = isColored;
+        h->element_type = element_type;
+        memcpy(h->max_coord, max_coord, sizeof (max_coord));
+        memcpy(h->min_coord, min_coord, sizeof (min_coord));
+        bounding_sphere(max_coord, min_coord, &h->center, &h->bb_radius);
+        memcpy(h->lod, lod, sizeof (lod));
+    }
+
+    return 0;
+#else // _WIN32
+    UNUSED(filename);
+    UNUSED(h);
+    UNUSED(model);
+    return -1;
+#endif // defined(__APPLE__) || defined(__linux__)
+}
+
+/*!
+ * Return the total size of a cache file with the given header.
+ */
+static size_t cache_file_size(const Cache_header *h)
+{
+    return cache_pad(sizeof (Cache_header))
+           + cache_pad(sizeof (Packed_vertex) * h->n_vertex)
+           + cache_pad((h->element_type == GL_UNSIGNED_SHORT
+                        ? sizeof (GLushort) : sizeof (GLuint))
+                       * h->n_indices)
+           + cache_pad(sizeof (float) * 8 * h->n_clusters)
+           + cache_pad(sizeof (int) * 2 * h->n_clusters);
+}
+
+/*!
+ * The cache file is mapped in memory, and it is used only if its header
+ * matches the current model file (name, size and modification time),
+ * format version, settings and host, and its size is consistent with the
+ * header. The model arrays then point directly inside the mapping, which
+ * is kept for the whole program life; only the working arrays for the
+ * cluster culling are allocated.
+ */
+int load_cache(const char *filename)
+{
+#if defined(__APPLE__) || defined(__linux__)
+    char name[STR_LEN + sizeof (CACHE_SUFFIX)];
+    Cache_header expected;
+    const Cache_header *h;
+    struct stat st;
+    char *map, *p;
+    int fd, k;
+
+    if (!packed_vertices || cache_header(filename, &expected, 0))
+        return -1;
+
+    sprintf(name, "%s%s", filename, CACHE_SUFFIX);
+    fd = open(name, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) || (size_t) st.st_size < sizeof (Cache_header))
+    {
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    // check that the cache belongs to this model and this build
+    h = (const Cache_header*) map;
+    if (memcmp(h->magic, expected.magic, sizeof (h->magic))
+            || h->version != expected.version
+            || h->byte_order != expected.byte_order
+            || h->settings != expected.settings
+            || strcmp(h->source, expected.source)
+            || h->source_size != expected.source_size
+            || h->source_mtime != expected.source_mtime
+            || h->n_lod < 1
+            || h->n_lod > MAX_LOD_LEVELS
+            || (size_t) st.st_size != cache_file_size(h))
+    {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    cache_mapping = map;
+    cache_mapping_size = st.st_size;
+
+    // model properties
+    n_vertex = h->n_vertex;
+    n_faces = h->n_faces;
+    isColored = h->is_colored;
+    element_type = h->element_type;
+    memcpy(max_coord, h->max_coord, sizeof (max_coord));
+    memcpy(min_coord, h->min_coord, sizeof (min_coord));
+    memcpy(lod, h->lod, sizeof (lod));
+    n_lod = h->n_lod;
+
+    // point model arrays inside the mapping
+    p = map + cache_pad(sizeof (Cache_header));
+    vertexp = ((Packed_vertex*) p)->position;
+    normals = (GLfloat*) (p + offsetof(Packed_vertex, normal));
+    color = (GLfloat*) (p + offsetof(Packed_vertex, color));
+    vertex_stride = sizeof (Packed_vertex);
+    normal_type = GL_BYTE;
+    color_type = GL_UNSIGNED_BYTE;
+    p += cache_pad(sizeof (Packed_vertex) * n_vertex);
+
+    indices = (GLuint*) p;
+    p += cache_pad((element_type == GL_UNSIGNED_SHORT
+                    ? sizeof (GLushort) : sizeof (GLuint))
+                   * h->n_indices);
+
+    memset(&clusters, 0, sizeof (clusters));
+    clusters.n = h->n_clusters;
+    if (clusters.n)
+    {
+        float *data = (float*) p;
+        for (k = 0; k < 3; ++k)
+        {
+            clusters.center[k] = data + k * clusters.n;
+            clusters.axis[k] = data + (4 + k) * clusters.n;
+        }
+        clusters.radius = data + 3 * clusters.n;
+        clusters.cutoff = data + 7 * clusters.n;
+        p += cache_pad(sizeof (float) * 8 * clusters.n);
+
+        clusters.first = (int*) p;
+        clusters.count = clusters.first + clusters.n;
+        alloc_cluster_scratch();
+    }
+
+    return 0;
+#else // _WIN32
+    UNUSED(filename);
+    return -1;
+#endif // defined(__APPLE__) || defined(__linux__)
+}
+
+/*!
+ * Write a section of the cache file, padded to `CACHE_ALIGN` bytes.
+ */
+static void cache_write(FILE *f, const void *data, size_t size)
+{
+    static const char zero[CACHE_ALIGN] = {0};
+    fwrite(data, 1, size, f);
+    fwrite(zero, 1, cache_pad(size) - size, f);
+}
+
+/*!
+ * The cache is written only for packed models, and only if cache writing
+ * is enabled. It is first written to a temporary file, then renamed, so
+ * that a concurrent reader never finds it incomplete. Failures are not
+ * fatal, the model will just be parsed again next time.
+ */
+int save_cache(const char *filename)
+{
+    char name[STR_LEN + sizeof (CACHE_SUFFIX)];
+    char tmp_name[STR_LEN + sizeof (CACHE_SUFFIX) + 4];
+    Cache_header h;
+    FILE *f;
+    int error;
+
+    if (!cache_writing || !packed_vertices || cache_header(filename, &h, 1))
+        return -1;
+
+    sprintf(name, "%s%s", filename, CACHE_SUFFIX);
+    sprintf(tmp_name, "%s.tmp", name);
+    f = fopen(tmp_name, "wb");
+    if (f == NULL)
+        return -1;
+
+    cache_write(f, &h, sizeof (h));
+    cache_write(f, vertexp, sizeof (Packed_vertex) * n_vertex);
+    cache_write(f, indices,
+            (element_type == GL_UNSIGNED_SHORT
+             ? sizeof (GLushort) : sizeof (GLuint))
+            * h.n_indices);
+    if (clusters.n)
+    {
+        cache_write(f, clusters.center[0], sizeof (float) * 8 * clusters.n);
+        cache_write(f, clusters.first, sizeof (int) * 2 * clusters.n);
+    }
+
+    error = ferror(f);
+    if (fclose(f) || error || rename(tmp_name, name))
+    {
+        remove(tmp_name);
+        #ifdef __DEBUG__
+        printf("Unable to write the cache file %s.\n", name);
+        #endif // __DEBUG__
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+ * The comparison is case sensitive.
+ */
+int has_suffix(const char *filename, const char *suffix)
+{
+    size_t n = strlen(filename);
+    size_t m = strlen(suffix);
+    return n >= m && !strcmp(filename + n - m, suffix);
+}
+
+/*!
+ * Quantize the k-th coordinate of a vertex to 16 bits inside the bounding
+ * box.
+ */
+static unsigned int quantize_coord(float v, int k)
+{
+    float extent = max_coord[k] - min_coord[k];
+    long q;
+
+    if (extent <= 0)
+        return 0;
+    q = (long) floor((v - min_coord[k]) / extent * 65535 + 0.5);
+    return q < 0 ? 0 : (q > 65535 ? 65535 : q);
+}
+
+/*!
+ * Compress a block and write it, or write it uncompressed if compression
+ * does not reduce its size.
+ */
+static void container_write_block(FILE *f, const unsigned char *raw,
+        int raw_size, unsigned char *buffer)
+{
+    int size = (int) lz_compress(raw, raw_size, buffer);
+
+    if (size >= raw_size)
+    {
+        size = raw_size;
+        buffer = (unsigned char*) raw;
+    }
+    fwrite(&raw_size, sizeof raw_size, 1, f);
+    fwrite(&size, sizeof size, 1, f);
+    fwrite(buffer, 1, size, f);
+}
+
+/*!
+ * Read a block into <code>raw</code>, decompressing it through
+ * <code>buffer</code> if needed, and return its size, or -1 if it is
+ * truncated or corrupted.
+ */
+static int container_read_block(FILE *f, unsigned char *raw,
+        unsigned char *buffer)
+{
+    int raw_size, size;
+
+    if (fread(&raw_size, sizeof raw_size, 1, f) != 1
+            || fread(&size, sizeof size, 1, f) != 1
+            || raw_size <= 0 || raw_size > CONTAINER_BLOCK
+            || size <= 0 || size > raw_size)
+        return -1;
+
+    if (size == raw_size)
+        return fread(raw, 1, size, f) == (size_t) size ? size : -1;
+
+    if (fread(buffer, 1, size, f) != (size_t) size
+            || lz_decompress(buffer, size, raw, raw_size) != raw_size)
+        return -1;
+    return raw_size;
+}
+
+/*!
+ * Write the vertices of a packed model into the container, in blocks of
+ * `CONTAINER_VERTICES` (see Container_header for their layout).
+ */
+static void container_write_vertices(FILE *f, unsigned char *raw,
+        unsigned char *buffer)
+{
+    const Packed_vertex *packed = (const Packed_vertex*) vertexp;
+    const int planes = isColored ? 12 : 9;
+    int first, i, k;
+
+    for (first = 0; first < n_vertex; first += CONTAINER_VERTICES)
+    {
+        const int m = n_vertex - first < CONTAINER_VERTICES
+                      ? n_vertex - first : CONTAINER_VERTICES;
+        unsigned int last[9] = {0};
+
+        for (i = 0; i < m; ++i)
+        {
+            const Packed_vertex *v = packed + first + i;
+            for (k = 0; k < 3; ++k)
+            {
+                unsigned int q = quantize_coord(v->position[k], k);
+                unsigned int d = (q - last[k]) & 0xffff;
+                raw[2 * k * m + i] = d & 0xff;
+                raw[(2 * k + 1) * m + i] = d >> 8;
+                last[k] = q;
+
+                raw[(6 + k) * m + i] =
+                    (unsigned char) ((GLubyte) v->normal[k] - last[3 + k]);
+                last[3 + k] = (GLubyte) v->normal[k];
+                if (isColored)
+                {
+                    raw[(9 + k) * m + i] =
+                        (unsigned char) (v->color[k] - last[6 + k]);
+                    last[6 + k] = v->color[k];
+                }
+            }
+        }
+        container_write_block(f, raw, planes * m, buffer);
+    }
+}
+
+/*!
+ * Write the indices of all the levels of detail into the container, in
+ * blocks of `CONTAINER_INDICES` (see Container_header for their layout).
+ */
+static void container_write_indices(FILE *f, unsigned char *raw,
+        unsigned char *buffer)
+{
+    const int n = total_indices();
+    int first, i;
+
+    for (first = 0; first < n; first += CONTAINER_INDICES)
+    {
+        const int m = n - first < CONTAINER_INDICES
+                      ? n - first : CONTAINER_INDICES;
+        unsigned char *p = raw;
+        unsigned int last = 0;
+
+        for (i = first; i < first + m; ++i)
+        {
+            unsigned int index = element_type == GL_UNSIGNED_SHORT
+                                 ? ((GLushort*) indices)[i] : indices[i];
+            int d = (int) (index - last);
+            unsigned int z = ((unsigned int) d << 1) ^ (unsigned int) (d >> 31);
+            last = index;
+
+            while (z >= 0x80)
+            {
+                *p++ = (z & 0x7f) | 0x80;
+                z >>= 7;
+            }
+            *p++ = z;
+        }
+        container_write_block(f, raw, p - raw, buffer);
+    }
+}
+
+/*!
+ * The container is written only for packed models, since the normals and
+ * colors are stored as bytes. Coordinates lose precision only below
+ * 1/65535 of the bounding box size.
+ */
+int save_container(const char *filename)
+{
+    Container_header h;
+    unsigned char *raw;
+    FILE *f;
+    int error, line;
+
+    if (vertex_stride != sizeof (Packed_vertex))
+        return -1;
+
+    memset(&h, 0, sizeof (h));
+    memcpy(h.magic, "MESHVWZ", 8);
+    h.version = CONTAINER_VERSION;
+    h.byte_order = 0x01020304;
+    h.n_vertex = n_vertex;
+    h.n_faces = n_faces;
+    h.n_indices = total_indices();
+    h.n_lod = n_lod;
+    h.is_colored = isColored;
+    memcpy(h.max_coord, max_coord, sizeof (max_coord));
+    memcpy(h.min_coord, min_coord, sizeof (min_coord));
+    memcpy(h.lod, lod, sizeof (lod));
+
+    f = fopen(filename, "wb");
+    if (f == NULL)
+        return -1;
+
+    // buffers for a block and for its compressed form
+    line = __LINE__ + 1;
+    raw = (unsigned char*) malloc(CONTAINER_BLOCK + lz_bound(CONTAINER_BLOCK));
+    if (raw == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    fwrite(&h, sizeof (h), 1, f);
+    container_write_vertices(f, raw, raw + CONTAINER_BLOCK);
+    container_write_indices(f, raw, raw + CONTAINER_BLOCK);
+    free(raw);
+
+    error = ferror(f);
+    if (fclose(f) || error)
     {
-        printf("Invalid file header, nothing to draw is declared.\n");
+        remove(filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+ * Decode a vertex block into the packed array, starting from the vertex
+ * <code>first</code>. Return -1 if the block size does not match.
+ */
+static int container_decode_vertices(const unsigned char *raw, int size,
+        Packed_vertex *packed, int first)
+{
+    const int m = n_vertex - first < CONTAINER_VERTICES
+                  ? n_vertex - first : CONTAINER_VERTICES;
+    float scale[3];
+    unsigned int last[9] = {0};
+    int i, k;
+
+    if (size != (isColored ? 12 : 9) * m)
         return -1;
-    }        
 
-    // read vertex, normals and color data:
-    // i index iterates on vertices;
-    // j index tracks the position of first of the three components for the
-    //     current tuple in each array;
-    // k index iterates inside each tuple.
-    j = 0;
-    for (i = 0; i < n_vertex; i++)
+    for (k = 0; k < 3; ++k)
+        scale[k] = (max_coord[k] - min_coord[k]) / 65535;
+
+    for (i = 0; i < m; ++i)
     {
-        // get vertex coordinates
+        Packed_vertex *v = packed + first + i;
         for (k = 0; k < 3; ++k)
         {
-            fscanf(f_ply, "%f", &vertexp[j + k]);
+            last[k] = (last[k] + (raw[2 * k * m + i]
+                                  | raw[(2 * k + 1) * m + i] << 8)) & 0xffff;
+            v->position[k] = min_coord[k] + last[k] * scale[k];
 
-            // search greatest and smallest coords
-            if (vertexp[j + k] > max_coord[k])
-                max_coord[k] = vertexp[j + k];
-            if (vertexp[j + k] < min_coord[k])
-                min_coord[k] = vertexp[j + k];
+            last[3 + k] = (last[3 + k] + raw[(6 + k) * m + i]) & 0xff;
+            v->normal[k] = (GLbyte) last[3 + k];
 
-            #ifdef __DEBUG__
-            printf("%.2f ", vertexp[j + k]);
-            #endif
+            if (isColored)
+                last[6 + k] = (last[6 + k] + raw[(9 + k) * m + i]) & 0xff;
+            v->color[k] = isColored ? last[6 + k] : 255;
         }
+        v->normal[3] = 0;
+        v->color[3] = 255;
+    }
 
-        #ifdef __DEBUG__
-        printf("  ");
-        #endif
+    return 0;
+}
 
-        // get normal components
-        for (k = 0; k < 3; ++k)
+/*!
+ * Decode an index block, starting from the index <code>first</code>.
+ * Return -1 if the block is malformed or an index is out of range.
+ */
+static int container_decode_indices(const unsigned char *raw, int size,
+        int n, int first)
+{
+    const unsigned char *p = raw, *end = raw + size;
+    const int m = n - first < CONTAINER_INDICES ? n - first : CONTAINER_INDICES;
+    unsigned int last = 0;
+    int i, shift;
+
+    for (i = first; i < first + m; ++i)
+    {
+        unsigned int z = 0;
+        for (shift = 0; ; shift += 7)
         {
-            fscanf(f_ply, "%f", &normals[j + k]);
-            #ifdef __DEBUG__
-            printf("% .2f ", normals[j + k]);
-            #endif
+            if (p == end || shift > 28)
+                return -1;
+            z |= (unsigned int) (*p & 0x7f) << shift;
+            if (!(*p++ & 0x80))
+                break;
         }
+        last += (z >> 1) ^ -(z & 1);
+        if (last >= (unsigned int) n_vertex)
+            return -1;
+        indices[i] = last;
+    }
 
-        #ifdef __DEBUG__
-        printf("  ");
-        #endif
+    return p == end ? 0 : -1;
+}
 
-        // get color components
-        if (isColored)
+/*!
+ * The container is read one block at a time, and each block is decoded
+ * straight into the packed vertex array or the index array, which are then
+ * uploaded unchanged by upload_model(void). Since the model was already
+ * optimized and simplified before being stored, only the clusters are
+ * built again, so that loading a container is faster than parsing a PLY
+ * file even if the decoding takes some time.
+ */
+int load_container(const char *filename)
+{
+    Container_header h;
+    Packed_vertex *packed = NULL;
+    unsigned char *raw;
+    size_t v_size;
+    FILE *f;
+    int blocks, block = 0, first, size, l, line, error = 0;
+
+    f = fopen(filename, "rb");
+    if (f == NULL)
+    {
+        printf("Unable to open the file %s.\n", filename);
+        return -1;
+    }
+
+    // check header
+    if (fread(&h, sizeof (h), 1, f) != 1
+            || memcmp(h.magic, "MESHVWZ", 8)
+            || h.version != CONTAINER_VERSION
+            || h.byte_order != 0x01020304
+            || h.n_vertex <= 0
+            || h.n_indices < 0
+            || h.n_lod < 1
+            || h.n_lod > MAX_LOD_LEVELS
+            || h.n_faces != h.lod[0].count / 3
+            || h.lod[0].count % 3)
+    {
+        printf("Invalid or unsupported container file %s.\n", filename);
+        fclose(f);
+        return -1;
+    }
+    for (l = 0; l < h.n_lod; ++l)
+        if (h.lod[l].first < 0 || h.lod[l].count < 0
+                || h.lod[l].first > h.n_indices - h.lod[l].count)
         {
-            for (k = 0; k < 3; ++k)
-            {
-                fscanf(f_ply, "%f", &color[j + k]);
-                #ifdef __DEBUG__
-                printf("%.2f ", color[j + k]);
-                #endif
-            }
+            printf("Invalid or unsupported container file %s.\n", filename);
+            fclose(f);
+            return -1;
         }
 
-        #ifdef __DEBUG__
-        printf("\n");
-        #endif
+    n_vertex = h.n_vertex;
+    n_faces = h.n_faces;
+    isColored = h.is_colored;
+    memcpy(max_coord, h.max_coord, sizeof (max_coord));
+    memcpy(min_coord, h.min_coord, sizeof (min_coord));
+    memcpy(lod, h.lod, sizeof (lod));
+    n_lod = h.n_lod;
+
+    // packed vertices and indices in a single arena
+    v_size = arena_pad(sizeof (Packed_vertex) * n_vertex);
+    arena_size = v_size + sizeof (GLuint) * ((size_t) h.n_indices + 1);
+    arena = alloc_arena(arena_size);
+    if (arena == NULL)
+    {
+        printf("Not enough memory for the model.\n");
+        arena_size = 0;
+        fclose(f);
+        return -1;
+    }
+    packed = (Packed_vertex*) arena;
+    indices = (GLuint*) ((char*) arena + v_size);
+
+    line = __LINE__ + 1;
+    raw = (unsigned char*) malloc(CONTAINER_BLOCK + lz_bound(CONTAINER_BLOCK));
+    if (raw == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    // decode block by block
+    start_preview(n_vertex);
+    blocks = (n_vertex + CONTAINER_VERTICES - 1) / CONTAINER_VERTICES
+             + (h.n_indices + CONTAINER_INDICES - 1) / CONTAINER_INDICES;
+    set_load_progress("Decoding", 0);
+    for (first = 0; !error && first < n_vertex; first += CONTAINER_VERTICES)
+    {
+        size = container_read_block(f, raw, raw + CONTAINER_BLOCK);
+        error = size < 0
+                || container_decode_vertices(raw, size, packed, first);
+        if (!error)
+            add_preview(packed + first, sizeof (Packed_vertex), first,
+                    n_vertex - first < CONTAINER_VERTICES
+                    ? n_vertex - first : CONTAINER_VERTICES);
+        set_load_progress("Decoding", (float) ++block / blocks);
+    }
+    for (first = 0; !error && first < h.n_indices; first += CONTAINER_INDICES)
+    {
+        size = container_read_block(f, raw, raw + CONTAINER_BLOCK);
+        error = size < 0
+                || container_decode_indices(raw, size, h.n_indices, first);
+        set_load_progress("Decoding", (float) ++block / blocks);
+    }
+    free(raw);
+    fclose(f);
+
+    if (error)
+    {
+        printf("Corrupted container file %s.\n", filename);
+        release_model();
+        return -1;
+    }
+
+    // point model arrays inside the packed array
+    vertexp = packed[0].position;
+    normals = (GLfloat*) ((char*) packed + offsetof(Packed_vertex, normal));
+    color = (GLfloat*) ((char*) packed + offsetof(Packed_vertex, color));
+    vertex_stride = sizeof (Packed_vertex);
+    normal_type = GL_BYTE;
+    color_type = GL_UNSIGNED_BYTE;
+    element_type = GL_UNSIGNED_INT;
+
+    // colors are bytes already, with nothing for init_model(void) to do,
+    // and the model is framed by frame_model(const Mesh*) when published
+
+    // clusters are built on 32 bit indices, then indices are shrunk
+    build_clusters();
+    shrink_indices();
+
+    return 0;
+}
+
+/*!
+ * The model is loaded as usual (from its cache if valid), then written
+ * into the container, reporting the size reduction.
+ */
+int compress_model(char *source, const char *target, char *path)
+{
+    #if defined(__APPLE__) || defined(__linux__)
+    struct stat st_source, st_target;
+    #endif // defined(__APPLE__) || defined(__linux__)
+
+    if (open_model(source, path))
+        return EXIT_FAILURE;
 
-        j += 3;
+    // a scene has no single model to be written
+    if (scene_loaded())
+    {
+        printf("A scene cannot be written into a container.\n");
+        return EXIT_FAILURE;
     }
 
-    // get faces data
-    k = 0;
-    for (i = 0; i < n_faces; ++i)
+    if (save_container(target))
     {
-        char buf[10];
+        printf("Unable to write the container file %s.\n", target);
+        return EXIT_FAILURE;
+    }
 
-        fscanf(f_ply, "%s", buf); // number of vertices per face (useless)
+    #if defined(__APPLE__) || defined(__linux__)
+    if (!stat(source, &st_source) && !stat(target, &st_target))
+        printf("%s: %lld bytes, %s: %lld bytes (%.1fx smaller).\n",
+                source, (long long) st_source.st_size,
+                target, (long long) st_target.st_size,
+                (double) st_source.st_size / st_target.st_size);
+    #endif // defined(__APPLE__) || defined(__linux__)
 
-        // get indexes of vertices for each face
-        for (j = 0; j < 3; ++j)
-        {
-            fscanf(f_ply, "%u", &indices[k++]);
-            #ifdef __DEBUG__
-            printf("%u ", indices[k - 1]);
-            #endif
-        }
+    return EXIT_SUCCESS;
+}
 
-        #ifdef __DEBUG__
-        printf("\n");
-        #endif
+/*!
+ * Replace the model just processed and cached with the mapping of its cache
+ * file, as if it was loaded from it. The file mapping used while parsing
+ * is released by pack_model(void), so this way even the first viewer of a
+ * model draws it from a read-only mapping, whose pages are shared with the
+ * other processes showing the same model. The processed copy is kept if
+ * the cache cannot be read back.
+ */
+static void reopen_from_cache(const char *filename)
+{
+    Mesh processed, cached;
+
+    store_mesh(&processed);
+    if (load_cache(filename))
+    {
+        select_mesh(&processed);
+        return;
     }
+    store_mesh(&cached);
+    release_mesh(&processed);
+    select_mesh(&cached);
+}
 
-    // release file
-    fclose(f_ply);
+/*!
+ * The model previously opened and not stored nor published, if any, is
+ * released first, so that models can be opened again and again with a
+ * flat memory footprint. Scenes are loaded with load_scene(const char*,
+ * char*), which opens each of their models in turn. Compressed containers
+ * are decoded with load_container(const char*). Other models are loaded
+ * from their cache when possible. Otherwise it is parsed and processed with
+ * process_model(void), then the cache is written for the next time and the
+ * model is drawn from it. The time spent in each phase is recorded for the
+ * profiler.
+ */
+int open_model(char *filename, char *path)
+{
+    double start = profile_now();
 
-    #ifdef __DEBUG__
-    printf( "\n      min       max\n"
-            "x: %f %f\n"
-            "y: %f %f\n"
-            "z: %f %f\n",
-            min_coord[0],
-            max_coord[0],
-            min_coord[1],
-            max_coord[1],
-            min_coord[2],
-            max_coord[2]
-            );
-    #endif // __DEBUG__
+    // release what a previous load or a failed attempt left
+    if (scene_loaded())
+        release_scene();
+    release_model();
+
+    // scenes are made of several models, opened by the scene loader
+    if (has_suffix(filename, SCENE_SUFFIX))
+        return load_scene(filename, path);
+
+    // chunked models are drawn from disk, only the hierarchy is read
+    if (has_suffix(filename, OOC_SUFFIX))
+    {
+        Chunk_header h;
+        if (open_chunks(filename, &h))
+            return -1;
+        n_vertex = h.n_vertex;
+        n_faces = h.n_faces;
+        isColored = h.is_colored;
+        memcpy(max_coord, h.max_coord, sizeof (h.max_coord));
+        memcpy(min_coord, h.min_coord, sizeof (h.min_coord));
+        n_lod = 0;
+        color_type = GL_UNSIGNED_BYTE;
+        chunked_model = 1;
+        init_model();
+        profile_load_phase("chunks", profile_now() - start);
+        set_load_progress("Uploading", 1);
+        return 0;
+    }
+
+    // compressed containers are already processed
+    if (has_suffix(filename, CONTAINER_SUFFIX))
+    {
+        if (load_container(filename))
+            return -1;
+        profile_load_phase("decode", profile_now() - start);
+        set_load_progress("Uploading", 1);
+        return 0;
+    }
+
+    set_load_progress("Reading cache", 0);
+    if (!load_cache(filename))
+    {
+        profile_load_phase("cache", profile_now() - start);
+        set_load_progress("Uploading", 1);
+        return 0;
+    }
+
+    start = profile_now();
+    if (parse_file(filename, path))
+        return -1;
+    profile_load_phase("parse", profile_now() - start);
+
+    start = profile_now();
+    process_model();
+    profile_load_phase("process", profile_now() - start);
+
+    start = profile_now();
+    if (!save_cache(filename))
+    {
+        reopen_from_cache(filename);
+        profile_load_phase("save_cache", profile_now() - start);
+    }
 
     return 0;
 }
 
 /*!
- * This procedure determines the bounding box center and radius. Radius
- * is also used to to setup initial camera position. If the model is colored,
- * this procedure converts the color from [0, 255] to [0, 1].
+ * Load the model with open_model(char*, char*), asking the user for another
+ * file while the given one is not valid, if allowed to. A model named on
+ * the command line is not replaced by a file asked to the user, so that
+ * scripted runs fail instead of waiting for input.
  */
-void init_model(void)
+int load_model(char *filename, char *path, int ask)
 {
-    int i;
+    while (open_model(filename, path))
+    {
+        if (!ask)
+            return -1;
+        get_filename(filename);
+    }
 
-    // find the center of the model bounding box
-    center.x = (max_coord[0] + min_coord[0]) / 2;
-    center.y = (max_coord[1] + min_coord[1]) / 2;
-    center.z = (max_coord[2] + min_coord[2]) / 2;
+    return 0;
+}
 
-    // set bounding box radius
-    bb_radius = 1.0f / 4.0f * sqrt(
-              (max_coord[0] - min_coord[0]) * (max_coord[0] - min_coord[0])
-            + (max_coord[1] - min_coord[1]) * (max_coord[1] - min_coord[1])
-            + (max_coord[2] - min_coord[2]) * (max_coord[2] - min_coord[2]));
+/*!
+ * Do all the processing on a parsed model which does not need an OpenGL
+ * context, namely vertex cache optimization, initialization and levels of
+ * detail building.
+ */
+void process_model(void)
+{
+    // compute the normals missing from the model file
+    if (normals_missing)
+        compute_normals();
 
-    // set initial eye position out of the bounding box
-    eye.rho = INITIAL_DISTANCE_RATIO * bb_radius;
+    // reorder triangles and vertices for the vertex cache, if enabled
+    set_load_progress("Optimizing", 0);
+    optimize_model();
 
-    // scale initial position for very small models
-    if (bb_radius < MIN_BB_RADIUS)
-        eye.rho *= MIN_BB_RADIUS / bb_radius;
+    // convert color into [0, 1] range
+    init_model();
 
-    // convert color into [0,1]
-    if (isColored)
-        for(i = 0; i < n_vertex * 3; i++)
-            color[i] /= 255;
+    // build simplified versions of the model, if enabled
+    set_load_progress("Simplifying", 0);
+    build_lod();
+
+    // split the levels of detail in clusters for culling, if enabled
+    build_clusters();
+
+    // convert into the compact format drawn by the GPU, if enabled
+    if (packed_vertices)
+        pack_model();
+
+    set_load_progress("Uploading", 1);
+}
+
+#if defined(__APPLE__) || defined(__linux__)
+/*!
+ * Body of the thread loading the model in background.
+ */
+static void *loader_main(void *arg)
+{
+    UNUSED(arg);
+
+    load_failed = load_model(load_filename, load_path, ask_filename) != 0;
+
+    pthread_mutex_lock(&load_mutex);
+    load_done = 1;
+    pthread_mutex_unlock(&load_mutex);
+
+    return NULL;
+}
+#endif // defined(__APPLE__) || defined(__linux__)
+
+/*!
+ * Open the model again after a change of its files. On failure, whatever
+ * was loaded is released and the model shown is kept.
+ */
+static void reload_model(void)
+{
+    if (open_model(load_filename, load_path))
+    {
+        release_scene();
+        release_model();
+        load_failed = 1;
+    }
+}
+
+#if defined(__APPLE__) || defined(__linux__)
+/*!
+ * Body of the thread loading the model again in background.
+ */
+static void *reloader_main(void *arg)
+{
+    UNUSED(arg);
+
+    reload_model();
+
+    pthread_mutex_lock(&load_mutex);
+    load_done = 1;
+    pthread_mutex_unlock(&load_mutex);
+
+    return NULL;
+}
+#endif // defined(__APPLE__) || defined(__linux__)
+
+/*!
+ * The model is loaded by a separate thread, so that the window can be shown
+ * immediately. Until check_loading(int) finds the loading completed, the
+ * model globals belong to the loader thread and display(void) only draws
+ * the loading progress, since there is no model to be shown yet.
+ */
+void start_loading(char *filename, char *path, int ask)
+{
+    strncpy(load_filename, filename, STR_LEN);
+    load_path = path;
+    ask_filename = ask;
+    load_failed = 0;
+    load_done = 0;
+    model_ready = 0;
+
+    #if defined(__APPLE__) || defined(__linux__)
+    // the preview is shown only while loading in background
+    preview.points = (GLfloat*) malloc(sizeof (GLfloat) * 3 * PREVIEW_POINTS);
+    if (!pthread_create(&loader, NULL, loader_main, NULL))
+        return;
+    free(preview.points);
+    preview.points = NULL;
+    #endif // defined(__APPLE__) || defined(__linux__)
+
+    // no threads, load synchronously
+    load_failed = load_model(load_filename, load_path, ask_filename) != 0;
+    load_done = 1;
+}
+
+/*!
+ * Append the preview points published since the last call to the preview
+ * buffer object, creating it with room for `PREVIEW_POINTS` points the
+ * first time. Without buffer objects, the points are drawn from the host
+ * array.
+ */
+static void upload_preview(void)
+{
+    float max[3], min[3];
+    int count, k;
+
+    #if defined(__APPLE__) || defined(__linux__)
+    pthread_mutex_lock(&load_mutex);
+    #endif // defined(__APPLE__) || defined(__linux__)
+    count = preview.count;
+    memcpy(max, preview.max_coord, sizeof max);
+    memcpy(min, preview.min_coord, sizeof min);
+    #if defined(__APPLE__) || defined(__linux__)
+    pthread_mutex_unlock(&load_mutex);
+    #endif // defined(__APPLE__) || defined(__linux__)
+
+    if (count <= preview.uploaded)
+        return;
+
+    if (!preview.buffer && buffer_objects_supported())
+    {
+        glGenBuffers(1, &preview.buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, preview.buffer);
+        glBufferData(GL_ARRAY_BUFFER,
+                sizeof (GLfloat) * 3 * PREVIEW_POINTS, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    if (preview.buffer)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, preview.buffer);
+        glBufferSubData(GL_ARRAY_BUFFER,
+                sizeof (GLfloat) * 3 * preview.uploaded,
+                sizeof (GLfloat) * 3 * (count - preview.uploaded),
+                preview.points + 3 * preview.uploaded);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    preview.uploaded = count;
+
+    // frame the points read so far
+    preview.center.x = (max[0] + min[0]) / 2;
+    preview.center.y = (max[1] + min[1]) / 2;
+    preview.center.z = (max[2] + min[2]) / 2;
+    preview.radius = 0;
+    for (k = 0; k < 3; ++k)
+        preview.radius += (max[k] - min[k]) * (max[k] - min[k]);
+    preview.radius = 1.0f / 4.0f * sqrt(preview.radius);
+}
+
+/*!
+ * This function is scheduled with a `LOAD_CHECK_GAP` timing until the
+ * loading is completed. Then it publishes the model, creates the menu
+ * (which depends on the model having color or not) and, after the first
+ * loading, starts the automatic rotation. From then on the model files
+ * are watched by check_reload(int).
+ */
+void check_loading(int value)
+{
+    int done;
+    double start;
+
+    UNUSED(value);
+
+    #if defined(__APPLE__) || defined(__linux__)
+    pthread_mutex_lock(&load_mutex);
+    #endif // defined(__APPLE__) || defined(__linux__)
+    done = load_done;
+    #if defined(__APPLE__) || defined(__linux__)
+    pthread_mutex_unlock(&load_mutex);
+    #endif // defined(__APPLE__) || defined(__linux__)
+
+    if (!done)
+    {
+        upload_preview();
+        glutTimerFunc(LOAD_CHECK_GAP, check_loading, 0);
+        glutPostRedisplay(); // refresh preview and progress bar
+        return;
+    }
+
+    #if defined(__APPLE__) || defined(__linux__)
+    pthread_join(loader, NULL);
+    #endif // defined(__APPLE__) || defined(__linux__)
+
+    // release the preview
+    if (preview.buffer)
+        glDeleteBuffers(1, &preview.buffer);
+    free(preview.points);
+    memset(&preview, 0, sizeof (preview));
+
+    // a model given on the command line could not be opened
+    if (load_failed && !reloading)
+    {
+        printf("Unable to load %s.\n", load_filename);
+        exit(EXIT_FAILURE);
+    }
+
+    // a chunked model is closed before reloading, so nothing is left to
+    // draw until the next change loads it successfully
+    if (load_failed && !model_ready)
+    {
+        printf("Unable to reload %s, the model was closed.\n",
+                load_filename);
+        set_load_progress("Unable to reload", 0);
+        glutPostRedisplay();
+    }
+    else if (load_failed)
+        printf("Unable to reload %s, the previous model is kept.\n",
+                load_filename);
+
+    if (load_failed)
+    {
+        reloading = 0;
+        glutTimerFunc(RELOAD_CHECK_GAP, check_reload, 0);
+        return;
+    }
+
+    // upload model into buffer objects, when supported, and show it
+    start = profile_now();
+    publish_model(reloading);
+    glFinish();
+    profile_load_phase("upload", profile_now() - start);
+    profile_report_load();
+
+    createGLUTMenu();
+    model_ready = 1;
+
+    // launch the scheduler which updates angle for rotation
+    // i.e. model rotation starts automatically once the model is loaded
+    if (rotate && !reloading)
+        start_animation();
+    reloading = 0;
+
+    // watch the model files (already watched ones are kept)
+    watch_file(load_filename);
+    watch_scene();
+    glutTimerFunc(RELOAD_CHECK_GAP, check_reload, 0);
+
+    glutPostRedisplay();
+}
+
+/*!
+ * A changed model file is reloaded once it has been left untouched for
+ * `RELOAD_SETTLE_TIME` ms, so that it is not read while being written.
+ * The model is opened again in background, as by start_loading(char*,
+ * char*, int) but without preview, while display(void) keeps drawing the
+ * model shown, which check_loading(int) replaces keeping the camera, the
+ * rotation and the other view settings. A chunked model is closed first,
+ * since the chunk reader holds a single model, so it is not kept if the
+ * reload fails.
+ */
+void check_reload(int value)
+{
+    UNUSED(value);
+
+    if (!watch_changed(RELOAD_SETTLE_TIME))
+    {
+        glutTimerFunc(RELOAD_CHECK_GAP, check_reload, 0);
+        return;
+    }
+
+    printf("%s changed, reloading.\n", load_filename);
+    if (shown_model.chunked)
+    {
+        model_ready = 0;
+        release_mesh(&shown_model);
+    }
+    reloading = 1;
+    load_failed = 0;
+    load_done = 0;
+    set_load_progress("Loading", 0);
+
+    #if defined(__APPLE__) || defined(__linux__)
+    if (!pthread_create(&loader, NULL, reloader_main, NULL))
+    {
+        glutTimerFunc(LOAD_CHECK_GAP, check_loading, 0);
+        return;
+    }
+    #endif // defined(__APPLE__) || defined(__linux__)
+
+    // no threads, reload synchronously
+    reload_model();
+    load_done = 1;
+    glutTimerFunc(0, check_loading, 0);
+}
+
+/*!
+ * The progress is protected by a lock, since it is written by the loader
+ * thread and read by display(void).
+ */
+void set_load_progress(const char *stage, float progress)
+{
+    #if defined(__APPLE__) || defined(__linux__)
+    pthread_mutex_lock(&load_mutex);
+    #endif // defined(__APPLE__) || defined(__linux__)
+    load_stage = stage;
+    load_progress = progress;
+    #if defined(__APPLE__) || defined(__linux__)
+    pthread_mutex_unlock(&load_mutex);
+    #endif // defined(__APPLE__) || defined(__linux__)
+}
+
+/*!
+ * The vertices are sampled uniformly, with a step such that the whole model
+ * fits in `PREVIEW_POINTS` points. Nothing is done unless the preview
+ * array was allocated by start_loading(char*, char*, int).
+ */
+void start_preview(int n)
+{
+    int k;
+
+    if (preview.points == NULL)
+        return;
+
+    #if defined(__APPLE__) || defined(__linux__)
+    pthread_mutex_lock(&load_mutex);
+    #endif // defined(__APPLE__) || defined(__linux__)
+    preview.step = n > PREVIEW_POINTS
+                   ? (n + PREVIEW_POINTS - 1) / PREVIEW_POINTS : 1;
+    preview.count = 0;
+    for (k = 0; k < 3; ++k)
+    {
+        preview.max_coord[k] = -FLT_MAX;
+        preview.min_coord[k] = FLT_MAX;
+    }
+    #if defined(__APPLE__) || defined(__linux__)
+    pthread_mutex_unlock(&load_mutex);
+    #endif // defined(__APPLE__) || defined(__linux__)
+}
+
+/*!
+ * The vertices of the range whose index is a multiple of the sampling step
+ * are appended to the preview. Ranges may be added in any order (e.g. by
+ * the threads of the parallel parser), since the order of the points is
+ * not relevant.
+ */
+void add_preview(const void *vertices, size_t stride, long first, long count)
+{
+    long i;
+    int k;
+
+    if (preview.points == NULL || preview.step == 0)
+        return;
+
+    #if defined(__APPLE__) || defined(__linux__)
+    pthread_mutex_lock(&load_mutex);
+    #endif // defined(__APPLE__) || defined(__linux__)
+    for (i = (first + preview.step - 1) / preview.step * preview.step;
+            i < first + count && preview.count < PREVIEW_POINTS;
+            i += preview.step)
+    {
+        GLfloat *p = preview.points + 3 * preview.count++;
+        memcpy(p, (const char*) vertices + (i - first) * stride,
+                3 * sizeof (GLfloat));
+        for (k = 0; k < 3; ++k)
+        {
+            if (p[k] > preview.max_coord[k])
+                preview.max_coord[k] = p[k];
+            if (p[k] < preview.min_coord[k])
+                preview.min_coord[k] = p[k];
+        }
+    }
+    #if defined(__APPLE__) || defined(__linux__)
+    pthread_mutex_unlock(&load_mutex);
+    #endif // defined(__APPLE__) || defined(__linux__)
 }
 
 /*!
@@ -974,6 +6258,44 @@ void get_filename(char *fileName)
     }
 }
 
+/*!
+ * The options shared by the viewer, the benchmark and the batch mode set
+ * how models are processed (and cached) and drawn; the ones taking a value
+ * are ignored when it is missing, so that it is reported as an unknown
+ * argument by the caller.
+ */
+int parse_option(int argc, char *argv[], int *i)
+{
+    const char *option = argv[*i];
+    const int has_value = *i + 1 < argc;
+
+    if (!strcmp(option, "--trace") && has_value)
+        return profile_open_trace(argv[++*i]) ? -1 : 1;
+
+    if (!strcmp(option, "--budget") && has_value)
+        set_chunk_budget((size_t) atoi(argv[++*i]) << 20);
+    else if (!strcmp(option, "--crease") && has_value)
+        set_crease_angle(atof(argv[++*i]));
+    else if (!strcmp(option, "--no-packed"))
+        packed_vertices = 0;
+    else if (!strcmp(option, "--no-optimize"))
+        optimize_vertex_cache = 0;
+    else if (!strcmp(option, "--no-lod"))
+        lod_enabled = 0;
+    else if (!strcmp(option, "--no-culling"))
+        cluster_culling = 0;
+    else if (!strcmp(option, "--cull-back-faces"))
+        cull_backfaces = 1;
+    else if (!strcmp(option, "--no-cache"))
+        cache_writing = 0;
+    else if (!strcmp(option, "--cache"))
+        cache_writing = 1;
+    else
+        return 0;
+
+    return 1;
+}
+
 /*!
  * This procedure writes an adequately descriptive error message on
  * <code>stdout</code>, descibing the error encountered, then it
@@ -24,6 +24,7 @@
 #ifdef __APPLE__
     #include <GLUT/glut.h>
 #else
+    #define GL_GLEXT_PROTOTYPES
     #include <GL/glut.h>
     #include <GL/glext.h>
 #endif
@@ -38,6 +39,60 @@
 /*! Maximum string length. */
 #define STR_LEN 200
 
+/*! Maximum number of properties that can be declared for a .ply element. */
+#define MAX_PLY_PROPERTIES 32
+
+/*! Maximum number of elements that can be declared in a .ply header. */
+#define MAX_PLY_ELEMENTS 16
+
+/*! Maximum number of vertices of a polygonal face. */
+#define MAX_FACE_VERTICES 1024
+
+/*! Number of records fetched with a single read from a binary .ply body. */
+#define PLY_CHUNK_RECORDS 65536
+
+/*! Size of the blocks read at once from an ASCII .ply body. */
+#define TEXT_BLOCK_SIZE (1 << 20)
+
+/*! Minimum size of the part of an ASCII .ply body parsed by each thread. */
+#define PARSE_MIN_CHUNK (1 << 22)
+
+/*! Maximum number of threads used to parse an ASCII .ply body. */
+#define MAX_PARSE_THREADS 64
+
+/*! Minimum number of faces given to each thread computing normals. */
+#define NORMAL_MIN_FACES (1 << 18)
+
+/*! Component slot of a property not stored in the model. */
+#define PLY_UNUSED -1
+
+/*! Component slot of the list of vertex indices of a face. */
+#define PLY_INDICES 9
+
+/*! Size of the FIFO post-transform vertex cache targeted by optimization. */
+#define VERTEX_CACHE_SIZE 16
+
+/*! Maximum number of levels of detail, including the full model. */
+#define MAX_LOD_LEVELS 8
+
+/*! Grid resolution used to simplify the first level of detail. */
+#define LOD_MAX_GRID 1024
+
+/*! A level of detail is not built if it has fewer faces than this. */
+#define LOD_MIN_FACES 256
+
+/*! Maximum error on screen (in pixels) allowed when choosing the LOD. */
+#define LOD_PIXEL_ERROR 1.0f
+
+/*! Number of triangles in each cluster tested for visibility. */
+#define CLUSTER_FACES 128
+
+/*! Alignment of the arrays inside a model arena, in bytes. */
+#define ARENA_ALIGN 64
+
+/*! Size of a huge page, the alignment of the arenas at least this large. */
+#define ARENA_HUGE_PAGE (2 << 20)
+
 /*!
  * Path of the directory containing models (with final separator).
  */
@@ -47,9 +102,63 @@
     #define MODEL_DIR "Model\\"
 #endif // defined(__APPLE__) || defined(__linux__)
 
-/*! Time between two consecutive angle updates. */
+/*! Default width of the viewer window. */
+#define WINDOW_WIDTH 1920
+
+/*! Default height of the viewer window. */
+#define WINDOW_HEIGHT 1080
+
+/*! Time unit (in ms) for rotation and camera speeds. */
 #define TIME_GAP 15
 
+/*! Maximum time (in `TIME_GAP` units) advanced by a single frame. */
+#define MAX_FRAME_STEPS 10.0f
+
+/*! Time between two consecutive checks of the model loading progress. */
+#define LOAD_CHECK_GAP 100
+
+/*! Time between two consecutive checks for changes of the model files. */
+#define RELOAD_CHECK_GAP 250
+
+/*!
+ * Time (in ms) a changed model file must stay untouched before being
+ * reloaded, so that it is not read while still being written.
+ */
+#define RELOAD_SETTLE_TIME 300
+
+/*!
+ * Size of the blocks compared to upload only the changed parts of a
+ * reloaded model.
+ */
+#define RELOAD_BLOCK_SIZE (64 << 10)
+
+/*! Suffix appended to the model filename to name its cache file. */
+#define CACHE_SUFFIX ".cache"
+
+/*! Version of the cache file format, to be increased on every change. */
+#define CACHE_VERSION 2
+
+/*! Alignment of each section of the cache file. */
+#define CACHE_ALIGN 16
+
+/*! Maximum number of vertices shown in the preview while loading. */
+#define PREVIEW_POINTS (1 << 18)
+
+/*! Extension of the compressed model container files. */
+#define CONTAINER_SUFFIX ".mvz"
+
+/*! Version of the container format, to be increased on every change. */
+#define CONTAINER_VERSION 1
+
+/*! Number of vertices in each block of a container. */
+#define CONTAINER_VERTICES 4096
+
+/*! Number of indices in each block of a container. */
+#define CONTAINER_INDICES (3 * 4096)
+
+/*! Maximum uncompressed size of a block of a container. */
+#define CONTAINER_BLOCK (5 * CONTAINER_INDICES)
+
 /*! Unit variation applied while changing the angular speed. */
 #define ANGULAR_INCREMENT 7e-2f
 
@@ -86,6 +195,9 @@
 /*! Minimum bounding box radius value, above which the model is scaled up. */
 #define MIN_BB_RADIUS 2.0f
 
+/*! Convert a byte offset inside a buffer object into a pointer for OpenGL. */
+#define BUFFER_OFFSET(n) ((GLvoid*) (size_t) (n))
+
 /*!
  * This macro is a simple portable way to suppress unused variable warning
  * on most compilers. Note that this macro just suppress the warning
@@ -135,6 +247,268 @@ typedef enum Speed_variation
     
 } Speed_variation;
 
+/*!
+ * Type defining the encoding of the body of a .ply file, as declared by the
+ * `format` line of its header.
+ */
+typedef enum Ply_format
+{
+    PLY_ASCII = 1,     /*!< Text body. */
+    PLY_BINARY_LE = 2, /*!< Binary body, little endian byte order. */
+    PLY_BINARY_BE = 3  /*!< Binary body, big endian byte order. */
+} Ply_format;
+
+/*!
+ * Type defining the scalar types a .ply property may be declared with.
+ */
+typedef enum Ply_type
+{
+    PLY_CHAR = 1,   /*!< Signed 8 bit integer. */
+    PLY_UCHAR = 2,  /*!< Unsigned 8 bit integer. */
+    PLY_SHORT = 3,  /*!< Signed 16 bit integer. */
+    PLY_USHORT = 4, /*!< Unsigned 16 bit integer. */
+    PLY_INT = 5,    /*!< Signed 32 bit integer. */
+    PLY_UINT = 6,   /*!< Unsigned 32 bit integer. */
+    PLY_FLOAT = 7,  /*!< 32 bit floating point. */
+    PLY_DOUBLE = 8  /*!< 64 bit floating point. */
+} Ply_type;
+
+/*!
+ * Type for the declaration of a .ply property.
+ */
+typedef struct Ply_property Ply_property;
+
+/*!
+ * Structure defining the declaration of a property of a .ply element,
+ * either a scalar or a list, and the model component it is stored into.
+ */
+struct Ply_property
+{
+    Ply_type type;       /*!< Type of the value, or of the list items. */
+    Ply_type count_type; /*!< Type of the list length, 0 for a scalar. */
+    int slot;            /*!< Model component: 0-2 coordinates, 3-5 normal,
+                              6-8 color, `PLY_INDICES` for the vertex list
+                              of a face, or `PLY_UNUSED`. */
+};
+
+/*!
+ * Type for the declaration of a .ply element.
+ */
+typedef struct Ply_element Ply_element;
+
+/*!
+ * Structure defining the declaration of an element of a .ply file, i.e.
+ * the number and the layout of its records.
+ */
+struct Ply_element
+{
+    long count;          /*!< Number of records. */
+    Ply_property props[MAX_PLY_PROPERTIES]; /*!< Properties, in declaration
+                                                 order. */
+    int n_props;         /*!< Number of properties. */
+    int stride;          /*!< Size of a binary record, 0 if it has lists. */
+};
+
+/*!
+ * Type for the declarations found in the header of a .ply file.
+ */
+typedef struct Ply_header Ply_header;
+
+/*!
+ * Structure defining the declarations of a .ply header: body format and
+ * elements, in the order their records appear in the body. Only the
+ * `vertex` and `face` elements are used by the model, the other ones are
+ * skipped.
+ */
+struct Ply_header
+{
+    Ply_format format;       /*!< Encoding of the body. */
+    Ply_element elements[MAX_PLY_ELEMENTS]; /*!< Declared elements. */
+    int n_elements;          /*!< Number of declared elements. */
+    int vertex_element;      /*!< Index of the vertex element. */
+    int face_element;        /*!< Index of the face element. */
+    int n_vertex;            /*!< Number of vertices. */
+    int n_faces;             /*!< Number of faces. */
+    int is_colored;          /*!< Nonzero if vertices have color. */
+    int has_normals;         /*!< Nonzero if vertices have normals. */
+};
+
+/*!
+ * Type for a buffered reader of a .ply body.
+ */
+typedef struct Text_reader Text_reader;
+
+/*!
+ * Structure defining a buffered reader, which reads a stream in blocks of
+ * `TEXT_BLOCK_SIZE` bytes and returns from them whitespace separated tokens
+ * (for ASCII bodies) or runs of bytes (for binary ones). A token or a run
+ * is always entirely contained in the buffer.
+ */
+struct Text_reader
+{
+    FILE *file;  /*!< Input stream. */
+    char *buf;   /*!< Buffer containing the current block. */
+    size_t size; /*!< Number of valid bytes in the buffer. */
+    size_t pos;  /*!< Position of the next unread byte in the buffer. */
+    int eof;     /*!< Nonzero when the stream has been read completely. */
+};
+
+/*!
+ * Type for a part of an ASCII .ply body parsed by a single thread.
+ */
+typedef struct Parse_chunk Parse_chunk;
+
+/*!
+ * Structure defining a part of an ASCII .ply body, made of whole lines, and
+ * the partial results of its parsing.
+ */
+struct Parse_chunk
+{
+    const char *begin;    /*!< First byte of the chunk. */
+    const char *end;      /*!< Byte following the last one of the chunk. */
+    long first_record;    /*!< Index of the first record in the chunk. */
+    long n_records;       /*!< Number of records in the chunk. */
+    float max_coord[3];   /*!< Maximum coordinates of the chunk vertices. */
+    float min_coord[3];   /*!< Minimum coordinates of the chunk vertices. */
+    int invalid;          /*!< Nonzero if the chunk contains invalid data. */
+    const Ply_header *header; /*!< Declarations of the file header. */
+    GLuint *extra;        /*!< Triangles of the chunk polygons beyond the
+                               first one. */
+    size_t n_extra;       /*!< Number of extra triangles. */
+    size_t extra_size;    /*!< Capacity of `extra`, in triangles. */
+    long n_dropped;       /*!< Faces with less than three vertices. */
+};
+
+/*!
+ * Type for a part of the normal computation run by a single thread.
+ */
+typedef struct Normal_task Normal_task;
+
+/*!
+ * Structure defining a range of faces or vertices processed by a thread
+ * while computing the vertex normals, and the arrays shared by all the
+ * threads.
+ */
+struct Normal_task
+{
+    int first;                 /*!< First face or vertex of the range. */
+    int end;                   /*!< Face or vertex following the range. */
+    GLfloat *face_normals;     /*!< Area-weighted normal of each face. */
+    const int *corner_first;   /*!< First incident corner of each vertex. */
+    const int *corners;        /*!< Incident corners, grouped by vertex. */
+    int max_corners;           /*!< Maximum number of corners of a vertex. */
+    float cos_crease;          /*!< Cosine of the crease angle. */
+    int *split_first;          /*!< First copy of each vertex, once split. */
+    GLfloat *split_vertexp;    /*!< Coordinates of the split vertices. */
+    GLfloat *split_normals;    /*!< Normals of the split vertices. */
+    GLfloat *split_color;      /*!< Color of the split vertices. */
+};
+
+/*!
+ * Type for a level of detail of the model.
+ */
+typedef struct Lod_level Lod_level;
+
+/*!
+ * Structure defining a level of detail of the model. All levels share the
+ * same vertices, and each one is a range inside the index array.
+ */
+struct Lod_level
+{
+    int first; /*!< Position of the first index of the level. */
+    int count; /*!< Number of indices of the level. */
+    float error; /*!< Maximum displacement of the vertices of the level. */
+    int first_cluster; /*!< First cluster of the level. */
+    int n_clusters;    /*!< Number of clusters of the level. */
+};
+
+/*!
+ * Type for the clusters of triangles tested for visibility.
+ */
+typedef struct Cluster_set Cluster_set;
+
+/*!
+ * Structure holding the clusters in which each level of detail is split.
+ * A cluster is a range of `CLUSTER_FACES` consecutive triangles (or less,
+ * at the end of a level), bounded by a sphere and by a cone containing the
+ * normals of its triangles. Culling data are stored as separate arrays
+ * (one per coordinate), so that several clusters can be tested at once
+ * with SIMD instructions.
+ */
+struct Cluster_set
+{
+    int n;              /*!< Number of clusters. */
+    float *center[3];   /*!< Coordinates of the bounding sphere centers. */
+    float *radius;      /*!< Radii of the bounding spheres. */
+    float *axis[3];     /*!< Components of the normal cone axes. */
+    float *cutoff;      /*!< Sine of the normal cone half-angles (1 when
+                             the cluster is never back-facing). */
+    int *first;         /*!< Position of the first index of each cluster. */
+    int *count;         /*!< Number of indices of each cluster. */
+    char *visible;      /*!< Visibility of each cluster, in the last test. */
+    GLsizei *draw_count;       /*!< Index counts of the ranges to draw. */
+    const GLvoid **draw_start; /*!< Index pointers of the ranges to draw. */
+};
+
+/*!
+ * Type for a vertex in the packed vertex format.
+ */
+typedef struct Packed_vertex Packed_vertex;
+
+/*!
+ * Structure defining a vertex in the packed, interleaved vertex format. It
+ * takes 20 bytes, against the 36 bytes of the three separate float arrays.
+ */
+struct Packed_vertex
+{
+    GLfloat position[3]; /*!< Vertex coordinates. */
+    GLbyte normal[4];    /*!< Unit normal as three normalized signed bytes,
+                              followed by padding. */
+    GLubyte color[4];    /*!< RGBA color. */
+};
+
+/*!
+ * Type for a model ready to be drawn.
+ */
+typedef struct Mesh Mesh;
+
+/*!
+ * Structure holding the state of a processed model, i.e. the model globals
+ * it is drawn from, so that several models can be kept and drawn in turn.
+ */
+struct Mesh
+{
+    GLfloat *vertexp;        /*!< Vertex coordinates. */
+    GLfloat *normals;        /*!< Vertex normals. */
+    GLfloat *color;          /*!< Vertex colors, if any. */
+    GLuint *indices;         /*!< Vertex indices, of all the levels. */
+    int n_vertex;            /*!< Number of vertices. */
+    int n_faces;             /*!< Number of triangles. */
+    int is_colored;          /*!< Nonzero if the model has color. */
+    int chunked;             /*!< Nonzero if the model is drawn from disk. */
+    GLsizei vertex_stride;   /*!< Offset between consecutive vertices. */
+    GLenum normal_type;      /*!< Type of the normal components. */
+    GLenum color_type;       /*!< Type of the color components. */
+    GLenum element_type;     /*!< Type of the indices. */
+    Lod_level lod[MAX_LOD_LEVELS]; /*!< Levels of detail. */
+    int n_lod;               /*!< Number of levels of detail. */
+    Cluster_set clusters;    /*!< Clusters of the levels of detail. */
+    void *mapping;           /*!< Mapping of the model file, if any. */
+    size_t mapping_size;     /*!< Size of the model file mapping. */
+    void *cache_mapping;     /*!< Mapping of the model cache, if any. */
+    size_t cache_mapping_size; /*!< Size of the model cache mapping. */
+    void *arena;             /*!< Block holding the model arrays, if any. */
+    size_t arena_size;       /*!< Size of the arena. */
+    GLuint vertex_buffer;    /*!< Buffer object for vertex data, if used. */
+    GLuint index_buffer;     /*!< Buffer object for indices, if used. */
+    const GLvoid *vertex_ptr; /*!< Vertex array pointer. */
+    const GLvoid *normal_ptr; /*!< Normal array pointer. */
+    const GLvoid *color_ptr;  /*!< Color array pointer. */
+    const GLvoid *index_ptr;  /*!< Index array pointer. */
+    float max_coord[3];      /*!< Maximum coordinates of the vertices. */
+    float min_coord[3];      /*!< Minimum coordinates of the vertices. */
+};
+
 /*! 
  * Type for the position of a point in tridimensional space expressed in 
  * polar coordinates. 
@@ -169,6 +543,113 @@ struct Vector_3D
     float z; /*!< Z component. */
 };
 
+/*!
+ * Type for the point cloud shown while the model is loading.
+ */
+typedef struct Preview Preview;
+
+/*!
+ * Structure holding a subset of the vertices read so far, one every
+ * <code>step</code>, in the order they were read. The loader appends the
+ * points, publishing their number under the loading lock, and the main
+ * thread appends the new ones to a buffer object and draws them, so the
+ * points below the published number are never written again.
+ */
+struct Preview
+{
+    GLfloat *points;     /*!< Coordinates of the sampled vertices. */
+    int step;            /*!< Sampling step, in vertices. */
+    int count;           /*!< Number of points published by the loader. */
+    float max_coord[3];  /*!< Maximum coordinates of the points. */
+    float min_coord[3];  /*!< Minimum coordinates of the points. */
+    int uploaded;        /*!< Number of points available for drawing. */
+    GLuint buffer;       /*!< Buffer object holding the points, if used. */
+    Vector_3D center;    /*!< Center of the points bounding box. */
+    float radius;        /*!< Radius of the points bounding box. */
+};
+
+/*!
+ * Type for the header of a model cache file.
+ */
+typedef struct Cache_header Cache_header;
+
+/*!
+ * Structure defining the header of a model cache file. The cache holds the
+ * model as drawn, i.e. after optimization, simplification and packing, so
+ * it is valid only for the source file it was built from (identified by its
+ * name, size and modification time), for the same settings and for hosts
+ * with the same byte order and type sizes.
+ *
+ * The header is followed by the packed vertices, the indices (for all the
+ * levels of detail), the floating point and the integer data of the
+ * clusters, each section starting at a multiple of `CACHE_ALIGN` bytes.
+ */
+struct Cache_header
+{
+    char magic[8];             /*!< File signature. */
+    int version;               /*!< Format version, i.e. `CACHE_VERSION`. */
+    int byte_order;            /*!< Constant used to check the byte order. */
+    int settings;              /*!< Processing settings used for the model. */
+    char source[STR_LEN + 1];  /*!< Name of the source file. */
+    long long source_size;     /*!< Size of the source file. */
+    long long source_mtime;    /*!< Modification time of the source file,
+                                    in ns. */
+    int n_vertex;              /*!< Number of vertices. */
+    int n_faces;               /*!< Number of faces. */
+    int n_indices;             /*!< Number of indices, for all the levels. */
+    int n_lod;                 /*!< Number of levels of detail. */
+    int n_clusters;            /*!< Number of clusters. */
+    int is_colored;            /*!< Nonzero if the model has color. */
+    GLenum element_type;       /*!< Type of the indices. */
+    float max_coord[3];        /*!< Maximum coordinates of the vertices. */
+    float min_coord[3];        /*!< Minimum coordinates of the vertices. */
+    Vector_3D center;          /*!< Center of the bounding box. */
+    float bb_radius;           /*!< Radius of the bounding box. */
+    Lod_level lod[MAX_LOD_LEVELS]; /*!< Levels of detail. */
+};
+
+/*!
+ * Type for the header of a compressed model container.
+ */
+typedef struct Container_header Container_header;
+
+/*!
+ * Structure defining the header of a compressed model container. Unlike
+ * the cache, the container is a model file on its own, holding the model
+ * after optimization and simplification.
+ *
+ * The header is followed by the vertex blocks, each one holding
+ * `CONTAINER_VERTICES` vertices, then by the index blocks, each one holding
+ * `CONTAINER_INDICES` indices (the last blocks may hold less). Each block
+ * starts with its uncompressed and its stored size (two ints), and it is
+ * stored uncompressed when compression does not reduce its size.
+ *
+ * In a vertex block, coordinates are quantized to 16 bits inside the
+ * bounding box, and each component is stored as the difference from the
+ * previous vertex of the block, with the bytes of the same significance
+ * contiguous: first the low and the high bytes of the x, y and z
+ * differences, then those of the normal components and of the color
+ * components (only for colored models). In an index block, each index is
+ * stored as the difference from the previous index of the block, zigzag
+ * encoded as an unsigned integer (so that small negative differences are
+ * small numbers) and written in 7 bit groups, from the least significant,
+ * with the highest bit set on all groups but the last one.
+ */
+struct Container_header
+{
+    char magic[8];             /*!< File signature. */
+    int version;               /*!< Format version, `CONTAINER_VERSION`. */
+    int byte_order;            /*!< Constant used to check the byte order. */
+    int n_vertex;              /*!< Number of vertices. */
+    int n_faces;               /*!< Number of faces. */
+    int n_indices;             /*!< Number of indices, for all the levels. */
+    int n_lod;                 /*!< Number of levels of detail. */
+    int is_colored;            /*!< Nonzero if the model has color. */
+    float max_coord[3];        /*!< Maximum coordinates of the vertices. */
+    float min_coord[3];        /*!< Minimum coordinates of the vertices. */
+    Lod_level lod[MAX_LOD_LEVELS]; /*!< Levels of detail. */
+};
+
 /*!
  * \brief Manage window resize.
  * @param w Width.
@@ -177,28 +658,48 @@ struct Vector_3D
 void resize(int w, int h);
 
 /*!
- * \brief Update the rotation angle of the model.
- * @param value Unused parameter.
+ * \brief Advance the rotation angle of the model.
+ * @param steps Elapsed time, in `TIME_GAP` units.
  */
-void updateAngle(int value);
+void step_rotation(float steps);
 
 /*!
  * \brief Adjust the rotation speed while a related key is pressed.
- * @param sign Sign of rotation variation.
+ * @param dir Direction of the speed variation.
+ * @param steps Elapsed time, in `TIME_GAP` units.
+ * @return Nonzero if the speed can still vary in the given direction.
  */
-void adjust_rotation_speed(int dir);
+int adjust_rotation_speed(int dir, float steps);
 
 /*!
  * \brief Move camera while a related key is pressed.
  * @param dir Direction for movement.
+ * @param steps Elapsed time, in `TIME_GAP` units.
+ * @return Nonzero if the camera can still move in the given direction.
+ */
+int move_camera(int dir, float steps);
+
+/*!
+ * \brief Start the animation scheduler, if it is not running.
+ */
+void start_animation(void);
+
+/*!
+ * \brief Advance all the continuous changes of the scene.
  */
-void move_camera(int dir);
+void animate(void);
 
 /*!
  * \brief Manage viewport content drawing.
  */
 void display(void);
 
+/*!
+ * \brief Draw the model in the current framebuffer.
+ * @return Number of triangles drawn.
+ */
+int draw_scene(void);
+
 /*!
  * \brief Handle ASCII keypresses.
  * @param key Pressed key value.
@@ -280,11 +781,459 @@ void createGLUTMenu(void);
  */
 int parse_file(char *filename, char *path);
 
+/*!
+ * \brief Read the header of a .ply file.
+ * @param f Input file, positioned at its beginning.
+ * @param h Declarations found in the header.
+ * @return Zero if the header is valid, nonzero otherwise.
+ * @note On success, the file is positioned inside the end_header line.
+ */
+int read_ply_header(FILE *f, Ply_header *h);
+
+/*!
+ * \brief Get the .ply scalar type matching a type name.
+ * @param name Type name, as found in a `property` line of the header.
+ * @return The matching type, or zero if the name is not a valid type.
+ */
+Ply_type ply_type_from_name(const char *name);
+
+/*!
+ * \brief Get the size in bytes of a .ply scalar type.
+ * @param type Scalar type.
+ * @return Size of a value of the given type in a binary body.
+ */
+int ply_type_size(Ply_type type);
+
+/*!
+ * \brief Check the byte order of the host.
+ * @return Nonzero if the host is little endian.
+ */
+int host_is_little_endian(void);
+
+/*!
+ * \brief Read a value from a binary .ply body.
+ * @param p Address of the value.
+ * @param type Type of the value.
+ * @param swap Nonzero if the byte order of the value must be swapped.
+ * @return The value, converted to double.
+ */
+double ply_get_value(const unsigned char *p, Ply_type type, int swap);
+
+/*!
+ * \brief Convert a decimal floating point number into a float.
+ * @param s Text of the number, not necessarily null terminated.
+ * @param len Length of the text.
+ * @param out Converted value.
+ * @return Zero if the text is a valid number, nonzero otherwise.
+ * @note The conversion does not depend on the current locale.
+ */
+int text_to_float(const char *s, size_t len, float *out);
+
+/*!
+ * \brief Convert a decimal unsigned integer number.
+ * @param s Text of the number, not necessarily null terminated.
+ * @param len Length of the text.
+ * @param out Converted value.
+ * @return Zero if the text is a valid number, nonzero otherwise.
+ */
+int text_to_uint(const char *s, size_t len, unsigned int *out);
+
+/*!
+ * \brief Read a float from a text reader.
+ * @param r Reader.
+ * @param out Value read.
+ * @return Zero if a valid number was read, nonzero otherwise.
+ */
+int read_float(Text_reader *r, float *out);
+
+/*!
+ * \brief Read an unsigned integer from a text reader.
+ * @param r Reader.
+ * @param out Value read.
+ * @return Zero if a valid number was read, nonzero otherwise.
+ */
+int read_uint(Text_reader *r, unsigned int *out);
+
+/*!
+ * \brief Get the next bytes from a reader.
+ * @param r Reader.
+ * @param n Number of bytes, at most `TEXT_BLOCK_SIZE`.
+ * @return Pointer to the bytes inside the reader buffer, valid until the
+ * next read, or NULL if the stream ends before.
+ */
+const unsigned char *read_bytes(Text_reader *r, size_t n);
+
+/*!
+ * \brief Split a polygonal face into triangles.
+ * @param polygon Vertex indices of the face, in order.
+ * @param n Number of vertices of the face.
+ * @param out Vertex indices of the triangles (`3 * (n - 2)` items).
+ * @return Number of triangles, zero for faces with less than three
+ * vertices.
+ */
+int triangulate_polygon(const GLuint *polygon, int n, GLuint *out);
+
+/*!
+ * \brief Read a record of a .ply element from a reader.
+ * @param r Reader, positioned at the start of the record.
+ * @param format Encoding of the body.
+ * @param e Declaration of the element.
+ * @param values Values of the properties stored in a model component,
+ * indexed by their slot (nine items).
+ * @param list Vertex indices, for a face record.
+ * @param max_list Capacity of `list`; further indices are skipped.
+ * @return Number of indices in the vertex list of the record (zero if the
+ * element has no such list), or -1 if the record is invalid or truncated.
+ */
+int read_ply_record(Text_reader *r, Ply_format format, const Ply_element *e,
+        float *values, GLuint *list, int max_list);
+
+/*!
+ * \brief Parse the ASCII body of a .ply file into the model arrays, using
+ * all the available processors.
+ * @param header Declarations of the file header.
+ * @return Zero if the body was read successfully, a negative value if it
+ * contains invalid data, a positive value if it cannot be parsed in
+ * parallel.
+ * @note The input file must be positioned inside the end_header line.
+ */
+int parse_ascii_body_parallel(const Ply_header *header);
+
+/*!
+ * \brief Read the binary body of a .ply file into the model arrays.
+ * @param header Declarations of the file header.
+ * @return Zero if the body was read successfully, nonzero otherwise.
+ * @note The input file must be positioned at the first byte of the body.
+ */
+int parse_binary_body(const Ply_header *header);
+
+/*!
+ * \brief Map the binary body of a .ply file in memory, using it in place of
+ * the model arrays when its layout allows it.
+ * @param header Declarations of the file header.
+ * @return Zero if the body was mapped, nonzero if it cannot be used directly.
+ * @note The input file must be positioned at the first byte of the body.
+ */
+int map_binary_body(const Ply_header *header);
+
+/*!
+ * \brief Compute the average cache miss ratio of the model indices.
+ * @param cache_size Size of the simulated FIFO vertex cache.
+ * @return Number of cache misses per triangle.
+ */
+float compute_acmr(int cache_size);
+
+/*!
+ * \brief Set the crease angle used when computing the normals of models
+ * without them.
+ * @param degrees Maximum angle between faces sharing a smooth vertex, or 0
+ * to smooth every vertex.
+ */
+void set_crease_angle(float degrees);
+
+/*!
+ * \brief Enable or disable writing the cache file of the parsed models.
+ * @param enabled Nonzero to write cache files, zero to only read them.
+ */
+void set_cache_writing(int enabled);
+
+/*!
+ * \brief Compute area-weighted vertex normals from the faces, splitting
+ * the vertices on creases when a crease angle is set.
+ */
+void compute_normals(void);
+
+/*!
+ * \brief Reorder triangles and vertices of the model for a better usage of
+ * the post-transform vertex cache and of the vertex fetch.
+ */
+void optimize_model(void);
+
+/*!
+ * \brief Build the simplified levels of detail of the model.
+ */
+void build_lod(void);
+
+/*!
+ * \brief Split each level of detail in clusters for visibility culling.
+ */
+void build_clusters(void);
+
+/*!
+ * \brief Test the clusters of a level of detail against the view frustum
+ * and the eye position.
+ * @param m Model.
+ * @param level Level of detail.
+ * @param planes Frustum planes in model coordinates, normalized, with
+ * inner side positive.
+ * @param eye Eye position in model coordinates, or NULL to skip the
+ * back-facing test.
+ * @return Number of index ranges to be drawn, stored in the `draw_count`
+ * and `draw_start` arrays of the clusters.
+ */
+int cull_clusters(const Mesh *m, int level, float planes[6][4],
+        const float *eye);
+
+/*!
+ * \brief Choose the level of detail to be drawn.
+ * @param m Model.
+ * @return Index of the chosen level.
+ */
+int choose_lod(const Mesh *m);
+
 /*!
  * \brief Do some stuff needed for model initialization.
  */
 void init_model(void);
 
+/*!
+ * \brief Compute center and radius of the bounding box of a model, which
+ * is drawn with its center in the origin.
+ * @param m Model.
+ */
+void frame_model(const Mesh *m);
+
+/*!
+ * \brief Place the camera out of the bounding box of the model framed
+ * last by frame_model(const Mesh*).
+ */
+void init_camera(void);
+
+/*!
+ * \brief Move the current model into a mesh, leaving the model globals
+ * empty for the next one.
+ * @param m Mesh receiving the model.
+ */
+void store_mesh(Mesh *m);
+
+/*!
+ * \brief Release the current model, whatever its source, and reset the
+ * model globals for the next one.
+ * @note It needs a current OpenGL context if the model was uploaded.
+ */
+void release_model(void);
+
+/*!
+ * \brief Release a mesh stored with store_mesh(Mesh*).
+ * @param m Mesh, left empty.
+ * @note The current model is discarded, so it must be stored first.
+ */
+void release_mesh(Mesh *m);
+
+/*!
+ * \brief Make a mesh the current model, to be drawn or uploaded.
+ * @param m Mesh.
+ * @note The camera and the bounding box center and radius are left
+ * untouched.
+ */
+void select_mesh(const Mesh *m);
+
+/*!
+ * \brief Get a vertex of the current model, whatever its format.
+ * @param i Index of the vertex.
+ * @param position Coordinates of the vertex.
+ * @param normal Normal of the vertex.
+ * @param rgb Color of the vertex in [0, 1], if the model has color.
+ */
+void get_vertex(int i, float position[3], float normal[3], float rgb[3]);
+
+/*!
+ * \brief Get an index of the current model, whatever its type.
+ * @param i Position of the index in the index array.
+ * @return Index value.
+ */
+GLuint get_index(int i);
+
+/*!
+ * \brief Store a vertex in the packed vertex format.
+ * @param p Packed vertex.
+ * @param position Coordinates of the vertex.
+ * @param normal Normal of the vertex, not necessarily unit.
+ * @param color Color of the vertex in [0, 1], or NULL for white.
+ */
+void pack_vertex(Packed_vertex *p, const float position[3],
+        const float normal[3], const float color[3]);
+
+/*!
+ * \brief Convert the model into the packed vertex format.
+ * @note The original model arrays are released.
+ */
+void pack_model(void);
+
+/*!
+ * \brief Set the OpenGL state for model drawing.
+ * @note It needs a current OpenGL context.
+ */
+void init_gl(void);
+
+/*!
+ * \brief Check if buffer objects are supported.
+ * @return Nonzero if buffer objects can be used.
+ * @note It needs a current OpenGL context.
+ */
+int buffer_objects_supported(void);
+
+/*!
+ * \brief Upload the current model into buffer objects, if supported.
+ * @note It needs a current OpenGL context.
+ */
+void upload_model(void);
+
+/*!
+ * \brief Make the model, or the scene, loaded last the one drawn by
+ * display(void), uploading it into buffer objects if supported.
+ * @param keep_camera Nonzero to leave the camera where it is, zero to
+ * place it out of the model.
+ * @note It needs a current OpenGL context. The model shown before, if
+ * any, is released.
+ */
+void publish_model(int keep_camera);
+
+/*!
+ * \brief Get the model drawn by display(void).
+ * @return Model shown, holding its number of vertices and faces.
+ */
+const Mesh *shown_mesh(void);
+
+/*!
+ * \brief Set the arrays of a model as the source of the next draws.
+ * @param m Model.
+ */
+void bind_model(const Mesh *m);
+
+/*!
+ * \brief Draw a model, at the given level of detail, skipping the parts
+ * out of view.
+ * @param m Model.
+ * @param l Level of detail.
+ * @return Number of triangles drawn.
+ * @note The arrays must be bound by bind_model(const Mesh*).
+ */
+int draw_model(const Mesh *m, int l);
+
+/*!
+ * \brief Release the arrays bound by bind_model(const Mesh*).
+ * @param m Model.
+ */
+void unbind_model(const Mesh *m);
+
+/*!
+ * \brief Load the model from its cache file, if valid.
+ * @param filename Name of the model file.
+ * @return 0 on success, -1 if the cache is missing or not valid.
+ */
+int load_cache(const char *filename);
+
+/*!
+ * \brief Write the cache file of the current model.
+ * @param filename Name of the model file.
+ * @return 0 on success, -1 on failure.
+ */
+int save_cache(const char *filename);
+
+/*!
+ * \brief Load the model from a compressed container.
+ * @param filename Name of the container file.
+ * @return 0 on success, -1 if the file is not a valid container.
+ */
+int load_container(const char *filename);
+
+/*!
+ * \brief Write the current model into a compressed container.
+ * @param filename Name of the container file.
+ * @return 0 on success, -1 on failure.
+ * @note The model must be in packed format.
+ */
+int save_container(const char *filename);
+
+/*!
+ * \brief Check the extension of a file name.
+ * @param filename Name of the file.
+ * @param suffix Extension, including the dot.
+ * @return Nonzero if the file name ends with the extension.
+ */
+int has_suffix(const char *filename, const char *suffix);
+
+/*!
+ * \brief Load a model and write it into a compressed container.
+ * @param source Name of the model file.
+ * @param target Name of the container file.
+ * @param path Executable path (i.e. argv[0]).
+ * @return `EXIT_SUCCESS` or `EXIT_FAILURE`.
+ */
+int compress_model(char *source, const char *target, char *path);
+
+/*!
+ * \brief Load a model, from its cache or parsing and processing it.
+ * @param filename Name of the model file.
+ * @param path Executable path (i.e. argv[0]).
+ * @return 0 on success, -1 on failure.
+ */
+int open_model(char *filename, char *path);
+
+/*!
+ * \brief Load a model, asking for another file until a valid one is given,
+ * and prepare it for drawing.
+ * @param filename Name of the file to be loaded.
+ * @param path Executable name with full path, i.e. argv[0] from the caller.
+ * @param ask Nonzero to ask the user for another file when the given one is
+ * not valid, zero to fail instead.
+ * @return 0 on success, -1 on failure (only if <code>ask</code> is zero).
+ */
+int load_model(char *filename, char *path, int ask);
+
+/*!
+ * \brief Prepare a parsed model for drawing.
+ */
+void process_model(void);
+
+/*!
+ * \brief Start loading a model in background.
+ * @param filename Name of the file to be loaded.
+ * @param path Executable name with full path, i.e. argv[0] from the caller.
+ * @param ask Nonzero to ask the user for another file when the given one is
+ * not valid, zero to quit instead.
+ * @note The model is loaded synchronously when threads are not available.
+ */
+void start_loading(char *filename, char *path, int ask);
+
+/*!
+ * \brief Check if the background loading is finished and, in that case,
+ * publish the model for drawing.
+ * @param value Unused parameter.
+ */
+void check_loading(int value);
+
+/*!
+ * \brief Check if the model files changed and, in that case, start
+ * loading the model again in background.
+ * @param value Unused parameter.
+ */
+void check_reload(int value);
+
+/*!
+ * \brief Update the progress of the model loading.
+ * @param stage Description of the current loading stage.
+ * @param progress Completed fraction of the current stage, in [0, 1].
+ */
+void set_load_progress(const char *stage, float progress);
+
+/*!
+ * \brief Prepare the preview for a model, if enabled.
+ * @param n Number of vertices of the model.
+ */
+void start_preview(int n);
+
+/*!
+ * \brief Add the sampled vertices of a range to the preview, if enabled.
+ * @param vertices Coordinates of the first vertex of the range.
+ * @param stride Byte offset between consecutive vertices.
+ * @param first Index of the first vertex of the range.
+ * @param count Number of vertices in the range.
+ * @note It can be called concurrently by several threads.
+ */
+void add_preview(const void *vertices, size_t stride, long first, long count);
+
 /*!
  * \brief Get from user the desired filename to be imported.
  * @param filename String to be filled with the filename.
@@ -292,6 +1241,21 @@ void init_model(void);
  */
 void get_filename(char *filename);
 
+/*!
+ * \brief Apply a model option given on the command line, namely
+ * <code>--trace file.csv</code>, <code>--budget MB</code>,
+ * <code>--crease degrees</code>, <code>--no-packed</code>,
+ * <code>--no-optimize</code>, <code>--no-lod</code>,
+ * <code>--no-culling</code>, <code>--cull-back-faces</code>,
+ * <code>--no-cache</code> or <code>--cache</code>.
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @param i Position of the option, moved to its value if it takes one.
+ * @return 1 if the option was applied, 0 if it is not a model option, -1
+ * if it could not be applied.
+ */
+int parse_option(int argc, char *argv[], int *i);
+
 /*!
  * \brief Handles fatal errors, writing a descriptive error message and
  * closing the program.
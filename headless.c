@@ -0,0 +1,803 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file headless.c
+ * @author agent
+ * @date 2026-10-16
+ *
+ * Offscreen benchmark: the model is loaded and N frames of its automatic
+ * rotation are rendered into a framebuffer object, without any window,
+ * measuring the time spent in each phase.
+ */
+
+#include "components.h"
+#include "headless.h"
+#include "profiler.h"
+
+#if defined(__linux__)
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
+    #include <sys/stat.h>
+#endif // defined(__linux__)
+
+/*!
+ * Compute the CRC used by PNG chunks, updating the value <code>crc</code>
+ * with <code>len</code> bytes from <code>buf</code>.
+ */
+static unsigned long png_crc(unsigned long crc, const unsigned char *buf,
+        size_t len)
+{
+    static unsigned long table[256];
+    static int table_ready = 0;
+    size_t i;
+    int k;
+
+    if (!table_ready)
+    {
+        for (i = 0; i < 256; i++)
+        {
+            unsigned long c = i;
+            for (k = 0; k < 8; k++)
+                c = c & 1 ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        table_ready = 1;
+    }
+
+    crc ^= 0xffffffffUL;
+    for (i = 0; i < len; i++)
+        crc = table[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffffUL;
+}
+
+/*!
+ * Store a 32 bit value in big endian byte order, as required by PNG.
+ */
+static void put_be32(unsigned char *p, unsigned long v)
+{
+    p[0] = (v >> 24) & 0xff;
+    p[1] = (v >> 16) & 0xff;
+    p[2] = (v >> 8) & 0xff;
+    p[3] = v & 0xff;
+}
+
+/*!
+ * Write a PNG chunk, made of its length, type, data and CRC.
+ */
+static void png_chunk(FILE *f, const char *type, const unsigned char *data,
+        size_t len)
+{
+    unsigned char word[4];
+    unsigned long crc;
+
+    put_be32(word, len);
+    fwrite(word, 1, 4, f);
+    fwrite(type, 1, 4, f);
+    if (len)
+        fwrite(data, 1, len, f);
+
+    crc = png_crc(0, (const unsigned char*) type, 4);
+    crc = png_crc(crc, data, len);
+    put_be32(word, crc);
+    fwrite(word, 1, 4, f);
+}
+
+/*!
+ * The image is written as a truecolor PNG with alpha. Its pixel data are
+ * not compressed, but wrapped in stored deflate blocks, so that no external
+ * library is needed: the files are large, but they are meant for visual
+ * inspection of benchmark runs, not for distribution.
+ * Rows are flipped, since OpenGL returns them from the bottom.
+ */
+int write_png(const char *filename, const unsigned char *pixels, int w, int h)
+{
+    static const unsigned char signature[8] =
+            { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    const size_t row = (size_t) w * 4 + 1;  // filter byte and RGBA pixels
+    const size_t raw_size = row * h;        // size of the filtered image
+    const size_t n_blocks = raw_size / 65535 + 1; // stored deflate blocks
+    unsigned char ihdr[13];
+    unsigned char *raw, *zdata, *p;
+    unsigned long a = 1, b = 0;             // adler32 checksum
+    size_t i, left;
+    int y;
+    int line;
+    FILE *f;
+
+    f = fopen(filename, "wb");
+    if (f == NULL)
+    {
+        printf("Unable to open the file %s.\n", filename);
+        return -1;
+    }
+
+    line = __LINE__ + 1;
+    raw = (unsigned char*) malloc(raw_size);
+    if (raw == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    line = __LINE__ + 1;
+    zdata = (unsigned char*) malloc(raw_size + n_blocks * 5 + 6);
+    if (zdata == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    // filtered image (filter type none), top row first
+    for (y = 0; y < h; y++)
+    {
+        raw[y * row] = 0;
+        memcpy(raw + y * row + 1, pixels + (size_t) (h - 1 - y) * w * 4,
+                (size_t) w * 4);
+    }
+
+    // zlib stream made of stored blocks
+    p = zdata;
+    *p++ = 0x78;
+    *p++ = 0x01;
+    for (i = 0, left = raw_size; i < n_blocks; i++)
+    {
+        size_t len = left > 65535 ? 65535 : left;
+        *p++ = i == n_blocks - 1;
+        *p++ = len & 0xff;
+        *p++ = (len >> 8) & 0xff;
+        *p++ = ~len & 0xff;
+        *p++ = (~len >> 8) & 0xff;
+        memcpy(p, raw + raw_size - left, len);
+        p += len;
+        left -= len;
+    }
+    for (i = 0; i < raw_size; i++)
+    {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_be32(p, (b << 16) | a);
+    p += 4;
+
+    put_be32(ihdr, w);
+    put_be32(ihdr + 4, h);
+    ihdr[8] = 8;   // bit depth
+    ihdr[9] = 6;   // truecolor with alpha
+    ihdr[10] = 0;  // deflate compression
+    ihdr[11] = 0;  // adaptive filtering
+    ihdr[12] = 0;  // no interlace
+
+    fwrite(signature, 1, sizeof (signature), f);
+    png_chunk(f, "IHDR", ihdr, sizeof (ihdr));
+    png_chunk(f, "IDAT", zdata, p - zdata);
+    png_chunk(f, "IEND", NULL, 0);
+
+    free(raw);
+    free(zdata);
+
+    if (fclose(f))
+    {
+        printf("Unable to write the file %s.\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+#if defined(__linux__)
+
+/*!
+ * Comparison function for qsort, ordering doubles increasingly.
+ */
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+/*!
+ * Print the distribution of <code>n</code> timings, which are sorted in
+ * place. Percentiles are taken by rank, without interpolation.
+ */
+static void print_timings(const char *name, double *t, int n)
+{
+    qsort(t, n, sizeof (double), compare_double);
+    printf("%-10s p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f ms\n",
+            name,
+            t[(n - 1) * 50 / 100],
+            t[(n - 1) * 90 / 100],
+            t[(n - 1) * 99 / 100],
+            t[n - 1]);
+}
+
+/*!
+ * Create an OpenGL context without any window, using the surfaceless EGL
+ * platform, so that it works on machines without a display server and,
+ * through a software renderer, without a GPU.
+ */
+static int create_context(void)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display;
+    EGLDisplay display;
+    EGLConfig config;
+    EGLContext context;
+    EGLint major, minor, n_configs;
+    const EGLint attributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+
+    get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+            eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display == NULL)
+    {
+        printf("EGL platform displays are not supported.\n");
+        return -1;
+    }
+
+    display = get_platform_display(
+            EGL_PLATFORM_SURFACELESS_MESA,
+            EGL_DEFAULT_DISPLAY,
+            NULL);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        printf("Unable to initialize an EGL display.\n");
+        return -1;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)
+            || !eglChooseConfig(display, attributes, &config, 1, &n_configs)
+            || n_configs < 1)
+    {
+        printf("No EGL configuration supports OpenGL.\n");
+        return -1;
+    }
+
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+    if (context == EGL_NO_CONTEXT
+            || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                context))
+    {
+        printf("Unable to create an OpenGL context.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+ * Create a framebuffer object with color and depth attachments of the
+ * given size, and bind it as the rendering target.
+ */
+static int create_framebuffer(int w, int h)
+{
+    GLuint framebuffer, renderbuffers[2];
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+    glFramebufferRenderbuffer(
+            GL_FRAMEBUFFER,
+            GL_COLOR_ATTACHMENT0,
+            GL_RENDERBUFFER,
+            renderbuffers[0]);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+    glFramebufferRenderbuffer(
+            GL_FRAMEBUFFER,
+            GL_DEPTH_ATTACHMENT,
+            GL_RENDERBUFFER,
+            renderbuffers[1]);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        printf("Unable to create a %dx%d framebuffer.\n", w, h);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+ * The context is surfaceless, so the framebuffer object takes the place of
+ * the window.
+ */
+int create_offscreen(int w, int h)
+{
+    return create_context() || create_framebuffer(w, h) ? -1 : 0;
+}
+
+/*!
+ * The benchmark is invoked as
+ * <code>viewer --benchmark [--frames N] [--size WxH] [--png prefix]
+ * [options] file.ply</code>, with the model options of
+ * parse_option(int, char**, int*).
+ * The model is loaded as in the interactive viewer, from its cache when
+ * valid (without asking for another file if the given one is not valid),
+ * then N frames of the automatic rotation are rendered offscreen. For each
+ * frame, the time spent by the CPU to submit the drawing commands, the time
+ * measured on the GPU with timer queries (when available) and the total
+ * time until the frame is complete are recorded, and their percentiles are
+ * printed along with the load time and the throughput in triangles per
+ * second.
+ * With <code>--png</code> each frame is saved as
+ * <code>prefix0000.png</code>, <code>prefix0001.png</code>, ...;
+ * the time spent reading and saving the images is not measured.
+ * With <code>--trace</code> the per-frame timings of the profiler are
+ * written in a CSV file.
+ */
+int run_benchmark(int argc, char *argv[])
+{
+    int frames = BENCH_FRAMES;  // number of frames to render
+    int w = BENCH_WIDTH;        // framebuffer width
+    int h = BENCH_HEIGHT;       // framebuffer height
+    char *png_prefix = NULL;    // prefix for the saved frames
+    char *filename = NULL;      // model file
+    double *cpu_time, *gpu_time, *frame_time;
+    GLuint *queries = NULL;
+    GLint timer_bits = 0;       // zero when timer queries are not available
+    unsigned char *pixels = NULL;
+    double start, phase_start, load_time, total_time = 0;
+    double triangles = 0;       // triangles drawn in all frames
+    int applied;                // result of parse_option
+    int i;
+    int line;
+
+    // parse arguments following --benchmark
+    for (i = 2; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+            frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%dx%d", &w, &h) != 2)
+                w = h = 0;
+        }
+        else if (!strcmp(argv[i], "--png") && i + 1 < argc)
+            png_prefix = argv[++i];
+        else if ((applied = parse_option(argc, argv, &i)) != 0)
+        {
+            if (applied < 0)
+                return EXIT_FAILURE;
+        }
+        else if (argv[i][0] != '-' && filename == NULL)
+            filename = argv[i];
+        else
+        {
+            printf("Unknown argument %s.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (filename == NULL || frames < 1 || w < 1 || h < 1)
+    {
+        printf("Usage: %s --benchmark [--frames N] [--size WxH] "
+                "[--png prefix] [options] file.ply\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (create_offscreen(w, h))
+        return EXIT_FAILURE;
+
+    // load the model, including upload to the GPU
+    start = profile_now();
+    if (open_model(filename, argv[0]))
+        return EXIT_FAILURE;
+
+    phase_start = profile_now();
+    init_gl();
+    publish_model(0);
+    glFinish();
+    profile_load_phase("upload", profile_now() - phase_start);
+    load_time = profile_now() - start;
+    profile_report_load();
+
+    line = __LINE__ + 1;
+    cpu_time = (double*) malloc(3 * frames * sizeof (double));
+    if (cpu_time == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    gpu_time = cpu_time + frames;
+    frame_time = gpu_time + frames;
+
+    glGetQueryiv(GL_TIME_ELAPSED, GL_QUERY_COUNTER_BITS, &timer_bits);
+    if (timer_bits)
+    {
+        line = __LINE__ + 1;
+        queries = (GLuint*) malloc(frames * sizeof (GLuint));
+        if (queries == NULL)
+            error_handler("malloc", __func__, __FILE__, line);
+        glGenQueries(frames, queries);
+    }
+
+    if (png_prefix)
+    {
+        line = __LINE__ + 1;
+        pixels = (unsigned char*) malloc((size_t) w * h * 4);
+        if (pixels == NULL)
+            error_handler("malloc", __func__, __FILE__, line);
+    }
+
+    resize(w, h);
+
+    // warm up, so that first use costs are not measured
+    draw_scene();
+    glFinish();
+
+    for (i = 0; i < frames; i++)
+    {
+        double frame_start = profile_now();
+        int frame_triangles;
+
+        profile_begin_frame();
+        if (timer_bits)
+            glBeginQuery(GL_TIME_ELAPSED, queries[i]);
+        frame_triangles = draw_scene();
+        if (timer_bits)
+            glEndQuery(GL_TIME_ELAPSED);
+        cpu_time[i] = profile_now() - frame_start;
+
+        glFinish();
+        frame_time[i] = profile_now() - frame_start;
+        total_time += frame_time[i];
+        triangles += frame_triangles;
+
+        // the wait for completion takes the place of the swap
+        profile_mark(PROF_SWAP);
+        profile_end_frame(frame_triangles);
+
+        if (png_prefix)
+        {
+            char name[STR_LEN + 1];
+            glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            snprintf(name, STR_LEN, "%s%04d.png", png_prefix, i);
+            if (write_png(name, pixels, w, h))
+                return EXIT_FAILURE;
+        }
+
+        step_rotation(1);
+    }
+
+    // collect timer queries at the end, to avoid stalls between frames
+    for (i = 0; timer_bits && i < frames; i++)
+    {
+        GLuint64 ns;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &ns);
+        gpu_time[i] = ns * 1e-6;
+    }
+
+    printf("renderer   %s\n", (const char*) glGetString(GL_RENDERER));
+    printf("model      %s\n", filename);
+    printf("frames     %d at %dx%d, %.0f triangles per frame\n",
+            frames, w, h, triangles / frames);
+    printf("load       %8.3f ms\n", load_time);
+    print_timings("cpu", cpu_time, frames);
+    if (timer_bits)
+        print_timings("gpu", gpu_time, frames);
+    else
+        printf("gpu        timer queries not available\n");
+    print_timings("frame", frame_time, frames);
+    printf("fps        %8.3f\n", frames * 1e3 / total_time);
+    printf("tris/s     %8.3e\n", triangles * 1e3 / total_time);
+
+    profile_close_trace();
+
+    if (timer_bits)
+    {
+        glDeleteQueries(frames, queries);
+        free(queries);
+    }
+    free(cpu_time);
+    free(pixels);
+
+    return glGetError() == GL_NO_ERROR ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*!
+ * Name the thumbnail of a model after its path, without extension, inside
+ * the output directory, so that models with the same name in different
+ * directories do not overwrite each other's thumbnail: the thumbnail of
+ * <code>a/b.ply</code> is <code>dir/a/b.png</code>, the one of
+ * <code>/x/c.ply</code> is <code>dir/x/c.png</code>. Components
+ * <code>.</code> are dropped and components <code>..</code> are written
+ * as <code>_up_</code>, so that the thumbnail stays in the directory.
+ * The directories leading to the thumbnail are created.
+ */
+static int thumbnail_name(char *name, const char *dir, const char *filename)
+{
+    const char *slash = strrchr(filename, '/');
+    const char *base = slash ? slash + 1 : filename;
+    const char *end = strrchr(base, '.');
+    const char *p, *q;
+    size_t length;
+    char *c;
+
+    if (end == NULL || end == base)
+        end = base + strlen(base);
+
+    length = snprintf(name, STR_LEN + 1, "%s", dir);
+    for (p = filename; p < end && length <= STR_LEN; p = q + 1)
+    {
+        q = strchr(p, '/');
+        if (q == NULL || q > end)
+            q = end;
+
+        if (q - p == 2 && !strncmp(p, "..", 2))
+            length += snprintf(name + length, STR_LEN + 1 - length, "/_up_");
+        else if (q - p > 1 || (q - p == 1 && *p != '.'))
+            length += snprintf(name + length, STR_LEN + 1 - length, "/%.*s",
+                    (int) (q - p), p);
+    }
+    if (length <= STR_LEN)
+        length += snprintf(name + length, STR_LEN + 1 - length, ".png");
+    if (length > STR_LEN)
+        return -1;
+
+    for (c = name + 1; (c = strchr(c, '/')) != NULL; ++c)
+    {
+        *c = '\0';
+        mkdir(name, 0777);
+        *c = '/';
+    }
+
+    return 0;
+}
+
+/*!
+ * Write a file name as a CSV field, quoted, so that commas and quotes in
+ * the name do not break the columns.
+ */
+static void csv_name(FILE *f, const char *filename)
+{
+    fputc('"', f);
+    for (; *filename; ++filename)
+    {
+        if (*filename == '"')
+            fputc('"', f);
+        fputc(*filename, f);
+    }
+    fputc('"', f);
+}
+
+/*!
+ * Load a model, publish it (releasing the previous one) and render its
+ * thumbnail from the initial point of view, reporting the outcome on a
+ * single line and in the statistics file, if any.
+ */
+static int batch_model(char *filename, char *path, const char *out_dir,
+        unsigned char *pixels, int w, int h, FILE *stats)
+{
+    char name[STR_LEN + 1];
+    double start, load_time, render_time;
+    const Mesh *m;
+
+    start = profile_now();
+    if (open_model(filename, path))
+    {
+        printf("batch: %s: unable to load the model.\n", filename);
+        if (stats)
+        {
+            csv_name(stats, filename);
+            fprintf(stats, ",,,,,failed\n");
+        }
+        return -1;
+    }
+    publish_model(0);
+    glFinish();
+    load_time = profile_now() - start;
+    profile_report_load();
+    m = shown_mesh();
+
+    start = profile_now();
+    draw_scene();
+    glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    render_time = profile_now() - start;
+
+    if (thumbnail_name(name, out_dir, filename) || write_png(name, pixels,
+                w, h))
+    {
+        printf("batch: %s: unable to write the thumbnail.\n", filename);
+        if (stats)
+        {
+            csv_name(stats, filename);
+            fprintf(stats, ",%d,%d,%.3f,%.3f,failed\n",
+                    m->n_vertex, m->n_faces, load_time, render_time);
+        }
+        return -1;
+    }
+
+    printf("batch: %s: %d vertices, %d faces, load %.1f ms, "
+            "render %.1f ms, %s\n", filename, m->n_vertex, m->n_faces,
+            load_time, render_time, name);
+    if (stats)
+    {
+        csv_name(stats, filename);
+        fprintf(stats, ",%d,%d,%.3f,%.3f,ok\n",
+                m->n_vertex, m->n_faces, load_time, render_time);
+    }
+
+    return 0;
+}
+
+/*!
+ * The batch mode is invoked as
+ * <code>viewer --batch [--size WxH] [--out dir] [--list file]
+ * [--stats file.csv] [options] [file...]</code>, with the model options
+ * of parse_option(int, char**, int*).
+ * The models given as arguments, then the ones listed one per line in the
+ * list file (<code>-</code> for the standard input, blank lines and lines
+ * starting with <code>#</code> are skipped), are processed in turn by a
+ * single offscreen context, so that process and context creation are paid
+ * once for the whole list. Each model is loaded as in the interactive
+ * viewer, its number of vertices and faces and the time spent loading and
+ * drawing it are printed, and a thumbnail framing it as the viewer does is
+ * saved in the output directory (the current one by default, created if
+ * missing), mirroring the path of the model. The previous model is
+ * released before the next one is shown, so that memory does not grow with
+ * the list.
+ * A model which cannot be loaded is reported and skipped, and the exit
+ * status is then a failure.
+ */
+int run_batch(int argc, char *argv[])
+{
+    int w = BATCH_THUMB_SIZE;   // thumbnail width
+    int h = BATCH_THUMB_SIZE;   // thumbnail height
+    const char *out_dir = ".";  // directory for the thumbnails
+    const char *list = NULL;    // file listing the models, if any
+    const char *stats_name = NULL; // statistics file, if any
+    FILE *stats = NULL;
+    FILE *f = NULL;
+    unsigned char *pixels;
+    char filename[STR_LEN + 1];
+    int n_models = 0, n_failed = 0;
+    int applied;
+    int i;
+    int line;
+
+    // a model library is not filled with cache files, unless asked
+    set_cache_writing(0);
+
+    // parse arguments following --batch, moving the models (processed
+    // later) to the front, over the arguments already parsed
+    for (i = 2; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--size") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%dx%d", &w, &h) != 2)
+                w = h = 0;
+        }
+        else if (!strcmp(argv[i], "--out") && i + 1 < argc)
+            out_dir = argv[++i];
+        else if (!strcmp(argv[i], "--list") && i + 1 < argc)
+            list = argv[++i];
+        else if (!strcmp(argv[i], "--stats") && i + 1 < argc)
+            stats_name = argv[++i];
+        else if ((applied = parse_option(argc, argv, &i)) != 0)
+        {
+            if (applied < 0)
+                return EXIT_FAILURE;
+        }
+        else if (argv[i][0] == '-')
+        {
+            printf("Unknown argument %s.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        else
+            argv[2 + n_models++] = argv[i];
+    }
+
+    if ((n_models == 0 && list == NULL) || w < 1 || h < 1)
+    {
+        printf("Usage: %s --batch [--size WxH] [--out dir] [--list file] "
+                "[--stats file.csv] [options] [file...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (list)
+    {
+        f = strcmp(list, "-") ? fopen(list, "r") : stdin;
+        if (f == NULL)
+        {
+            printf("Unable to open the file %s.\n", list);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (stats_name)
+    {
+        stats = fopen(stats_name, "w");
+        if (stats == NULL)
+        {
+            printf("Unable to open the file %s.\n", stats_name);
+            return EXIT_FAILURE;
+        }
+        fprintf(stats, "file,vertices,faces,load_ms,render_ms,status\n");
+    }
+
+    if (create_offscreen(w, h))
+        return EXIT_FAILURE;
+    init_gl();
+    resize(w, h);
+
+    line = __LINE__ + 1;
+    pixels = (unsigned char*) malloc((size_t) w * h * 4);
+    if (pixels == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    // models given as arguments
+    for (i = 2; i < 2 + n_models; i++)
+        n_failed += batch_model(argv[i], argv[0], out_dir, pixels, w, h,
+                stats) != 0;
+
+    // models listed in the list file
+    while (f && fgets(filename, sizeof filename, f))
+    {
+        filename[strcspn(filename, "\r\n")] = '\0';
+        if (filename[0] == '\0' || filename[0] == '#')
+            continue;
+        n_failed += batch_model(filename, argv[0], out_dir, pixels, w, h,
+                stats) != 0;
+        n_models++;
+    }
+
+    printf("batch: %d models, %d failed.\n", n_models, n_failed);
+
+    profile_close_trace();
+    if (f && f != stdin)
+        fclose(f);
+    if (stats)
+        fclose(stats);
+    free(pixels);
+
+    return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#else // __APPLE__, _WIN32
+
+/*!
+ * The offscreen benchmark relies on EGL, available only on Linux.
+ */
+int run_benchmark(int argc, char *argv[])
+{
+    UNUSED(argc);
+    printf("%s: the benchmark is not supported on this platform.\n",
+            argv[0]);
+    return EXIT_FAILURE;
+}
+
+/*!
+ * Offscreen contexts rely on EGL, available only on Linux.
+ */
+int create_offscreen(int w, int h)
+{
+    UNUSED(w);
+    UNUSED(h);
+    printf("Offscreen rendering is not supported on this platform.\n");
+    return -1;
+}
+
+/*!
+ * The batch mode relies on EGL, available only on Linux.
+ */
+int run_batch(int argc, char *argv[])
+{
+    UNUSED(argc);
+    printf("%s: the batch mode is not supported on this platform.\n",
+            argv[0]);
+    return EXIT_FAILURE;
+}
+
+#endif // defined(__linux__)
@@ -0,0 +1,70 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file headless.h
+ * @author agent
+ * @date 2026-10-16
+ */
+
+/*! Default number of frames rendered by the benchmark. */
+#define BENCH_FRAMES 300
+
+/*! Default width of the offscreen framebuffer. */
+#define BENCH_WIDTH 1920
+
+/*! Default height of the offscreen framebuffer. */
+#define BENCH_HEIGHT 1080
+
+/*! Default width and height of the thumbnails rendered in batch mode. */
+#define BATCH_THUMB_SIZE 256
+
+/*!
+ * \brief Create an OpenGL context without any window, rendering into a
+ * framebuffer object, which is bound.
+ * @param w Width of the framebuffer.
+ * @param h Height of the framebuffer.
+ * @return 0 on success, -1 on failure.
+ */
+int create_offscreen(int w, int h);
+
+/*!
+ * \brief Run the offscreen render benchmark.
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments, starting with the program name.
+ * @return Exit status for the program.
+ */
+int run_benchmark(int argc, char *argv[]);
+
+/*!
+ * \brief Load a list of models in turn, printing their statistics and
+ * rendering a thumbnail of each one offscreen.
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments, starting with the program name.
+ * @return Exit status for the program.
+ */
+int run_batch(int argc, char *argv[]);
+
+/*!
+ * \brief Write an RGBA image, stored bottom-up, in a PNG file.
+ * @param filename Name of the output file.
+ * @param pixels Pixel data, as read by glReadPixels.
+ * @param w Width of the image.
+ * @param h Height of the image.
+ * @return 0 on success, -1 on failure.
+ */
+int write_png(const char *filename, const unsigned char *pixels, int w, int h);
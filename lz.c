@@ -0,0 +1,208 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file lz.c
+ * @author agent
+ * @date 2026-10-16
+ *
+ * Byte oriented LZ77 compression, in the style of LZ4: fast greedy
+ * matching through a hash table, and a decoder which only copies bytes.
+ *
+ * Compressed data are a sequence of records, each one made of a token
+ * byte, whose high nibble is the number of literals and whose low nibble
+ * is the match length minus `LZ_MIN_MATCH`, the literals, the match
+ * offset (two bytes, little endian) and the match length. A nibble equal
+ * to 15 is followed by extra length bytes, added to it until a byte
+ * different from 255. The last record has only literals.
+ */
+
+#include <string.h>
+#include "lz.h"
+
+/*!
+ * Read four bytes as an integer, for comparisons and hashing.
+ */
+static unsigned int read32(const unsigned char *p)
+{
+    unsigned int v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+/*!
+ * Hash of four bytes, used to index the table of the last positions.
+ */
+static unsigned int hash32(unsigned int v)
+{
+    return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+/*!
+ * Write the extra bytes of a length exceeding its nibble.
+ */
+static unsigned char *write_length(unsigned char *out, size_t length)
+{
+    for (length -= 15; length >= 255; length -= 255)
+        *out++ = 255;
+    *out++ = (unsigned char) length;
+    return out;
+}
+
+/*!
+ * Write a record with the given literals and match.
+ */
+static unsigned char *write_record(unsigned char *out,
+        const unsigned char *literals, size_t n_literals,
+        size_t offset, size_t match)
+{
+    unsigned char *token = out++;
+    size_t m = match ? match - LZ_MIN_MATCH : 0;
+
+    *token = (unsigned char) ((n_literals < 15 ? n_literals : 15) << 4
+                              | (m < 15 ? m : 15));
+    if (n_literals >= 15)
+        out = write_length(out, n_literals);
+    memcpy(out, literals, n_literals);
+    out += n_literals;
+
+    if (match)
+    {
+        *out++ = offset & 0xff;
+        *out++ = offset >> 8;
+        if (m >= 15)
+            out = write_length(out, m);
+    }
+
+    return out;
+}
+
+/*!
+ * Each record adds at most one byte every 255 literals, plus a few bytes.
+ */
+size_t lz_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+/*!
+ * At each position, the last previous position with the same hash of the
+ * next four bytes is checked; if the bytes match, the match is extended as
+ * far as possible and emitted, otherwise the byte becomes a literal.
+ */
+size_t lz_compress(const unsigned char *src, size_t size, unsigned char *dst)
+{
+    long table[1 << LZ_HASH_BITS];
+    unsigned char *out = dst;
+    size_t i = 0, anchor = 0;
+
+    memset(table, 0xff, sizeof table); // all positions to -1
+
+    while (size >= LZ_MIN_MATCH && i <= size - LZ_MIN_MATCH)
+    {
+        unsigned int v = read32(src + i);
+        unsigned int h = hash32(v);
+        long candidate = table[h];
+        table[h] = (long) i;
+
+        if (candidate >= 0
+                && i - candidate <= LZ_MAX_OFFSET
+                && read32(src + candidate) == v)
+        {
+            size_t match = LZ_MIN_MATCH;
+            while (i + match < size && src[candidate + match] == src[i + match])
+                match++;
+            out = write_record(out, src + anchor, i - anchor,
+                    i - candidate, match);
+            i += match;
+            anchor = i;
+        }
+        else
+            i++;
+    }
+
+    // final literals
+    out = write_record(out, src + anchor, size - anchor, 0, 0);
+    return out - dst;
+}
+
+/*!
+ * Read the extra bytes of a length, returning -1 at the end of the input.
+ */
+static long read_length(const unsigned char **in, const unsigned char *end,
+        long length)
+{
+    unsigned char b;
+    do
+    {
+        if (*in >= end)
+            return -1;
+        b = *(*in)++;
+        length += b;
+    } while (b == 255);
+    return length;
+}
+
+/*!
+ * Every length and offset is checked against the input and output bounds,
+ * so that corrupted data cannot cause out of bounds accesses.
+ */
+long lz_decompress(const unsigned char *src, size_t size,
+        unsigned char *dst, size_t capacity)
+{
+    const unsigned char *in = src;
+    const unsigned char *end = src + size;
+    unsigned char *out = dst;
+    unsigned char *out_end = dst + capacity;
+
+    while (in < end)
+    {
+        unsigned char token = *in++;
+        long n_literals = token >> 4;
+        long match = token & 15;
+        size_t offset;
+
+        // literals
+        if (n_literals == 15 && (n_literals = read_length(&in, end, 15)) < 0)
+            return -1;
+        if (n_literals > end - in || n_literals > out_end - out)
+            return -1;
+        memcpy(out, in, n_literals);
+        in += n_literals;
+        out += n_literals;
+
+        // the last record has no match
+        if (in == end)
+            break;
+
+        // match, possibly overlapping the output being written
+        if (end - in < 2)
+            return -1;
+        offset = in[0] | in[1] << 8;
+        in += 2;
+        if (match == 15 && (match = read_length(&in, end, 15)) < 0)
+            return -1;
+        match += LZ_MIN_MATCH;
+        if (offset == 0 || offset > (size_t) (out - dst)
+                || match > out_end - out)
+            return -1;
+        for (; match > 0; --match, ++out)
+            *out = *(out - offset);
+    }
+
+    return out - dst;
+}
@@ -0,0 +1,61 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file lz.h
+ * @author agent
+ * @date 2026-10-16
+ */
+
+#include <stddef.h>
+
+/*! Minimum length of a match. */
+#define LZ_MIN_MATCH 4
+
+/*! Maximum distance of a match. */
+#define LZ_MAX_OFFSET 65535
+
+/*! Number of bits of the hash used to find matches. */
+#define LZ_HASH_BITS 14
+
+/*!
+ * \brief Maximum size of the compressed form of some data.
+ * @param size Size of the data.
+ * @return Size of the buffer needed by lz_compress().
+ */
+size_t lz_bound(size_t size);
+
+/*!
+ * \brief Compress a block of data.
+ * @param src Data to be compressed.
+ * @param size Size of the data.
+ * @param dst Output buffer, of at least lz_bound(size) bytes.
+ * @return Size of the compressed data.
+ */
+size_t lz_compress(const unsigned char *src, size_t size, unsigned char *dst);
+
+/*!
+ * \brief Decompress a block of data.
+ * @param src Compressed data.
+ * @param size Size of the compressed data.
+ * @param dst Output buffer.
+ * @param capacity Size of the output buffer.
+ * @return Size of the decompressed data, or -1 if the data are corrupted or
+ * do not fit in the output buffer.
+ */
+long lz_decompress(const unsigned char *src, size_t size,
+        unsigned char *dst, size_t capacity);
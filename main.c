@@ -16,40 +16,123 @@
  */
 
 #include "components.h"
+#include "headless.h"
+#include "outofcore.h"
 
-// NOTE: extern variables definition; for declaration see components.hpp
-// light settings
-const GLfloat light_ambient[]  = { 0.0f, 0.0f, 0.0f, 1.0f };
-const GLfloat light_diffuse[]  = { 1.0f, 1.0f, 1.0f, 1.0f };
-const GLfloat light_specular[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-const GLfloat light_position[] = { -10.0f, 10.0f, 10.0f, 1.0f };
-
-// material settings
-const GLfloat mat_ambient[]    = { 0.7f, 0.7f, 0.7f, 1.0f };
-const GLfloat mat_diffuse[]    = { 0.8f, 0.8f, 0.8f, 1.0f };
-const GLfloat mat_specular[]   = { 1.0f, 1.0f, 1.0f, 1.0f };
-const GLfloat high_shininess[] = { 100.0f };
+/*!
+ * Print the command line usage of the viewer.
+ */
+static void usage(const char *program)
+{
+    printf("Usage: %s [options] [file]\n"
+           "       %s --batch [--size WxH] [--out dir] [--list file] "
+           "[--stats file.csv] [options] [file...]\n"
+           "       %s --benchmark [--frames N] [--size WxH] "
+           "[--png prefix] [options] file\n"
+           "       %s --compress model.ply model%s\n"
+           "       %s --chunk model.ply model%s\n"
+           "Options:\n"
+           "  --size WxH         window size (default %dx%d)\n"
+           "  --trace file.csv   write the per-frame timings\n"
+           "  --budget MB        memory budget for chunked models\n"
+           "  --crease degrees   sharp edges for models without normals\n"
+           "  --no-packed        keep the vertices in float format\n"
+           "  --no-optimize      do not reorder for the vertex cache\n"
+           "  --no-lod           do not build levels of detail\n"
+           "  --no-culling       do not cull clusters out of view\n"
+           "  --cull-back-faces  hide the faces turned away from the camera\n"
+           "  --no-cache         do not write cache files\n"
+           "  --cache            write cache files (off in batch mode)\n"
+           "Without a file, the model is chosen from a menu.\n",
+           program, program, program, program, CONTAINER_SUFFIX,
+           program, OOC_SUFFIX, WINDOW_WIDTH, WINDOW_HEIGHT);
+}
 
 // viewer subroutine
 int main(int argc, char *argv[])
 {
-    char filename[STR_LEN];
-    int flag;
+    char filename[STR_LEN + 1] = "";
+    int w = WINDOW_WIDTH, h = WINDOW_HEIGHT;
+    int i;
 
-    // ask for filename, until a valid file is opened
-    do
-    {
-        get_filename(filename);
-        flag = parse_file(filename, argv[0]);
-    } while (flag);
+    // offscreen benchmark, without any window
+    if (argc > 1 && !strcmp(argv[1], "--benchmark"))
+        return run_benchmark(argc, argv);
 
-    // calculate bounding box center and radius, scale model if needed,
-    // convert color into [0, 1] range
-    init_model();
+    // offscreen processing of many models, without any window
+    if (argc > 1 && !strcmp(argv[1], "--batch"))
+        return run_batch(argc, argv);
 
+    // write a model into a compressed container
+    if (argc > 1 && !strcmp(argv[1], "--compress"))
+    {
+        if (argc != 4)
+        {
+            printf("Usage: %s --compress model.ply model%s\n",
+                    argv[0], CONTAINER_SUFFIX);
+            return EXIT_FAILURE;
+        }
+        return compress_model(argv[2], argv[3], argv[0]);
+    }
+
+    // convert a model into chunks for out-of-core rendering
+    if (argc > 1 && !strcmp(argv[1], "--chunk"))
+    {
+        if (argc != 4)
+        {
+            printf("Usage: %s --chunk model.ply model%s\n",
+                    argv[0], OOC_SUFFIX);
+            return EXIT_FAILURE;
+        }
+        return build_chunks(argv[2], argv[3]) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    // window size, model options and model file
+    for (i = 1; i < argc; i++)
+    {
+        int applied = parse_option(argc, argv, &i);
+
+        if (applied < 0)
+            return EXIT_FAILURE;
+        if (applied)
+            continue;
+
+        if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h"))
+        {
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        }
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w < 1 || h < 1)
+            {
+                printf("Invalid window size %s.\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (argv[i][0] != '-' && !filename[0]
+                && strlen(argv[i]) <= STR_LEN)
+            strcpy(filename, argv[i]);
+        else
+        {
+            printf("Unknown argument %s.\n", argv[i]);
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // ask for filename, if not given, then load the model in background
+    // while the window is shown
+    if (filename[0])
+        start_loading(filename, argv[0], 0);
+    else
+    {
+        get_filename(filename);
+        start_loading(filename, argv[0], 1);
+    }
 
     glutInit(&argc, argv);
-    glutInitWindowSize(1920, 1080);
+    glutInitWindowSize(w, h);
     glutInitWindowPosition(10, 10);
     glutInitDisplayMode(GLUT_RGB | GLUT_DEPTH | GLUT_DOUBLE);
 
@@ -67,31 +150,11 @@ int main(int argc, char *argv[])
     glutSpecialUpFunc(special_key_release);
     glutIgnoreKeyRepeat(1); // ignore auto-repeated keystrokes
 
-    createGLUTMenu();
-
-    glClearColor(0, 0, 0, 1); // viewport background color (rgba)
-
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-
-    glEnable(GL_LIGHT0);
-    glEnable(GL_COLOR_MATERIAL);
-    glEnable(GL_LIGHTING);
-
-    // LIGHT0 properties
-    glLightfv(GL_LIGHT0, GL_AMBIENT,  light_ambient);
-    glLightfv(GL_LIGHT0, GL_DIFFUSE,  light_diffuse);
-    glLightfv(GL_LIGHT0, GL_SPECULAR, light_specular);
-
-    // material properties
-    glMaterialfv(GL_FRONT, GL_AMBIENT,   mat_ambient);
-    glMaterialfv(GL_FRONT, GL_DIFFUSE,   mat_diffuse);
-    glMaterialfv(GL_FRONT, GL_SPECULAR,  mat_specular);
-    glMaterialfv(GL_FRONT, GL_SHININESS, high_shininess);
+    // background, depth test, light and material
+    init_gl();
 
-    // launch function which updates angle for rotation
-    // i.e. model rotation starts automatically on program launch
-    glutTimerFunc(0, updateAngle, 0);
+    // wait for the model, then publish it and start its rotation
+    glutTimerFunc(0, check_loading, 0);
 
     glutMainLoop();
 
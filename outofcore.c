@@ -0,0 +1,1433 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file outofcore.c
+ * @author agent
+ * @date 2026-10-16
+ *
+ * Out-of-core rendering: a model is converted once into an octree of
+ * chunks stored on disk (see Chunk_node), whose leaves hold the full
+ * resolution triangles and whose inner nodes hold simplified versions of
+ * their children. While drawing, the octree is traversed from the root,
+ * refining a node only when its error would be visible on screen and its
+ * children are in memory; missing chunks are read by a separate thread and
+ * the least recently used ones are released, so that the chunks in memory
+ * never exceed a fixed budget.
+ *
+ * The conversion reads the source file sequentially, stores the vertices in
+ * a temporary file and accesses them through a memory mapping, so it needs
+ * memory only for a few chunks at a time.
+ */
+
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <stddef.h>
+#include "components.h"
+#include "outofcore.h"
+
+#if defined(__APPLE__) || defined(__linux__)
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <unistd.h>
+#endif // defined(__APPLE__) || defined(__linux__)
+
+int chunk_fd = -1;               //!< Chunked model file.
+Chunk_node *chunk_nodes = NULL;  //!< Nodes of the hierarchy, root first.
+Chunk_slot *chunk_slots = NULL;  //!< Memory state of each node.
+int n_chunk_nodes = 0;           //!< Number of nodes of the hierarchy.
+size_t chunk_budget = (size_t) OOC_BUDGET_MB << 20; /*!< Memory budget for
+                                                        the resident chunks. */
+size_t chunk_resident = 0;       //!< Size of the resident chunks.
+size_t chunk_drawn = 0;          //!< Size of the chunks of the current frame.
+size_t chunk_used = 0;           //!< Size of the chunks of the last frame.
+int *chunk_list = NULL;          //!< Resident chunks, in no order.
+int n_chunk_list = 0;            //!< Number of resident chunks.
+int chunk_frame = 0;             //!< Number of frames drawn.
+int chunk_queue[OOC_QUEUE];      //!< Chunks to be read, by priority.
+int chunk_queued = 0;            //!< Number of chunks to be read.
+int chunk_ready[OOC_QUEUE];      //!< Chunks read, to be uploaded.
+int chunk_n_ready = 0;           //!< Number of chunks to be uploaded.
+int chunk_request[OOC_QUEUE];    //!< Chunks missing in the current frame.
+float chunk_priority[OOC_QUEUE]; //!< Projected error of the missing chunks.
+int chunk_n_requests = 0;        //!< Number of chunks missing.
+#if defined(__APPLE__) || defined(__linux__)
+int chunk_threaded = 0;          //!< Nonzero if the loader thread runs.
+int chunk_closing = 0;           //!< Nonzero to stop the loader thread.
+pthread_t chunk_loader;          //!< Thread reading the chunks.
+pthread_mutex_t chunk_mutex = PTHREAD_MUTEX_INITIALIZER; /*!< Lock for the
+                                    queues and the chunk states. */
+pthread_cond_t chunk_cond = PTHREAD_COND_INITIALIZER; /*!< Signaled when
+                                    the queues change. */
+#endif // defined(__APPLE__) || defined(__linux__)
+
+/*!
+ * Size of the data of a chunk.
+ */
+static size_t chunk_size(const Chunk_node *n)
+{
+    return (size_t) n->n_vertex * sizeof (Packed_vertex)
+           + (size_t) n->n_indices
+             * (n->n_vertex <= 65536 ? sizeof (GLushort) : sizeof (GLuint));
+}
+
+/*!
+ * Interleave the bits of the cell coordinates, so that the children of a
+ * cell have consecutive codes, equal to the code of the parent followed by
+ * three bits.
+ */
+static unsigned int morton_code(const unsigned int c[3], int depth)
+{
+    unsigned int code = 0;
+    int b;
+
+    for (b = depth - 1; b >= 0; --b)
+        code = code << 3
+               | ((c[0] >> b) & 1) << 2
+               | ((c[1] >> b) & 1) << 1
+               | ((c[2] >> b) & 1);
+    return code;
+}
+
+/*!
+ * Inverse of morton_code(const unsigned int*, int).
+ */
+static void morton_cell(unsigned int code, int depth, unsigned int c[3])
+{
+    int b;
+
+    c[0] = c[1] = c[2] = 0;
+    for (b = 0; b < depth; ++b, code >>= 3)
+    {
+        c[0] |= ((code >> 2) & 1) << b;
+        c[1] |= ((code >> 1) & 1) << b;
+        c[2] |= (code & 1) << b;
+    }
+}
+
+/*!
+ * Skip the records of the elements from `first` to `last` (excluded).
+ */
+static int source_skip(Chunk_source *s, int first, int last)
+{
+    const Ply_element *e;
+    float values[9];
+    long i;
+
+    for (e = s->header.elements + first; e < s->header.elements + last; ++e)
+        for (i = 0; i < e->count; ++i)
+            if (read_ply_record(&s->reader, s->header.format, e,
+                        values, NULL, 0) < 0)
+                return -1;
+    return 0;
+}
+
+/*!
+ * Open the source model and move to its first vertex. The faces must follow
+ * the vertices, since they are read twice.
+ */
+static int source_open(Chunk_source *s, const char *filename)
+{
+    int c, line;
+
+    memset(s, 0, sizeof (*s));
+    s->file = fopen(filename, "rb");
+    if (s->file == NULL)
+    {
+        printf("Unable to open the file %s.\n", filename);
+        return -1;
+    }
+    if (read_ply_header(s->file, &s->header))
+    {
+        fclose(s->file);
+        return -1;
+    }
+    if (s->header.face_element < s->header.vertex_element)
+    {
+        printf("Faces declared before vertices are not supported.\n");
+        fclose(s->file);
+        return -1;
+    }
+
+    // skip the rest of the end_header line
+    while ((c = fgetc(s->file)) != EOF && c != '\n') {}
+
+    s->reader.file = s->file;
+    line = __LINE__ + 1;
+    s->reader.buf = (char*) malloc(TEXT_BLOCK_SIZE + 1);
+    if (s->reader.buf == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    if (source_skip(s, 0, s->header.vertex_element))
+    {
+        printf("Unexpected end of file.\n");
+        free(s->reader.buf);
+        fclose(s->file);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+ * Release the source model.
+ */
+static void source_close(Chunk_source *s)
+{
+    free(s->reader.buf);
+    fclose(s->file);
+}
+
+/*!
+ * Return the position in the file of the next record to be read.
+ */
+static long source_tell(Chunk_source *s)
+{
+    return ftell(s->file) - (long) (s->reader.size - s->reader.pos);
+}
+
+/*!
+ * Move to the record starting at the given position in the file.
+ */
+static void source_seek(Chunk_source *s, long pos)
+{
+    fseek(s->file, pos, SEEK_SET);
+    s->reader.size = s->reader.pos = 0;
+    s->reader.eof = 0;
+}
+
+/*!
+ * Read the next vertex, in packed format.
+ */
+static int source_vertex(Chunk_source *s, Packed_vertex *v)
+{
+    const Ply_header *h = &s->header;
+    float f[9] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+    int k;
+
+    if (read_ply_record(&s->reader, h->format,
+                &h->elements[h->vertex_element], f, NULL, 0) < 0)
+        return -1;
+
+    // colors are stored in [0, 255]
+    for (k = 6; k < 9; ++k)
+        f[k] /= 255;
+
+    pack_vertex(v, f, f + 3, h->is_colored ? f + 6 : NULL);
+    return 0;
+}
+
+/*!
+ * Read the next face, checking its vertices, and split it into triangles.
+ * Return the number of triangles, or -1 if the face is invalid.
+ */
+static int source_face(Chunk_source *s, GLuint *t)
+{
+    const Ply_header *h = &s->header;
+    GLuint polygon[MAX_FACE_VERTICES];
+    float values[9];
+    int n, k;
+
+    n = read_ply_record(&s->reader, h->format,
+            &h->elements[h->face_element], values, polygon,
+            MAX_FACE_VERTICES);
+    if (n > MAX_FACE_VERTICES)
+        return -1;
+    for (k = 0; k < n; ++k)
+        if (polygon[k] >= (GLuint) h->n_vertex)
+            return -1;
+    return n < 0 ? -1 : triangulate_polygon(polygon, n, t);
+}
+
+#if defined(__APPLE__) || defined(__linux__)
+/*!
+ * Map a file in memory, for reading and writing. A new file, filled with
+ * zeros, is created with the given size when `create` is nonzero.
+ */
+static void *map_file(const char *name, size_t size, int create)
+{
+    void *map;
+    int fd = open(name, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+
+    if (fd < 0)
+        return NULL;
+    if (create && ftruncate(fd, size))
+    {
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return map == MAP_FAILED ? NULL : map;
+}
+#endif // defined(__APPLE__) || defined(__linux__)
+
+/*!
+ * Add the area-weighted normal of a face to the normals of its vertices.
+ */
+static void add_face_normal(const Packed_vertex *v, const GLuint t[3],
+        float *normals)
+{
+    const float *a = v[t[0]].position;
+    const float *b = v[t[1]].position;
+    const float *c = v[t[2]].position;
+    float u[3], w[3], n[3];
+    int i, k;
+
+    for (k = 0; k < 3; ++k)
+    {
+        u[k] = b[k] - a[k];
+        w[k] = c[k] - a[k];
+    }
+    n[0] = u[1] * w[2] - u[2] * w[1];
+    n[1] = u[2] * w[0] - u[0] * w[2];
+    n[2] = u[0] * w[1] - u[1] * w[0];
+    for (i = 0; i < 3; ++i)
+        for (k = 0; k < 3; ++k)
+            normals[(size_t) t[i] * 3 + k] += n[k];
+}
+
+/*!
+ * Return the code of the leaf containing the centroid of a triangle.
+ */
+static unsigned int leaf_code(const Packed_vertex *v, const GLuint t[3],
+        const Chunk_header *h, float size, int depth)
+{
+    const unsigned int side = 1u << depth;
+    unsigned int c[3];
+    int k;
+
+    for (k = 0; k < 3; ++k)
+    {
+        float p = (v[t[0]].position[k] + v[t[1]].position[k]
+                   + v[t[2]].position[k]) / 3;
+        float x = (p - h->min_coord[k]) / size * side;
+        c[k] = x <= 0 ? 0 : (x >= side ? side - 1 : (unsigned int) x);
+    }
+    return morton_code(c, depth);
+}
+
+/*!
+ * Write the data of a chunk at the end of the output file, storing the
+ * indices in 16 bits when possible.
+ */
+static void write_chunk(FILE *out, Chunk_node *n, const Packed_vertex *v,
+        const GLuint *indices, int n_indices, int n_vertex)
+{
+    int i;
+
+    fseek(out, 0, SEEK_END);
+    n->offset = ftell(out);
+    n->n_vertex = n_vertex;
+    n->n_indices = n_indices;
+
+    fwrite(v, sizeof (Packed_vertex), n_vertex, out);
+    if (n_vertex <= 65536)
+        for (i = 0; i < n_indices; ++i)
+        {
+            GLushort s = (GLushort) indices[i];
+            fwrite(&s, sizeof s, 1, out);
+        }
+    else
+        fwrite(indices, sizeof (GLuint), n_indices, out);
+}
+
+/*!
+ * Set the bounding sphere of a chunk from its vertices.
+ */
+static void bound_vertices(Chunk_node *n, const Packed_vertex *v, int count)
+{
+    float max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    float min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float r = 0;
+    int i, k;
+
+    for (i = 0; i < count; ++i)
+        for (k = 0; k < 3; ++k)
+        {
+            if (v[i].position[k] > max[k])
+                max[k] = v[i].position[k];
+            if (v[i].position[k] < min[k])
+                min[k] = v[i].position[k];
+        }
+    for (k = 0; k < 3; ++k)
+        n->center[k] = count ? (max[k] + min[k]) / 2 : 0;
+    for (i = 0; i < count; ++i)
+    {
+        float d = 0;
+        for (k = 0; k < 3; ++k)
+            d += (v[i].position[k] - n->center[k])
+                 * (v[i].position[k] - n->center[k]);
+        if (d > r)
+            r = d;
+    }
+    n->radius = sqrt(r);
+}
+
+/*!
+ * Build a leaf chunk from its triangles, which refer to the global vertex
+ * array, keeping only the vertices they use.
+ */
+static void write_leaf(FILE *out, Chunk_node *n, const Packed_vertex *v,
+        const GLuint *triangles, int n_indices)
+{
+    GLuint *keys, *local;
+    Packed_vertex *chunk;
+    size_t table_size = 1, s;
+    int i, count = 0, line;
+
+    while (table_size < 2 * (size_t) n_indices)
+        table_size *= 2;
+
+    // hash table from global index + 1 to local index
+    line = __LINE__ + 1;
+    keys = (GLuint*) calloc(2 * table_size, sizeof (GLuint));
+    if (keys == NULL)
+        error_handler("calloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    local = (GLuint*) malloc(sizeof (GLuint) * n_indices);
+    if (local == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    chunk = (Packed_vertex*) malloc(sizeof (Packed_vertex) * n_indices);
+    if (chunk == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    for (i = 0; i < n_indices; ++i)
+    {
+        s = (triangles[i] * 2654435761U) & (table_size - 1);
+        while (keys[2 * s] && keys[2 * s] != triangles[i] + 1)
+            s = (s + 1) & (table_size - 1);
+        if (!keys[2 * s])
+        {
+            keys[2 * s] = triangles[i] + 1;
+            keys[2 * s + 1] = count;
+            chunk[count++] = v[triangles[i]];
+        }
+        local[i] = keys[2 * s + 1];
+    }
+
+    bound_vertices(n, chunk, count);
+    n->error = 0;
+    write_chunk(out, n, chunk, local, n_indices, count);
+
+    free(keys);
+    free(local);
+    free(chunk);
+}
+
+/*!
+ * Read back the data of a chunk already written, appending its vertices
+ * and its indices (rebased) to the given arrays.
+ */
+static void read_chunk(FILE *out, const Chunk_node *n, Packed_vertex *v,
+        int *n_vertex, GLuint *indices, int *n_indices)
+{
+    int i;
+
+    fseek(out, n->offset, SEEK_SET);
+    fread(v + *n_vertex, sizeof (Packed_vertex), n->n_vertex, out);
+    for (i = 0; i < n->n_indices; ++i)
+    {
+        GLuint index = 0;
+        if (n->n_vertex <= 65536)
+        {
+            GLushort s = 0;
+            fread(&s, sizeof s, 1, out);
+            index = s;
+        }
+        else
+            fread(&index, sizeof index, 1, out);
+        indices[*n_indices + i] = index + *n_vertex;
+    }
+    *n_vertex += n->n_vertex;
+    *n_indices += n->n_indices;
+}
+
+/*!
+ * Build an inner chunk simplifying the union of its children by vertex
+ * clustering: the cell of the node is split in `OOC_NODE_GRID` cells per
+ * side, the vertices in each cell are replaced by their mean and the
+ * triangles which become degenerate are dropped. The error of the node is
+ * the diagonal of a cell, or the error of its children if larger.
+ */
+static void write_inner(FILE *out, Chunk_node *nodes, int i,
+        const float origin[3], float size, int *cell_vertex)
+{
+    Chunk_node *n = &nodes[i];
+    Packed_vertex *v, *merged;
+    GLuint *indices, *cell_of;
+    float *sum, max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    float min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    const float cell = size / OOC_NODE_GRID;
+    int n_vertex = 0, n_indices = 0, count = 0, kept = 0;
+    int c, j, k, line;
+
+    for (c = n->first_child; c < n->first_child + n->n_children; ++c)
+    {
+        n_vertex += nodes[c].n_vertex;
+        n_indices += nodes[c].n_indices;
+    }
+
+    line = __LINE__ + 1;
+    v = (Packed_vertex*) malloc(sizeof (Packed_vertex) * (n_vertex + 1));
+    if (v == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    merged = (Packed_vertex*) malloc(sizeof (Packed_vertex) * (n_vertex + 1));
+    if (merged == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    indices = (GLuint*) malloc(sizeof (GLuint) * (n_indices + 1));
+    if (indices == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    cell_of = (GLuint*) malloc(sizeof (GLuint) * (n_vertex + 1));
+    if (cell_of == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    sum = (float*) calloc(10 * ((size_t) n_vertex + 1), sizeof (float));
+    if (sum == NULL)
+        error_handler("calloc", __func__, __FILE__, line);
+
+    n_vertex = n_indices = 0;
+    n->error = 0;
+    for (c = n->first_child; c < n->first_child + n->n_children; ++c)
+    {
+        read_chunk(out, &nodes[c], v, &n_vertex, indices, &n_indices);
+        if (nodes[c].error > n->error)
+            n->error = nodes[c].error;
+
+        // the sphere of the node contains the spheres of its children
+        for (k = 0; k < 3; ++k)
+        {
+            if (nodes[c].center[k] + nodes[c].radius > max[k])
+                max[k] = nodes[c].center[k] + nodes[c].radius;
+            if (nodes[c].center[k] - nodes[c].radius < min[k])
+                min[k] = nodes[c].center[k] - nodes[c].radius;
+        }
+    }
+    if (cell * sqrt(3) > n->error)
+        n->error = cell * sqrt(3);
+
+    // accumulate the vertices of each cell
+    for (j = 0; j < n_vertex; ++j)
+    {
+        unsigned int g[3];
+        int id;
+
+        for (k = 0; k < 3; ++k)
+        {
+            float x = (v[j].position[k] - origin[k]) / cell;
+            g[k] = x <= 0 ? 0
+                   : (x >= OOC_NODE_GRID ? OOC_NODE_GRID - 1
+                                         : (unsigned int) x);
+        }
+        id = g[0] + OOC_NODE_GRID * (g[1] + OOC_NODE_GRID * g[2]);
+        if (cell_vertex[id] < 0)
+            cell_vertex[id] = count++;
+        cell_of[j] = cell_vertex[id];
+
+        for (k = 0; k < 3; ++k)
+        {
+            sum[10 * cell_of[j] + k] += v[j].position[k];
+            sum[10 * cell_of[j] + 3 + k] += v[j].normal[k] / 127.0f;
+            sum[10 * cell_of[j] + 6 + k] += v[j].color[k] / 255.0f;
+        }
+        sum[10 * cell_of[j] + 9] += 1;
+    }
+
+    // replace the vertices of each cell with their mean
+    for (j = 0; j < count; ++j)
+    {
+        float *s = sum + 10 * j;
+        for (k = 0; k < 9; ++k)
+            s[k] /= s[9];
+        pack_vertex(&merged[j], s, s + 3, s + 6);
+    }
+
+    // reset the cells used, for the next node
+    for (j = 0; j < n_vertex; ++j)
+    {
+        unsigned int g[3];
+        for (k = 0; k < 3; ++k)
+        {
+            float x = (v[j].position[k] - origin[k]) / cell;
+            g[k] = x <= 0 ? 0
+                   : (x >= OOC_NODE_GRID ? OOC_NODE_GRID - 1
+                                         : (unsigned int) x);
+        }
+        cell_vertex[g[0] + OOC_NODE_GRID * (g[1] + OOC_NODE_GRID * g[2])] =
+            -1;
+    }
+
+    // remap triangles, dropping the degenerate ones
+    for (j = 0; j < n_indices; j += 3)
+    {
+        GLuint a = cell_of[indices[j]];
+        GLuint b = cell_of[indices[j + 1]];
+        GLuint d = cell_of[indices[j + 2]];
+        if (a == b || b == d || a == d)
+            continue;
+        indices[kept++] = a;
+        indices[kept++] = b;
+        indices[kept++] = d;
+    }
+
+    for (k = 0; k < 3; ++k)
+        n->center[k] = (max[k] + min[k]) / 2;
+    n->radius = 0;
+    for (c = n->first_child; c < n->first_child + n->n_children; ++c)
+    {
+        float d = 0;
+        for (k = 0; k < 3; ++k)
+            d += (nodes[c].center[k] - n->center[k])
+                 * (nodes[c].center[k] - n->center[k]);
+        if (sqrt(d) + nodes[c].radius > n->radius)
+            n->radius = sqrt(d) + nodes[c].radius;
+    }
+
+    write_chunk(out, n, merged, indices, kept, count);
+
+    free(v);
+    free(merged);
+    free(indices);
+    free(cell_of);
+    free(sum);
+}
+
+/*!
+ * The conversion runs in the following steps:
+ * - the vertices are read and stored in packed format in a temporary file,
+ *   which is then mapped in memory, computing the bounding box;
+ * - the depth of the octree is chosen so that a surface (which crosses
+ *   about 4<sup>d</sup> of the 8<sup>d</sup> leaves) gets about
+ *   `OOC_LEAF_FACES` faces per leaf;
+ * - the faces are read twice: the first time to count the faces of each
+ *   leaf, the second time to store them, grouped by leaf, in a second
+ *   mapped temporary file;
+ * - each leaf is written with its own vertices, then the inner nodes are
+ *   built level by level, from the deepest one, reading back the chunks of
+ *   their children.
+ *
+ * Memory is needed only for the counters of the leaves and for the chunks
+ * being built; everything else is paged by the operating system.
+ */
+int build_chunks(const char *source, const char *target)
+{
+#if defined(__APPLE__) || defined(__linux__)
+    char vtx_name[STR_LEN + 16], tri_name[STR_LEN + 16];
+    char nrm_name[STR_LEN + 16];
+    Chunk_source src;
+    Chunk_header h;
+    Chunk_node *nodes = NULL;
+    Packed_vertex *vertices = NULL;
+    GLuint *triangles = NULL, t[3 * MAX_FACE_VERTICES];
+    float *normals = NULL;
+    unsigned int *level[OOC_MAX_DEPTH + 1], leaves, code;
+    int n_level[OOC_MAX_DEPTH + 1], level_first[OOC_MAX_DEPTH + 2];
+    size_t *first = NULL;
+    int *cell_vertex = NULL;
+    long faces_pos;
+    float size = 0;
+    int depth = 0, d, i, j, k, n, line, error = 0;
+    int n_triangles = 0;
+    FILE *f, *out;
+
+    if (strlen(target) > STR_LEN || source_open(&src, source))
+        return -1;
+
+    memset(&h, 0, sizeof (h));
+    memcpy(h.magic, "MESHVWO", 8);
+    h.version = OOC_VERSION;
+    h.byte_order = 0x01020304;
+    h.n_vertex = src.header.n_vertex;
+    h.n_faces = src.header.n_faces;
+    h.is_colored = src.header.is_colored;
+    for (k = 0; k < 3; ++k)
+    {
+        h.max_coord[k] = -FLT_MAX;
+        h.min_coord[k] = FLT_MAX;
+    }
+
+    // vertices, in packed format, into a temporary file
+    sprintf(vtx_name, "%s.vtx.tmp", target);
+    sprintf(tri_name, "%s.tri.tmp", target);
+    sprintf(nrm_name, "%s.nrm.tmp", target);
+    f = fopen(vtx_name, "wb");
+    if (f == NULL)
+    {
+        printf("Unable to write the file %s.\n", vtx_name);
+        source_close(&src);
+        return -1;
+    }
+    for (i = 0; i < h.n_vertex && !error; ++i)
+    {
+        Packed_vertex v;
+        error = source_vertex(&src, &v);
+        fwrite(&v, sizeof v, 1, f);
+        for (k = 0; k < 3; ++k)
+        {
+            if (v.position[k] > h.max_coord[k])
+                h.max_coord[k] = v.position[k];
+            if (v.position[k] < h.min_coord[k])
+                h.min_coord[k] = v.position[k];
+        }
+    }
+    error |= ferror(f);
+    error |= fclose(f);
+    error = error || source_skip(&src, src.header.vertex_element + 1,
+            src.header.face_element);
+    faces_pos = source_tell(&src);
+    if (!error)
+    {
+        vertices = (Packed_vertex*) map_file(vtx_name,
+                sizeof (Packed_vertex) * h.n_vertex, 0);
+        error = vertices == NULL;
+    }
+
+    // missing normals are accumulated from the faces in a third file
+    if (!error && !src.header.has_normals)
+    {
+        normals = (float*) map_file(nrm_name,
+                sizeof (float) * 3 * (size_t) h.n_vertex, 1);
+        error = normals == NULL;
+    }
+
+    // octree depth and cube
+    for (k = 0; k < 3; ++k)
+        if (h.max_coord[k] - h.min_coord[k] > size)
+            size = h.max_coord[k] - h.min_coord[k];
+    if (size <= 0)
+        size = 1;
+    while (depth < OOC_MAX_DEPTH
+            && (1 << 2 * depth) < h.n_faces / OOC_LEAF_FACES)
+        depth++;
+    leaves = 1u << 3 * depth;
+
+    // count the faces of each leaf, then group them by leaf
+    line = __LINE__ + 1;
+    first = (size_t*) calloc(leaves + 1, sizeof (size_t));
+    if (first == NULL)
+        error_handler("calloc", __func__, __FILE__, line);
+    for (i = 0; i < src.header.n_faces && !error; ++i)
+    {
+        n = source_face(&src, t);
+        error = n < 0 || n > INT_MAX / 3 - n_triangles;
+        for (j = 0; j < n && !error; ++j)
+        {
+            first[leaf_code(vertices, t + 3 * j, &h, size, depth) + 1]++;
+            if (normals != NULL)
+                add_face_normal(vertices, t + 3 * j, normals);
+        }
+        n_triangles += n;
+    }
+    h.n_faces = n_triangles;
+    if (normals != NULL)
+    {
+        for (i = 0; i < h.n_vertex; ++i)
+        {
+            float c[3];
+            for (k = 0; k < 3; ++k)
+                c[k] = vertices[i].color[k] / 255.0f;
+            pack_vertex(&vertices[i], vertices[i].position,
+                    normals + (size_t) i * 3, h.is_colored ? c : NULL);
+        }
+        munmap(normals, sizeof (float) * 3 * (size_t) h.n_vertex);
+        remove(nrm_name);
+    }
+    for (code = 0; code < leaves; ++code)
+        first[code + 1] += first[code];
+    if (!error)
+    {
+        triangles = (GLuint*) map_file(tri_name,
+                sizeof (GLuint) * 3 * (size_t) h.n_faces, 1);
+        error = triangles == NULL;
+    }
+    source_seek(&src, faces_pos);
+    for (i = 0; i < src.header.n_faces && !error; ++i)
+    {
+        n = source_face(&src, t);
+        error = n < 0;
+        for (j = 0; j < n && !error; ++j)
+        {
+            size_t *p = &first[leaf_code(vertices, t + 3 * j, &h, size,
+                    depth)];
+            memcpy(triangles + 3 * *p, t + 3 * j, 3 * sizeof (GLuint));
+            (*p)++;
+        }
+    }
+    source_close(&src);
+
+    if (error)
+    {
+        printf("Invalid or truncated model data.\n");
+        if (vertices != NULL)
+            munmap(vertices, sizeof (Packed_vertex) * h.n_vertex);
+        if (triangles != NULL)
+            munmap(triangles, sizeof (GLuint) * 3 * (size_t) h.n_faces);
+        remove(vtx_name);
+        remove(tri_name);
+        free(first);
+        return -1;
+    }
+
+    // after the grouping, first[code] is the end of the leaf faces
+    memmove(first + 1, first, sizeof (size_t) * leaves);
+    first[0] = 0;
+
+    // codes of the nodes of each level, i.e. the parents of the next one
+    for (d = depth; d >= 0; --d)
+    {
+        line = __LINE__ + 1;
+        level[d] = (unsigned int*) malloc(sizeof (unsigned int)
+                * (d == depth ? leaves : (unsigned int) n_level[d + 1]));
+        if (level[d] == NULL)
+            error_handler("malloc", __func__, __FILE__, line);
+        n_level[d] = 0;
+        if (d == depth)
+        {
+            for (code = 0; code < leaves; ++code)
+                if (first[code + 1] > first[code])
+                    level[d][n_level[d]++] = code;
+        }
+        else
+            for (i = 0; i < n_level[d + 1]; ++i)
+                if (n_level[d] == 0
+                        || level[d][n_level[d] - 1] != level[d + 1][i] >> 3)
+                    level[d][n_level[d]++] = level[d + 1][i] >> 3;
+    }
+
+    // nodes sorted by level, with the children of each node consecutive
+    level_first[0] = 0;
+    for (d = 0; d <= depth; ++d)
+        level_first[d + 1] = level_first[d] + n_level[d];
+    h.n_nodes = level_first[depth + 1];
+    line = __LINE__ + 1;
+    nodes = (Chunk_node*) calloc(h.n_nodes, sizeof (Chunk_node));
+    if (nodes == NULL)
+        error_handler("calloc", __func__, __FILE__, line);
+    for (d = 0; d < depth; ++d)
+        for (i = j = 0; i < n_level[d]; ++i)
+        {
+            Chunk_node *n = &nodes[level_first[d] + i];
+            n->first_child = level_first[d + 1] + j;
+            while (j < n_level[d + 1] && level[d + 1][j] >> 3 == level[d][i])
+            {
+                n->n_children++;
+                j++;
+            }
+        }
+
+    out = fopen(target, "w+b");
+    if (out == NULL)
+    {
+        printf("Unable to write the file %s.\n", target);
+        error = 1;
+    }
+    else
+    {
+        fwrite(&h, sizeof (h), 1, out);
+        fwrite(nodes, sizeof (Chunk_node), h.n_nodes, out);
+
+        // leaves, with full resolution
+        for (i = 0; i < n_level[depth]; ++i)
+        {
+            code = level[depth][i];
+            write_leaf(out, &nodes[level_first[depth] + i], vertices,
+                    triangles + 3 * first[code],
+                    (int) (3 * (first[code + 1] - first[code])));
+        }
+
+        // inner nodes, simplified from their children
+        line = __LINE__ + 1;
+        cell_vertex = (int*) malloc(sizeof (int)
+                * OOC_NODE_GRID * OOC_NODE_GRID * OOC_NODE_GRID);
+        if (cell_vertex == NULL)
+            error_handler("malloc", __func__, __FILE__, line);
+        for (i = 0; i < OOC_NODE_GRID * OOC_NODE_GRID * OOC_NODE_GRID; ++i)
+            cell_vertex[i] = -1;
+        for (d = depth - 1; d >= 0; --d)
+            for (i = 0; i < n_level[d]; ++i)
+            {
+                const float cell_size = size / (1 << d);
+                unsigned int c[3];
+                float origin[3];
+
+                morton_cell(level[d][i], d, c);
+                for (k = 0; k < 3; ++k)
+                    origin[k] = h.min_coord[k] + c[k] * cell_size;
+                write_inner(out, nodes, level_first[d] + i, origin,
+                        cell_size, cell_vertex);
+            }
+        free(cell_vertex);
+
+        // final node table
+        fseek(out, 0, SEEK_SET);
+        fwrite(&h, sizeof (h), 1, out);
+        fwrite(nodes, sizeof (Chunk_node), h.n_nodes, out);
+        error = ferror(out);
+        error |= fclose(out);
+        if (error)
+        {
+            printf("Unable to write the file %s.\n", target);
+            remove(target);
+        }
+        else
+            printf("%d faces in %d chunks, %d levels, root with %d faces\n",
+                    h.n_faces, h.n_nodes, depth + 1,
+                    nodes[0].n_indices / 3);
+    }
+
+    munmap(vertices, sizeof (Packed_vertex) * h.n_vertex);
+    munmap(triangles, sizeof (GLuint) * 3 * (size_t) h.n_faces);
+    remove(vtx_name);
+    remove(tri_name);
+    for (d = 0; d <= depth; ++d)
+        free(level[d]);
+    free(first);
+    free(nodes);
+
+    return error ? -1 : 0;
+#else // _WIN32
+    UNUSED(source);
+    UNUSED(target);
+    return -1;
+#endif // defined(__APPLE__) || defined(__linux__)
+}
+
+#if defined(__APPLE__) || defined(__linux__)
+/*!
+ * Read the data of a chunk from the file.
+ */
+static void *read_chunk_data(int i)
+{
+    const size_t size = chunk_size(&chunk_nodes[i]);
+    void *data;
+    int line;
+
+    if (size == 0)
+        return NULL;
+
+    line = __LINE__ + 1;
+    data = malloc(size);
+    if (data == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    if (pread(chunk_fd, data, size, chunk_nodes[i].offset) != (ssize_t) size)
+    {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+/*!
+ * Put a chunk just read in the ready list, to be uploaded by the drawing
+ * thread. Called with the lock held.
+ */
+static void store_chunk(int i, void *data)
+{
+    if (data == NULL && chunk_size(&chunk_nodes[i]))
+        chunk_slots[i].state = CHUNK_FAILED;
+    else
+    {
+        chunk_slots[i].data = data;
+        chunk_slots[i].state = CHUNK_READ;
+        chunk_ready[chunk_n_ready++] = i;
+    }
+}
+
+/*!
+ * Body of the thread reading the chunks. It takes the chunk with the
+ * highest priority from the queue and reads it, as long as the chunks read
+ * and not yet uploaded do not fill the ready list, until the model is
+ * closed.
+ */
+static void *chunk_loader_main(void *arg)
+{
+    UNUSED(arg);
+
+    for (;;)
+    {
+        void *data;
+        int i;
+
+        pthread_mutex_lock(&chunk_mutex);
+        while (!chunk_closing
+               && (chunk_queued == 0 || chunk_n_ready == OOC_QUEUE))
+            pthread_cond_wait(&chunk_cond, &chunk_mutex);
+        if (chunk_closing)
+        {
+            pthread_mutex_unlock(&chunk_mutex);
+            break;
+        }
+        i = chunk_queue[0];
+        memmove(chunk_queue, chunk_queue + 1, sizeof (int) * --chunk_queued);
+        chunk_slots[i].state = CHUNK_READING;
+        pthread_mutex_unlock(&chunk_mutex);
+
+        data = read_chunk_data(i);
+
+        pthread_mutex_lock(&chunk_mutex);
+        store_chunk(i, data);
+        pthread_mutex_unlock(&chunk_mutex);
+    }
+
+    return NULL;
+}
+#endif // defined(__APPLE__) || defined(__linux__)
+
+/*!
+ * The header and the node table are checked against the file size, the
+ * root chunk is read immediately, so that the model can be drawn from the
+ * first frame, and the loader thread is started.
+ */
+int open_chunks(const char *filename, Chunk_header *h)
+{
+#if defined(__APPLE__) || defined(__linux__)
+    struct stat st;
+    size_t table;
+    int i, line;
+
+    chunk_fd = open(filename, O_RDONLY);
+    if (chunk_fd < 0)
+    {
+        printf("Unable to open the file %s.\n", filename);
+        return -1;
+    }
+    if (fstat(chunk_fd, &st)
+            || pread(chunk_fd, h, sizeof (*h), 0) != (ssize_t) sizeof (*h)
+            || memcmp(h->magic, "MESHVWO", 8)
+            || h->version != OOC_VERSION
+            || h->byte_order != 0x01020304
+            || h->n_nodes <= 0
+            || (size_t) st.st_size < sizeof (*h)
+                                     + sizeof (Chunk_node) * h->n_nodes)
+    {
+        printf("Invalid chunked model %s.\n", filename);
+        close(chunk_fd);
+        chunk_fd = -1;
+        return -1;
+    }
+
+    table = sizeof (Chunk_node) * h->n_nodes;
+    line = __LINE__ + 1;
+    chunk_nodes = (Chunk_node*) malloc(table);
+    if (chunk_nodes == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    chunk_slots = (Chunk_slot*) calloc(h->n_nodes, sizeof (Chunk_slot));
+    if (chunk_slots == NULL)
+        error_handler("calloc", __func__, __FILE__, line);
+    line = __LINE__ + 1;
+    chunk_list = (int*) malloc(sizeof (int) * h->n_nodes);
+    if (chunk_list == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+    n_chunk_nodes = h->n_nodes;
+
+    // every chunk must lie in the file, and every child after its parent
+    if (pread(chunk_fd, chunk_nodes, table, sizeof (*h)) != (ssize_t) table)
+        i = 0;
+    else
+        for (i = 0; i < n_chunk_nodes; ++i)
+        {
+            const Chunk_node *n = &chunk_nodes[i];
+            if (n->n_vertex < 0 || n->n_indices < 0 || n->offset < 0
+                    || n->offset + (long long) chunk_size(n) > st.st_size
+                    || n->n_children < 0
+                    || (n->n_children
+                        && (n->first_child <= i
+                            || n->first_child > n_chunk_nodes
+                                                - n->n_children)))
+                break;
+        }
+    if (i < n_chunk_nodes || (chunk_size(chunk_nodes)
+                && (chunk_slots[0].data = read_chunk_data(0)) == NULL))
+    {
+        printf("Invalid chunked model %s.\n", filename);
+        free(chunk_nodes);
+        free(chunk_slots);
+        free(chunk_list);
+        chunk_nodes = NULL;
+        chunk_slots = NULL;
+        chunk_list = NULL;
+        n_chunk_nodes = 0;
+        close(chunk_fd);
+        chunk_fd = -1;
+        return -1;
+    }
+
+    chunk_slots[0].state = CHUNK_READ;
+    chunk_ready[chunk_n_ready++] = 0;
+
+    // without the thread, chunks are read while drawing
+    chunk_threaded = !pthread_create(&chunk_loader, NULL, chunk_loader_main,
+            NULL);
+
+    return 0;
+#else // _WIN32
+    UNUSED(filename);
+    UNUSED(h);
+    printf("Chunked models are not supported on this platform.\n");
+    return -1;
+#endif // defined(__APPLE__) || defined(__linux__)
+}
+
+/*!
+ * The loader thread is stopped before releasing the chunks, the ones read
+ * but not uploaded included.
+ */
+void close_chunks(void)
+{
+#if defined(__APPLE__) || defined(__linux__)
+    int i;
+
+    if (chunk_fd < 0)
+        return;
+
+    if (chunk_threaded)
+    {
+        pthread_mutex_lock(&chunk_mutex);
+        chunk_closing = 1;
+        pthread_cond_broadcast(&chunk_cond);
+        pthread_mutex_unlock(&chunk_mutex);
+        pthread_join(chunk_loader, NULL);
+        chunk_closing = 0;
+        chunk_threaded = 0;
+    }
+
+    for (i = 0; i < n_chunk_nodes; ++i)
+    {
+        if (chunk_slots[i].buffer[0])
+            glDeleteBuffers(2, chunk_slots[i].buffer);
+        free(chunk_slots[i].data);
+    }
+    free(chunk_nodes);
+    free(chunk_slots);
+    free(chunk_list);
+    chunk_nodes = NULL;
+    chunk_slots = NULL;
+    chunk_list = NULL;
+    n_chunk_nodes = n_chunk_list = 0;
+    chunk_resident = chunk_drawn = chunk_used = 0;
+    chunk_frame = 0;
+    chunk_queued = chunk_n_ready = chunk_n_requests = 0;
+
+    close(chunk_fd);
+    chunk_fd = -1;
+#endif // defined(__APPLE__) || defined(__linux__)
+}
+
+void set_chunk_budget(size_t bytes)
+{
+    chunk_budget = bytes;
+}
+
+#if defined(__APPLE__) || defined(__linux__)
+/*!
+ * Make the chunks read by the loader thread ready to be drawn, copying
+ * them into buffer objects when supported.
+ */
+static void upload_chunks(void)
+{
+    int ready[OOC_QUEUE];
+    int n_ready, r;
+
+    pthread_mutex_lock(&chunk_mutex);
+    n_ready = chunk_n_ready;
+    memcpy(ready, chunk_ready, sizeof (int) * n_ready);
+    chunk_n_ready = 0;
+    pthread_cond_signal(&chunk_cond);
+    pthread_mutex_unlock(&chunk_mutex);
+
+    for (r = 0; r < n_ready; ++r)
+    {
+        const Chunk_node *n = &chunk_nodes[ready[r]];
+        Chunk_slot *s = &chunk_slots[ready[r]];
+        const size_t vertex_size = sizeof (Packed_vertex) * n->n_vertex;
+
+        if (s->data != NULL && buffer_objects_supported())
+        {
+            glGenBuffers(2, s->buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, s->buffer[0]);
+            glBufferData(GL_ARRAY_BUFFER, vertex_size, s->data,
+                    GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->buffer[1]);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                    chunk_size(n) - vertex_size,
+                    (const char*) s->data + vertex_size, GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+            free(s->data);
+            s->data = NULL;
+        }
+
+        s->state = CHUNK_RESIDENT;
+        s->last_used = chunk_frame;
+        chunk_resident += chunk_size(n);
+        chunk_list[n_chunk_list++] = ready[r];
+    }
+}
+
+/*!
+ * Release the chunks not used in the current frame, least recently used
+ * first, until the resident chunks fit in the budget. The root is never
+ * released.
+ */
+static void evict_chunks(void)
+{
+    while (chunk_resident > chunk_budget)
+    {
+        int l, i, oldest = -1;
+
+        for (l = 0; l < n_chunk_list; ++l)
+        {
+            i = chunk_list[l];
+            if (i != 0 && chunk_slots[i].last_used < chunk_frame
+                    && (oldest < 0 || chunk_slots[i].last_used
+                                      < chunk_slots[chunk_list[oldest]]
+                                        .last_used))
+                oldest = l;
+        }
+        if (oldest < 0)
+            break;
+
+        i = chunk_list[oldest];
+        chunk_list[oldest] = chunk_list[--n_chunk_list];
+        if (chunk_slots[i].buffer[0])
+            glDeleteBuffers(2, chunk_slots[i].buffer);
+        chunk_slots[i].buffer[0] = chunk_slots[i].buffer[1] = 0;
+        free(chunk_slots[i].data);
+        chunk_slots[i].data = NULL;
+        chunk_slots[i].state = CHUNK_ABSENT;
+        chunk_resident -= chunk_size(&chunk_nodes[i]);
+    }
+}
+
+/*!
+ * Add a chunk to the requests of the current frame, keeping the
+ * `OOC_QUEUE` ones with the largest projected error.
+ */
+static void request_chunk(int i, float priority)
+{
+    int r;
+
+    if (chunk_n_requests == OOC_QUEUE)
+    {
+        if (priority <= chunk_priority[OOC_QUEUE - 1])
+            return;
+        chunk_n_requests--;
+    }
+    for (r = chunk_n_requests; r > 0 && chunk_priority[r - 1] < priority; --r)
+    {
+        chunk_request[r] = chunk_request[r - 1];
+        chunk_priority[r] = chunk_priority[r - 1];
+    }
+    chunk_request[r] = i;
+    chunk_priority[r] = priority;
+    chunk_n_requests++;
+}
+
+/*!
+ * Replace the queue of the loader thread with the requests of the current
+ * frame. Chunks no longer needed and not yet being read go back to disk.
+ */
+static void update_queue(void)
+{
+    int q, r;
+
+    pthread_mutex_lock(&chunk_mutex);
+    for (q = 0; q < chunk_queued; ++q)
+        chunk_slots[chunk_queue[q]].state = CHUNK_ABSENT;
+    chunk_queued = 0;
+    for (r = 0; r < chunk_n_requests; ++r)
+    {
+        Chunk_slot *s = &chunk_slots[chunk_request[r]];
+        if (s->state == CHUNK_ABSENT)
+        {
+            s->state = CHUNK_QUEUED;
+            chunk_queue[chunk_queued++] = chunk_request[r];
+        }
+    }
+    pthread_cond_signal(&chunk_cond);
+    pthread_mutex_unlock(&chunk_mutex);
+
+    // without the thread, the chunk with the highest priority is read now
+    if (!chunk_threaded && chunk_queued && chunk_n_ready < OOC_QUEUE)
+    {
+        int i = chunk_queue[0];
+        void *data = read_chunk_data(i);
+        memmove(chunk_queue, chunk_queue + 1, sizeof (int) * --chunk_queued);
+        store_chunk(i, data);
+    }
+}
+
+/*!
+ * Draw a resident chunk.
+ */
+static int draw_chunk(int i, int colored)
+{
+    const Chunk_node *n = &chunk_nodes[i];
+    const Chunk_slot *s = &chunk_slots[i];
+    const char *vertices = (const char*) s->data;
+    const char *indices = vertices + sizeof (Packed_vertex) * n->n_vertex;
+
+    if (n->n_indices == 0)
+        return 0;
+
+    if (s->buffer[0])
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, s->buffer[0]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->buffer[1]);
+        vertices = NULL;
+        indices = NULL;
+    }
+
+    glVertexPointer(3, GL_FLOAT, sizeof (Packed_vertex),
+            vertices + offsetof(Packed_vertex, position));
+    glNormalPointer(GL_BYTE, sizeof (Packed_vertex),
+            vertices + offsetof(Packed_vertex, normal));
+    if (colored)
+        glColorPointer(3, GL_UNSIGNED_BYTE, sizeof (Packed_vertex),
+                vertices + offsetof(Packed_vertex, color));
+    glDrawElements(GL_TRIANGLES, n->n_indices,
+            n->n_vertex <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+            indices);
+
+    return n->n_indices / 3;
+}
+
+/*!
+ * Check if the bounding sphere of a node intersects the view volume.
+ */
+static int chunk_visible(const Chunk_node *n, float planes[6][4])
+{
+    int p;
+
+    for (p = 0; p < 6; ++p)
+        if (planes[p][0] * n->center[0] + planes[p][1] * n->center[1]
+                + planes[p][2] * n->center[2] + planes[p][3] < -n->radius)
+            return 0;
+    return 1;
+}
+
+/*!
+ * Draw a visible, resident node, or its children if its error is visible
+ * and all of them are resident. Missing children are requested, as long as
+ * the chunks drawn in the last frame and the missing ones fit in the budget,
+ * and the node is drawn meanwhile.
+ */
+static int draw_node(int i, float planes[6][4], const float eye[3],
+        float scale, int height, int colored)
+{
+    const Chunk_node *n = &chunk_nodes[i];
+    float d[3], distance, pixels;
+    size_t missing = 0;
+    int c, k, count = 0, refine;
+
+    chunk_slots[i].last_used = chunk_frame;
+    chunk_drawn += chunk_size(n);
+
+    // projected error, as in choose_lod(void)
+    for (k = 0; k < 3; ++k)
+        d[k] = n->center[k] - eye[k];
+    distance = (sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) - n->radius)
+               * scale;
+    if (distance < 2.0f)
+        distance = 2.0f;
+    pixels = n->error * scale / distance * height;
+
+    refine = n->n_children && pixels > LOD_PIXEL_ERROR;
+    for (c = n->first_child; refine && c < n->first_child + n->n_children;
+            ++c)
+        if (chunk_visible(&chunk_nodes[c], planes)
+                && chunk_slots[c].state != CHUNK_RESIDENT)
+        {
+            if (chunk_slots[c].state == CHUNK_FAILED)
+                refine = 0;
+            missing += chunk_size(&chunk_nodes[c]);
+        }
+
+    if (refine && missing)
+    {
+        if (chunk_used + missing <= chunk_budget)
+            for (c = n->first_child; c < n->first_child + n->n_children; ++c)
+                if (chunk_visible(&chunk_nodes[c], planes)
+                        && chunk_slots[c].state != CHUNK_RESIDENT)
+                    request_chunk(c, pixels);
+        refine = 0;
+    }
+
+    if (!refine)
+        return draw_chunk(i, colored);
+
+    for (c = n->first_child; c < n->first_child + n->n_children; ++c)
+        if (chunk_visible(&chunk_nodes[c], planes))
+            count += draw_node(c, planes, eye, scale, height, colored);
+    return count;
+}
+#endif // defined(__APPLE__) || defined(__linux__)
+
+/*!
+ * Each frame, the chunks read meanwhile are uploaded, the hierarchy is
+ * traversed from the root, the queue of the loader thread is replaced
+ * with the chunks missing for this view, by decreasing projected error,
+ * and the chunks not needed are released if over budget.
+ */
+int draw_chunks(float planes[6][4], const float eye[3], float scale,
+        int height, int colored)
+{
+#if defined(__APPLE__) || defined(__linux__)
+    int count = 0;
+
+    chunk_frame++;
+    upload_chunks();
+
+    chunk_n_requests = 0;
+    chunk_drawn = 0;
+    if (chunk_slots[0].state == CHUNK_RESIDENT
+            && chunk_visible(chunk_nodes, planes))
+        count = draw_node(0, planes, eye, scale, height, colored);
+    chunk_used = chunk_drawn;
+
+    if (chunk_slots[0].buffer[0])
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    update_queue();
+    evict_chunks();
+
+    return count;
+#else // _WIN32
+    UNUSED(planes);
+    UNUSED(eye);
+    UNUSED(scale);
+    UNUSED(height);
+    UNUSED(colored);
+    return 0;
+#endif // defined(__APPLE__) || defined(__linux__)
+}
+
+int chunks_pending(void)
+{
+    return chunk_n_requests > 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file outofcore.h
+ * @author agent
+ * @date 2026-10-16
+ */
+
+/*! Extension of the chunked model files. */
+#define OOC_SUFFIX ".mvo"
+
+/*! Version of the chunked model format, to be increased on every change. */
+#define OOC_VERSION 1
+
+/*! Average number of faces targeted for each leaf chunk. */
+#define OOC_LEAF_FACES 32768
+
+/*! Maximum depth of the chunk hierarchy. */
+#define OOC_MAX_DEPTH 7
+
+/*! Cells per side of the grid used to simplify an inner chunk. */
+#define OOC_NODE_GRID 64
+
+/*! Default memory budget for the resident chunks, in MB. */
+#define OOC_BUDGET_MB 512
+
+/*! Maximum number of chunks waiting to be read or uploaded. */
+#define OOC_QUEUE 32
+
+/*!
+ * \brief State of a chunk in memory.
+ */
+typedef enum Chunk_state
+{
+    CHUNK_ABSENT = 0, /*!< Only on disk. */
+    CHUNK_QUEUED,     /*!< Requested, waiting for the loader thread. */
+    CHUNK_READING,    /*!< Being read by the loader thread. */
+    CHUNK_READ,       /*!< In host memory, waiting to be uploaded. */
+    CHUNK_RESIDENT,   /*!< Ready to be drawn. */
+    CHUNK_FAILED      /*!< Not readable, never requested again. */
+} Chunk_state;
+
+/*!
+ * Type for the header of a chunked model file.
+ */
+typedef struct Chunk_header Chunk_header;
+
+/*!
+ * Structure defining the header of a chunked model file. The header is
+ * followed by the table of the nodes of the hierarchy (see Chunk_node),
+ * then by the data of each chunk. Like the cache, the file is valid only
+ * for hosts with the same byte order and type sizes.
+ */
+struct Chunk_header
+{
+    char magic[8];             /*!< File signature. */
+    int version;               /*!< Format version, i.e. `OOC_VERSION`. */
+    int byte_order;            /*!< Constant used to check the byte order. */
+    int n_nodes;               /*!< Number of nodes of the hierarchy. */
+    int n_vertex;              /*!< Number of vertices of the source model. */
+    int n_faces;               /*!< Number of triangles of the source model. */
+    int is_colored;            /*!< Nonzero if the model has color. */
+    float max_coord[3];        /*!< Maximum coordinates of the vertices. */
+    float min_coord[3];        /*!< Minimum coordinates of the vertices. */
+};
+
+/*!
+ * Type for a node of the chunk hierarchy.
+ */
+typedef struct Chunk_node Chunk_node;
+
+/*!
+ * Structure defining a node of the chunk hierarchy, i.e. a cell of an
+ * octree over the bounding box of the model. Leaves hold the triangles
+ * whose centroid falls in their cell, inner nodes a simplified version of
+ * the union of their children. Nodes are sorted by level, root first, and
+ * the children of a node are consecutive.
+ *
+ * The data of a chunk are its packed vertices, followed by its indices,
+ * 16 bit wide when the chunk has at most 65536 vertices.
+ */
+struct Chunk_node
+{
+    float center[3];  /*!< Center of the bounding sphere. */
+    float radius;     /*!< Radius of the bounding sphere. */
+    float error;      /*!< Maximum displacement of the vertices. */
+    int first_child;  /*!< Index of the first child. */
+    int n_children;   /*!< Number of children. */
+    int n_vertex;     /*!< Number of vertices of the chunk. */
+    int n_indices;    /*!< Number of indices of the chunk. */
+    long long offset; /*!< Position of the chunk data in the file. */
+};
+
+/*!
+ * Type for the memory state of a chunk.
+ */
+typedef struct Chunk_slot Chunk_slot;
+
+/*!
+ * Structure holding the memory state of a chunk while drawing.
+ */
+struct Chunk_slot
+{
+    Chunk_state state; /*!< State of the chunk. */
+    int last_used;     /*!< Last frame in which the chunk was needed. */
+    void *data;        /*!< Chunk data, while in host memory. */
+    GLuint buffer[2];  /*!< Vertex and index buffer objects, if used. */
+};
+
+/*!
+ * Type for a sequential reader of a .ply file.
+ */
+typedef struct Chunk_source Chunk_source;
+
+/*!
+ * Structure defining a sequential reader of the vertices and faces of a
+ * .ply file, reading one record at a time, so that models of any size can
+ * be read with constant memory.
+ */
+struct Chunk_source
+{
+    FILE *file;            /*!< Input file. */
+    Ply_header header;     /*!< Declarations of the header. */
+    Text_reader reader;    /*!< Buffered reader of the body. */
+};
+
+/*!
+ * \brief Convert a .ply model into a hierarchy of chunks on disk.
+ * @param source Name of the .ply file.
+ * @param target Name of the chunked model file.
+ * @return 0 on success, -1 on failure.
+ */
+int build_chunks(const char *source, const char *target);
+
+/*!
+ * \brief Open a chunked model and start the thread reading its chunks.
+ * @param filename Name of the chunked model file.
+ * @param h Header of the file.
+ * @return 0 on success, -1 if the file is not a valid chunked model.
+ */
+int open_chunks(const char *filename, Chunk_header *h);
+
+/*!
+ * \brief Close the chunked model, releasing all of its chunks.
+ * @note It needs a current OpenGL context if chunks were uploaded.
+ */
+void close_chunks(void);
+
+/*!
+ * \brief Set the memory budget for the resident chunks.
+ * @param bytes Budget, in bytes.
+ */
+void set_chunk_budget(size_t bytes);
+
+/*!
+ * \brief Draw the chunks needed for the current view, and request the
+ * missing ones.
+ * @param planes Frustum planes, in model coordinates.
+ * @param eye Eye position, in model coordinates.
+ * @param scale Scale from model to world coordinates.
+ * @param height Viewport height, in pixels.
+ * @param colored Nonzero to draw the chunks with their color.
+ * @return Number of triangles drawn.
+ * @note The vertex, normal and (if needed) color arrays must be enabled.
+ */
+int draw_chunks(float planes[6][4], const float eye[3], float scale,
+        int height, int colored);
+
+/*!
+ * \brief Check if some chunk needed for the last frame is still missing.
+ * @return Nonzero if the view will improve when the chunks arrive.
+ */
+int chunks_pending(void);
@@ -0,0 +1,371 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file profiler.c
+ * @author agent
+ * @date 2026-10-16
+ *
+ * Frame profiler: each frame is split in phases (see Profile_phase), timed
+ * on the CPU and, when timer queries are available, on the GPU. Timings
+ * are summarized in an overlay and can be written to a CSV trace file,
+ * together with the time spent in each loading phase.
+ *
+ * GPU timestamps are read back some frames later, cycling on
+ * `PROFILE_QUERY_FRAMES` records, so that the profiler does not stall the
+ * pipeline waiting for the GPU.
+ */
+
+#include "components.h"
+#include "profiler.h"
+
+#include <time.h>
+#if defined(__APPLE__)
+    #include <sys/time.h>
+#endif // defined(__APPLE__)
+
+int overlay_enabled = 0;  //!< Nonzero when the overlay is shown.
+FILE *trace_file = NULL;  //!< CSV file for the per-frame timings, if any.
+double trace_start = 0;   //!< Time of the trace file opening, in ms.
+int gpu_timer = -1;       /*!< Nonzero if timestamp queries are available,
+                               negative while not checked yet. */
+int profiled_frames = 0;  //!< Number of frames profiled.
+Frame_profile *current_frame = NULL; //!< Frame being timed, if any.
+
+//! Records of the last frames, waiting for their GPU timings.
+Frame_profile profile_frames[PROFILE_QUERY_FRAMES];
+
+const char *load_phase_name[MAX_LOAD_PHASES]; //!< Names of loading phases.
+double load_phase_time[MAX_LOAD_PHASES];      //!< Loading phase times (ms).
+int n_load_phases = 0;    //!< Number of loading phases recorded.
+
+//! Statistics shown by the overlay, averaged over the last time window.
+struct
+{
+    double start;     //!< Start time of the current window, in ms.
+    int frames;       //!< Frames completed in the current window.
+    double cpu;       //!< Total CPU time in the current window, in ms.
+    double gpu;       //!< Total GPU time in the current window, in ms.
+    double triangles; //!< Triangles drawn in the current window.
+    double fps;       //!< Frames per second in the last window.
+    double cpu_ms;    //!< Average CPU time per frame in the last window.
+    double gpu_ms;    //!< Average GPU time per frame in the last window.
+    double tris_s;    //!< Triangles per second in the last window.
+} overlay_stats;
+
+/*!
+ * A monotonic clock is used on Linux, the wall clock (with microsecond
+ * resolution) on Mac OS X and the process clock elsewhere.
+ */
+double profile_now(void)
+{
+    #if defined(__linux__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+    #elif defined(__APPLE__)
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1e3 + tv.tv_usec * 1e-3;
+    #else // _WIN32
+    return (double) clock() * 1e3 / CLOCKS_PER_SEC;
+    #endif // defined(__linux__)
+}
+
+/*!
+ * The phases are recorded in order, and printed by profile_report_load(void)
+ * when the loading is over. Phases exceeding `MAX_LOAD_PHASES` are ignored.
+ */
+void profile_load_phase(const char *name, double ms)
+{
+    if (n_load_phases == MAX_LOAD_PHASES)
+        return;
+
+    load_phase_name[n_load_phases] = name;
+    load_phase_time[n_load_phases] = ms;
+    n_load_phases++;
+}
+
+/*!
+ * Print the loading phases on a single line, and write them as comment
+ * lines at the beginning of the trace file, if any. The phases are then
+ * cleared, so that a reloaded model is reported on its own.
+ */
+void profile_report_load(void)
+{
+    int i;
+    double total = 0;
+
+    printf("Loading time:");
+    for (i = 0; i < n_load_phases; i++)
+    {
+        printf(" %s %.1f ms,", load_phase_name[i], load_phase_time[i]);
+        total += load_phase_time[i];
+        if (trace_file)
+            fprintf(trace_file, "# %s_ms,%.3f\n",
+                    load_phase_name[i], load_phase_time[i]);
+    }
+    printf(" total %.1f ms.\n", total);
+    n_load_phases = 0;
+}
+
+/*!
+ * The trace file has a header line, followed by a line for each profiled
+ * frame, with its start time (since the opening of the file), the number of
+ * triangles drawn, the total CPU time and the CPU and GPU time of each
+ * phase (GPU times are zero when timer queries are not supported). All the
+ * times are in ms.
+ */
+int profile_open_trace(const char *filename)
+{
+    trace_file = fopen(filename, "w");
+    if (trace_file == NULL)
+    {
+        printf("Unable to open the file %s.\n", filename);
+        return -1;
+    }
+    trace_start = profile_now();
+
+    fprintf(trace_file,
+            "frame,start_ms,triangles,cpu_ms,"
+            "cpu_clear_ms,cpu_draw_ms,cpu_swap_ms,"
+            "gpu_clear_ms,gpu_draw_ms,gpu_swap_ms\n");
+    return 0;
+}
+
+/*!
+ * Read the GPU timings of a frame, waiting for them if needed, then add
+ * the frame to the overlay statistics and to the trace.
+ */
+static void complete_frame(Frame_profile *f)
+{
+    int i;
+
+    if (f->pending)
+    {
+        #ifdef GL_TIMESTAMP
+        GLuint64 t[PROF_PHASES + 1];
+        for (i = 0; i <= PROF_PHASES; i++)
+            glGetQueryObjectui64v(f->query[i], GL_QUERY_RESULT, &t[i]);
+        for (i = 0; i < PROF_PHASES; i++)
+            f->gpu[i] = (t[i + 1] - t[i]) * 1e-6;
+        #endif // GL_TIMESTAMP
+        f->pending = 0;
+    }
+
+    overlay_stats.frames++;
+    overlay_stats.cpu += f->total;
+    overlay_stats.triangles += f->triangles;
+    for (i = 0; i < PROF_PHASES; i++)
+        overlay_stats.gpu += f->gpu[i];
+
+    if (trace_file)
+        fprintf(trace_file, "%d,%.3f,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                f->frame,
+                f->start - trace_start,
+                f->triangles,
+                f->total,
+                f->cpu[PROF_CLEAR],
+                f->cpu[PROF_DRAW],
+                f->cpu[PROF_SWAP],
+                f->gpu[PROF_CLEAR],
+                f->gpu[PROF_DRAW],
+                f->gpu[PROF_SWAP]);
+}
+
+/*!
+ * Frames still waiting for their GPU timings are completed before closing
+ * the file, so that the trace is complete.
+ */
+void profile_close_trace(void)
+{
+    int i;
+
+    // oldest frame first
+    for (i = 0; i < PROFILE_QUERY_FRAMES; i++)
+    {
+        Frame_profile *f =
+                &profile_frames[(profiled_frames + i) % PROFILE_QUERY_FRAMES];
+        if (f->pending)
+            complete_frame(f);
+    }
+
+    if (trace_file)
+        fclose(trace_file);
+    trace_file = NULL;
+}
+
+/*!
+ * Profiling is active only while the overlay is shown or a trace is
+ * written. The record used for this frame is the oldest one, whose GPU
+ * timings are read first, if still pending.
+ */
+void profile_begin_frame(void)
+{
+    int i;
+    Frame_profile *f =
+            &profile_frames[profiled_frames % PROFILE_QUERY_FRAMES];
+
+    if (!overlay_enabled && trace_file == NULL)
+        return;
+
+    // check timer queries support, on first use
+    if (gpu_timer < 0)
+    {
+        GLint bits = 0;
+        #ifdef GL_TIMESTAMP
+        glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+        if (bits)
+            for (i = 0; i < PROFILE_QUERY_FRAMES; i++)
+                glGenQueries(PROF_PHASES + 1, profile_frames[i].query);
+        #endif // GL_TIMESTAMP
+        gpu_timer = bits > 0;
+        while (glGetError() != GL_NO_ERROR) {} // ignore unsupported queries
+    }
+
+    if (f->pending)
+        complete_frame(f);
+
+    f->frame = profiled_frames;
+    f->start = f->last = profile_now();
+    for (i = 0; i < PROF_PHASES; i++)
+        f->cpu[i] = f->gpu[i] = 0;
+
+    #ifdef GL_TIMESTAMP
+    if (gpu_timer)
+        glQueryCounter(f->query[0], GL_TIMESTAMP);
+    #endif // GL_TIMESTAMP
+
+    current_frame = f;
+}
+
+/*!
+ * The time of each phase is measured from the previous mark (or from the
+ * frame start), so a skipped mark is counted in the next phase.
+ */
+void profile_mark(Profile_phase phase)
+{
+    double now;
+
+    if (current_frame == NULL)
+        return;
+
+    now = profile_now();
+    current_frame->cpu[phase] = now - current_frame->last;
+    current_frame->last = now;
+
+    #ifdef GL_TIMESTAMP
+    if (gpu_timer)
+        glQueryCounter(current_frame->query[phase + 1], GL_TIMESTAMP);
+    #endif // GL_TIMESTAMP
+}
+
+/*!
+ * When the time window is over, the overlay statistics are updated.
+ */
+void profile_end_frame(int triangles)
+{
+    Frame_profile *f = current_frame;
+    double now = profile_now();
+
+    if (f == NULL)
+        return;
+
+    f->total = now - f->start;
+    f->triangles = triangles;
+    f->pending = 1;
+    if (!gpu_timer)
+        complete_frame(f);
+    current_frame = NULL;
+    profiled_frames++;
+
+    if (overlay_stats.frames
+            && now - overlay_stats.start >= PROFILE_REFRESH)
+    {
+        double elapsed = now - overlay_stats.start;
+        overlay_stats.fps = overlay_stats.frames * 1e3 / elapsed;
+        overlay_stats.cpu_ms = overlay_stats.cpu / overlay_stats.frames;
+        overlay_stats.gpu_ms = overlay_stats.gpu / overlay_stats.frames;
+        overlay_stats.tris_s = overlay_stats.triangles * 1e3 / elapsed;
+        overlay_stats.frames = 0;
+        overlay_stats.cpu = overlay_stats.gpu = overlay_stats.triangles = 0;
+        overlay_stats.start = now;
+    }
+}
+
+/*!
+ * The statistics restart from scratch each time the overlay is shown.
+ */
+void toggle_overlay(void)
+{
+    overlay_enabled = !overlay_enabled;
+    memset(&overlay_stats, 0, sizeof (overlay_stats));
+    overlay_stats.start = profile_now();
+}
+
+/*!
+ * Write a line of text at the given position, in normalized device
+ * coordinates.
+ */
+static void overlay_text(float x, float y, const char *text)
+{
+    glRasterPos2f(x, y);
+    for (; *text; ++text)
+        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *text);
+}
+
+/*!
+ * The overlay shows, in the top left corner of the viewport, the frame
+ * rate, the CPU and GPU time per frame and the triangle throughput,
+ * averaged over the last `PROFILE_REFRESH` ms.
+ */
+void draw_overlay(void)
+{
+    char text[STR_LEN + 1];
+
+    if (!overlay_enabled)
+        return;
+
+    // draw in normalized device coordinates
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glColor3f(1.0f, 1.0f, 0.0f);
+    sprintf(text, "%.1f fps", overlay_stats.fps);
+    overlay_text(-0.98f, 0.94f, text);
+    if (gpu_timer > 0)
+        sprintf(text, "%.2f ms/frame CPU, %.2f ms/frame GPU",
+                overlay_stats.cpu_ms, overlay_stats.gpu_ms);
+    else
+        sprintf(text, "%.2f ms/frame CPU", overlay_stats.cpu_ms);
+    overlay_text(-0.98f, 0.90f, text);
+    sprintf(text, "%.3g triangles/s", overlay_stats.tris_s);
+    overlay_text(-0.98f, 0.86f, text);
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
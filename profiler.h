@@ -0,0 +1,116 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file profiler.h
+ * @author agent
+ * @date 2026-10-16
+ */
+
+/*! Number of frames whose GPU timer queries may be pending at once. */
+#define PROFILE_QUERY_FRAMES 4
+
+/*! Time (in ms) between two updates of the overlay statistics. */
+#define PROFILE_REFRESH 500
+
+/*! Maximum number of loading phases recorded. */
+#define MAX_LOAD_PHASES 8
+
+/*!
+ * \brief Phases of a frame, each one timed from the end of the previous.
+ */
+typedef enum
+{
+    PROF_CLEAR = 0, /*!< Framebuffer clear. */
+    PROF_DRAW,      /*!< Camera setup and model drawing. */
+    PROF_SWAP,      /*!< Overlay drawing and buffer swap. */
+    PROF_PHASES     /*!< Number of phases. */
+} Profile_phase;
+
+/*!
+ * \brief Timings of a single frame.
+ */
+typedef struct
+{
+    int frame;                 /*!< Frame number. */
+    double start;              /*!< Start time, in ms. */
+    double last;               /*!< Time of the last phase mark, in ms. */
+    double total;              /*!< CPU time for the whole frame, in ms. */
+    double cpu[PROF_PHASES];   /*!< CPU time for each phase, in ms. */
+    double gpu[PROF_PHASES];   /*!< GPU time for each phase, in ms. */
+    int triangles;             /*!< Number of triangles drawn. */
+    int pending;               /*!< Nonzero while waiting for GPU times. */
+    GLuint query[PROF_PHASES + 1]; /*!< Timestamp queries. */
+} Frame_profile;
+
+/*!
+ * \brief Get the current time.
+ * @return Time in ms from an arbitrary fixed point.
+ */
+double profile_now(void);
+
+/*!
+ * \brief Record the time spent in a loading phase.
+ * @param name Name of the phase.
+ * @param ms Time spent, in ms.
+ */
+void profile_load_phase(const char *name, double ms);
+
+/*!
+ * \brief Report the loading phases on stdout and in the trace file.
+ */
+void profile_report_load(void);
+
+/*!
+ * \brief Open a CSV file for the per-frame timings.
+ * @param filename Name of the file.
+ * @return 0 on success, -1 on failure.
+ */
+int profile_open_trace(const char *filename);
+
+/*!
+ * \brief Complete the pending frames and close the trace file.
+ * @note It needs the OpenGL context used for profiling to be current.
+ */
+void profile_close_trace(void);
+
+/*!
+ * \brief Start timing a frame, if profiling is active.
+ */
+void profile_begin_frame(void);
+
+/*!
+ * \brief Mark the end of a frame phase.
+ * @param phase The phase just completed.
+ */
+void profile_mark(Profile_phase phase);
+
+/*!
+ * \brief Stop timing the current frame.
+ * @param triangles Number of triangles drawn in the frame.
+ */
+void profile_end_frame(int triangles);
+
+/*!
+ * \brief Show or hide the profiler overlay.
+ */
+void toggle_overlay(void);
+
+/*!
+ * \brief Draw the profiler overlay, if enabled.
+ */
+void draw_overlay(void);
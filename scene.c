@@ -0,0 +1,666 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file scene.c
+ * @author agent
+ * @date 2026-10-16
+ *
+ * Scenes: a text file places several models, each loaded and processed
+ * once, in a common frame through any number of instances. A scene file
+ * holds one command per line (`#` starts a comment):
+ *
+ *     model name file.ply     load a model, relative to the scene file
+ *     translate x y z         move the next instances
+ *     rotate degrees x y z    rotate the next instances around an axis
+ *     scale s                 scale uniformly the next instances
+ *     push                    save the current transformation
+ *     pop                     restore the last saved transformation
+ *     instance name           place a model with the current transformation
+ *
+ * Without shaders the fixed function pipeline cannot draw instances in a
+ * single call, so the instances of small models, for which the calls
+ * would cost more than the triangles, are copied with their transformation
+ * into two batches (with and without color) drawn with one call each. The
+ * larger models are bound once and drawn for each instance, with their
+ * transformation on the modelview matrix, keeping their levels of detail
+ * and clusters.
+ */
+
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <stddef.h>
+#include "components.h"
+#include "scene.h"
+#include "outofcore.h"
+#include "watch.h"
+
+Scene loading; //!< Scene being loaded, until it is published.
+Scene shown;   //!< Scene drawn by display(void), if any.
+
+/*!
+ * Set a matrix to the identity.
+ */
+static void matrix_identity(float m[16])
+{
+    int i;
+
+    for (i = 0; i < 16; ++i)
+        m[i] = i % 5 ? 0.0f : 1.0f;
+}
+
+/*!
+ * Multiply a matrix on the right by another one, i.e. m = m * t, as
+ * glMultMatrixf() does. Both are in column-major order.
+ */
+static void matrix_multiply(float m[16], const float t[16])
+{
+    float r[16];
+    int i, j, k;
+
+    for (i = 0; i < 4; ++i)
+        for (j = 0; j < 4; ++j)
+        {
+            r[j * 4 + i] = 0;
+            for (k = 0; k < 4; ++k)
+                r[j * 4 + i] += m[k * 4 + i] * t[j * 4 + k];
+        }
+
+    memcpy(m, r, sizeof r);
+}
+
+/*!
+ * Build the rotation of the given angle (in degrees) around an axis, as
+ * glRotatef() does.
+ */
+static int matrix_rotation(float m[16], float degrees, const float axis[3])
+{
+    float length = sqrt(axis[0] * axis[0] + axis[1] * axis[1]
+                        + axis[2] * axis[2]);
+    float x, y, z, c, s;
+
+    if (length == 0)
+        return -1;
+
+    x = axis[0] / length;
+    y = axis[1] / length;
+    z = axis[2] / length;
+    c = cos(degrees * M_PI / 180);
+    s = sin(degrees * M_PI / 180);
+
+    matrix_identity(m);
+    m[0] = x * x * (1 - c) + c;
+    m[1] = y * x * (1 - c) + z * s;
+    m[2] = x * z * (1 - c) - y * s;
+    m[4] = x * y * (1 - c) - z * s;
+    m[5] = y * y * (1 - c) + c;
+    m[6] = y * z * (1 - c) + x * s;
+    m[8] = x * z * (1 - c) + y * s;
+    m[9] = y * z * (1 - c) - x * s;
+    m[10] = z * z * (1 - c) + c;
+
+    return 0;
+}
+
+/*!
+ * Transform a point (w = 1) or a direction (w = 0).
+ */
+static void matrix_apply(const float m[16], const float v[3], float w,
+        float out[3])
+{
+    int i;
+
+    for (i = 0; i < 3; ++i)
+        out[i] = m[i] * v[0] + m[4 + i] * v[1] + m[8 + i] * v[2]
+                 + m[12 + i] * w;
+}
+
+/*!
+ * Order the instances by model, so that each model is bound once.
+ */
+static int compare_instances(const void *a, const void *b)
+{
+    return ((const Scene_instance*) a)->model
+           - ((const Scene_instance*) b)->model;
+}
+
+/*!
+ * Return the index of the model with the given name, or -1.
+ */
+static int find_model(const char *name)
+{
+    int i;
+
+    for (i = 0; i < loading.n_models; ++i)
+        if (!strcmp(loading.models[i].name, name))
+            return i;
+
+    return -1;
+}
+
+/*!
+ * Load a model of the scene, whose file name is relative to the directory
+ * of the scene file, and store it.
+ */
+static int add_model(const char *scene_file, const char *name,
+        const char *file, char *path)
+{
+    char filename[STR_LEN + 1];
+    const char *slash = strrchr(scene_file, '/');
+    size_t dir = slash && file[0] != '/' ? (size_t) (slash - scene_file + 1)
+                                         : 0;
+    Scene_model *m;
+
+    if (loading.n_models == SCENE_MAX_MODELS)
+    {
+        printf("Too many models in the scene (maximum %d).\n",
+                SCENE_MAX_MODELS);
+        return -1;
+    }
+    if (find_model(name) >= 0)
+    {
+        printf("Model %s defined twice.\n", name);
+        return -1;
+    }
+    if (strlen(name) > STR_LEN || dir + strlen(file) > STR_LEN)
+    {
+        printf("Model name or file name too long: %s.\n", file);
+        return -1;
+    }
+
+    memcpy(filename, scene_file, dir);
+    strcpy(filename + dir, file);
+
+    // chunks and scenes need a state of their own
+    if (has_suffix(filename, OOC_SUFFIX) || has_suffix(filename, SCENE_SUFFIX))
+    {
+        printf("Chunked models and scenes cannot be part of a scene: %s.\n",
+                filename);
+        return -1;
+    }
+
+    if (open_model(filename, path))
+    {
+        printf("Unable to load the model %s.\n", filename);
+        release_model();
+        return -1;
+    }
+
+    m = &loading.models[loading.n_models++];
+    memset(m, 0, sizeof (*m));
+    strcpy(m->name, name);
+    strcpy(m->file, filename);
+    store_mesh(&m->mesh);
+
+    return 0;
+}
+
+/*!
+ * Append an instance of a model with the given transformation.
+ */
+static int add_instance(const char *name, const float matrix[16],
+        int *capacity)
+{
+    int model = find_model(name);
+    int line;
+
+    if (model < 0)
+    {
+        printf("Unknown model %s.\n", name);
+        return -1;
+    }
+
+    if (loading.n_instances == *capacity)
+    {
+        *capacity = *capacity ? 2 * *capacity : 64;
+        line = __LINE__ + 1;
+        loading.instances = (Scene_instance*) realloc(loading.instances,
+                sizeof (Scene_instance) * *capacity);
+        if (loading.instances == NULL)
+            error_handler("realloc", __func__, __FILE__, line);
+    }
+
+    loading.instances[loading.n_instances].model = model;
+    memcpy(loading.instances[loading.n_instances].matrix, matrix,
+            sizeof (float) * 16);
+    ++loading.n_instances;
+
+    return 0;
+}
+
+/*!
+ * Read the commands of a scene file, loading its models and placing their
+ * instances.
+ */
+static int read_scene(FILE *f, const char *filename, char *path)
+{
+    float stack[SCENE_STACK_DEPTH][16];
+    int depth = 0, capacity = 0, n_line = 0;
+    char line[SCENE_LINE_LEN];
+
+    matrix_identity(stack[0]);
+
+    while (fgets(line, sizeof line, f) != NULL)
+    {
+        const char *delim = " \t\r\n";
+        char *command, *args[4], *end;
+        float value[4], t[16];
+        int n_args, numeric, k;
+
+        ++n_line;
+        if ((end = strchr(line, '#')) != NULL)
+            *end = '\0';
+        if ((command = strtok(line, delim)) == NULL)
+            continue;
+        for (n_args = 0; n_args < 4; ++n_args)
+            if ((args[n_args] = strtok(NULL, delim)) == NULL)
+                break;
+
+        // numeric arguments, for the transformations
+        for (k = numeric = 0; k < n_args; ++k)
+        {
+            value[k] = (float) strtod(args[k], &end);
+            numeric += *end == '\0';
+        }
+        numeric = numeric == n_args;
+
+        if (!strcmp(command, "model") && n_args == 2)
+        {
+            if (add_model(filename, args[0], args[1], path))
+                return -1;
+        }
+        else if (!strcmp(command, "instance") && n_args == 1)
+        {
+            if (add_instance(args[0], stack[depth], &capacity))
+                return -1;
+        }
+        else if (!strcmp(command, "translate") && n_args == 3 && numeric)
+        {
+            matrix_identity(t);
+            memcpy(t + 12, value, sizeof (float) * 3);
+            matrix_multiply(stack[depth], t);
+        }
+        else if (!strcmp(command, "rotate") && n_args == 4 && numeric
+                 && !matrix_rotation(t, value[0], value + 1))
+            matrix_multiply(stack[depth], t);
+        else if (!strcmp(command, "scale") && n_args == 1 && numeric
+                 && value[0] > 0)
+        {
+            matrix_identity(t);
+            t[0] = t[5] = t[10] = value[0];
+            matrix_multiply(stack[depth], t);
+        }
+        else if (!strcmp(command, "push") && n_args == 0
+                 && depth + 1 < SCENE_STACK_DEPTH)
+        {
+            memcpy(stack[depth + 1], stack[depth], sizeof (stack[0]));
+            ++depth;
+        }
+        else if (!strcmp(command, "pop") && n_args == 0 && depth > 0)
+            --depth;
+        else
+        {
+            printf("%s, line %d: invalid command %s.\n",
+                    filename, n_line, command);
+            return -1;
+        }
+    }
+
+    if (loading.n_instances == 0)
+    {
+        printf("%s: the scene has no instances.\n", filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+ * Copy the instances of a model, transformed, into a batch. The vertices
+ * are packed, the indices are taken from the finest level of detail.
+ */
+static void bake_model(Scene_model *m, Mesh *batch)
+{
+    Packed_vertex *packed = (Packed_vertex*) batch->vertexp;
+    int count, i, j;
+
+    select_mesh(&m->mesh);
+    count = m->mesh.n_lod ? m->mesh.lod[0].count : m->mesh.n_faces * 3;
+
+    for (j = m->first_instance; j < m->first_instance + m->n_instances; ++j)
+    {
+        const float *matrix = loading.instances[j].matrix;
+
+        for (i = 0; i < m->mesh.n_vertex; ++i)
+        {
+            float v[3], n[3], c[3], tv[3], tn[3];
+
+            get_vertex(i, v, n, c);
+            matrix_apply(matrix, v, 1, tv);
+            matrix_apply(matrix, n, 0, tn);
+            pack_vertex(&packed[batch->n_vertex + i], tv, tn,
+                    m->mesh.is_colored ? c : NULL);
+        }
+
+        for (i = 0; i < count; ++i)
+            batch->indices[batch->n_faces * 3 + i] =
+                batch->n_vertex + get_index(i);
+
+        batch->n_vertex += m->mesh.n_vertex;
+        batch->n_faces += count / 3;
+    }
+
+    // leave the model globals empty
+    store_mesh(&m->mesh);
+}
+
+/*!
+ * The small models are copied into the batch of their kind (with or
+ * without color) for each of their instances. Each batch is a mesh in
+ * packed format, without levels of detail nor clusters, since it is
+ * made of unrelated pieces.
+ */
+static void build_batches(void)
+{
+    size_t n_vertex[2] = {0, 0}, n_indices[2] = {0, 0}, v_size;
+    int i, k, line;
+
+    for (i = 0; i < loading.n_models; ++i)
+    {
+        Scene_model *m = &loading.models[i];
+        size_t count = m->mesh.n_lod ? (size_t) m->mesh.lod[0].count
+                                     : (size_t) m->mesh.n_faces * 3;
+        k = m->mesh.is_colored != 0;
+
+        m->batched = m->n_instances > 0
+                && m->mesh.n_vertex <= SCENE_BATCH_VERTICES
+                && n_vertex[k] + (size_t) m->mesh.n_vertex * m->n_instances
+                   <= INT_MAX / 2
+                && n_indices[k] + count * m->n_instances <= INT_MAX / 2;
+        if (!m->batched)
+            continue;
+
+        n_vertex[k] += (size_t) m->mesh.n_vertex * m->n_instances;
+        n_indices[k] += count * m->n_instances;
+    }
+
+    for (k = 0; k < 2; ++k)
+    {
+        Mesh *batch = &loading.batches[k];
+        Packed_vertex *packed;
+
+        memset(batch, 0, sizeof (*batch));
+        if (n_vertex[k] == 0)
+            continue;
+
+        // packed vertices and indices in a single arena
+        v_size = (sizeof (Packed_vertex) * n_vertex[k] + ARENA_ALIGN - 1)
+                 / ARENA_ALIGN * ARENA_ALIGN;
+        batch->arena_size = v_size + sizeof (GLuint) * n_indices[k];
+        line = __LINE__ + 1;
+        batch->arena = malloc(batch->arena_size);
+        if (batch->arena == NULL)
+            error_handler("malloc", __func__, __FILE__, line);
+        packed = (Packed_vertex*) batch->arena;
+        batch->indices = (GLuint*) ((char*) batch->arena + v_size);
+
+        batch->vertexp = packed[0].position;
+        batch->normals = (GLfloat*) ((char*) packed
+                                     + offsetof(Packed_vertex, normal));
+        batch->color = (GLfloat*) ((char*) packed
+                                   + offsetof(Packed_vertex, color));
+        batch->is_colored = k;
+        batch->vertex_stride = sizeof (Packed_vertex);
+        batch->normal_type = GL_BYTE;
+        batch->color_type = GL_UNSIGNED_BYTE;
+        batch->element_type = GL_UNSIGNED_INT;
+    }
+
+    for (i = 0; i < loading.n_models; ++i)
+        if (loading.models[i].batched)
+            bake_model(&loading.models[i],
+                    &loading.batches[loading.models[i].mesh.is_colored != 0]);
+}
+
+/*!
+ * The scene summary takes the place of a single model when the scene is
+ * shown: its counts are the ones of all the instances, it is colored if
+ * any model is, and its bounding box contains all the instances, so that
+ * frame_model(const Mesh*) centers the whole scene.
+ */
+static void summarize_scene(void)
+{
+    int i, j, k;
+
+    memset(&loading.summary, 0, sizeof (loading.summary));
+    loading.summary.normal_type = GL_FLOAT;
+    loading.summary.color_type = GL_FLOAT;
+    loading.summary.element_type = GL_UNSIGNED_INT;
+    for (k = 0; k < 3; ++k)
+    {
+        loading.summary.max_coord[k] = -FLT_MAX;
+        loading.summary.min_coord[k] = FLT_MAX;
+    }
+
+    for (i = 0; i < loading.n_instances; ++i)
+    {
+        const Mesh *m = &loading.models[loading.instances[i].model].mesh;
+
+        loading.summary.n_vertex += m->n_vertex;
+        loading.summary.n_faces += m->n_faces;
+        loading.summary.is_colored |= m->is_colored;
+
+        // transformed corners of the bounding box of the model
+        for (j = 0; j < 8; ++j)
+        {
+            float corner[3], p[3];
+
+            for (k = 0; k < 3; ++k)
+                corner[k] = j & (1 << k) ? m->max_coord[k] : m->min_coord[k];
+            matrix_apply(loading.instances[i].matrix, corner, 1, p);
+            for (k = 0; k < 3; ++k)
+            {
+                if (p[k] > loading.summary.max_coord[k])
+                    loading.summary.max_coord[k] = p[k];
+                if (p[k] < loading.summary.min_coord[k])
+                    loading.summary.min_coord[k] = p[k];
+            }
+        }
+    }
+}
+
+/*!
+ * Each model is opened with open_model(char*, char*), so it is processed
+ * and cached as a single model would be, then moved into the scene with
+ * store_mesh(Mesh*). Instances are sorted by model, the small models are
+ * baked into batches and the scene is summarized as a whole. On failure,
+ * the models loaded so far are released.
+ */
+int load_scene(const char *filename, char *path)
+{
+    FILE *f = fopen(filename, "r");
+    int i, line;
+
+    if (f == NULL)
+    {
+        printf("Unable to open the scene file %s.\n", filename);
+        return -1;
+    }
+
+    release_scene();
+    if (loading.models == NULL)
+    {
+        line = __LINE__ + 1;
+        loading.models = (Scene_model*) malloc(
+                sizeof (Scene_model) * SCENE_MAX_MODELS);
+        if (loading.models == NULL)
+            error_handler("malloc", __func__, __FILE__, line);
+    }
+
+    if (read_scene(f, filename, path))
+    {
+        fclose(f);
+        release_scene();
+        return -1;
+    }
+    fclose(f);
+
+    qsort(loading.instances, loading.n_instances, sizeof (Scene_instance),
+            compare_instances);
+    for (i = loading.n_instances - 1; i >= 0; --i)
+    {
+        Scene_model *m = &loading.models[loading.instances[i].model];
+        m->first_instance = i;
+        ++m->n_instances;
+    }
+
+    build_batches();
+    summarize_scene();
+
+    printf("Scene: %d models, %d instances, %d triangles.\n",
+            loading.n_models, loading.n_instances, loading.summary.n_faces);
+
+    loading.loaded = 1;
+    return 0;
+}
+
+/*!
+ * Each model and batch is released with release_mesh(Mesh*), then the
+ * instances and the models table.
+ */
+static void free_scene(Scene *s)
+{
+    int i;
+
+    for (i = 0; i < s->n_models; ++i)
+        release_mesh(&s->models[i].mesh);
+    for (i = 0; i < 2; ++i)
+        release_mesh(&s->batches[i]);
+
+    free(s->models);
+    free(s->instances);
+    memset(s, 0, sizeof (*s));
+}
+
+void release_scene(void)
+{
+    free_scene(&loading);
+}
+
+int scene_loaded(void)
+{
+    return loading.loaded;
+}
+
+int scene_active(void)
+{
+    return shown.loaded;
+}
+
+/*!
+ * The batched models are not uploaded, since they are drawn only through
+ * their batch.
+ */
+void upload_scene(void)
+{
+    int i;
+
+    for (i = 0; i < loading.n_models; ++i)
+        if (!loading.models[i].batched && loading.models[i].n_instances)
+        {
+            select_mesh(&loading.models[i].mesh);
+            upload_model();
+            store_mesh(&loading.models[i].mesh);
+        }
+
+    for (i = 0; i < 2; ++i)
+        if (loading.batches[i].n_faces)
+        {
+            select_mesh(&loading.batches[i]);
+            upload_model();
+            store_mesh(&loading.batches[i]);
+        }
+}
+
+/*!
+ * The scene loaded moves to the scene shown, leaving no scene loaded. When
+ * a single model is published, the scene shown is just released.
+ */
+void publish_scene(Mesh *summary)
+{
+    free_scene(&shown);
+    if (!loading.loaded)
+        return;
+
+    shown = loading;
+    memset(&loading, 0, sizeof (loading));
+    *summary = shown.summary;
+}
+
+/*!
+ * Each model not in a batch is bound once, and drawn for each of its
+ * instances with the instance transformation on the modelview matrix. Its
+ * level of detail is chosen once for all the instances, on the distance of
+ * the scene. Then each batch is drawn with a single call.
+ */
+int draw_instances(void)
+{
+    int i, j, l, triangles = 0;
+
+    for (i = 0; i < shown.n_models; ++i)
+    {
+        const Scene_model *m = &shown.models[i];
+
+        if (m->batched || m->n_instances == 0)
+            continue;
+
+        bind_model(&m->mesh);
+        l = choose_lod(&m->mesh);
+        for (j = m->first_instance; j < m->first_instance + m->n_instances;
+                ++j)
+        {
+            glPushMatrix();
+            glMultMatrixf(shown.instances[j].matrix);
+            triangles += draw_model(&m->mesh, l);
+            glPopMatrix();
+        }
+        unbind_model(&m->mesh);
+    }
+
+    for (i = 0; i < 2; ++i)
+        if (shown.batches[i].n_faces)
+        {
+            bind_model(&shown.batches[i]);
+            triangles += draw_model(&shown.batches[i], 0);
+            unbind_model(&shown.batches[i]);
+        }
+
+    return triangles;
+}
+
+/*!
+ * Models not used by any instance are watched too, since their file is
+ * read anyway.
+ */
+void watch_scene(void)
+{
+    int i;
+
+    for (i = 0; i < shown.n_models; ++i)
+        watch_file(shown.models[i].file);
+}
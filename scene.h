@@ -0,0 +1,153 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file scene.h
+ * @author agent
+ * @date 2026-10-16
+ */
+
+/*! Extension of the scene files. */
+#define SCENE_SUFFIX ".scene"
+
+/*! Maximum number of models in a scene. */
+#define SCENE_MAX_MODELS 256
+
+/*! Maximum depth of the transformation stack of a scene file. */
+#define SCENE_STACK_DEPTH 32
+
+/*! Maximum length of a line of a scene file. */
+#define SCENE_LINE_LEN 512
+
+/*!
+ * Models with at most this number of vertices are copied, transformed,
+ * into a batch for each of their instances.
+ */
+#define SCENE_BATCH_VERTICES 8192
+
+/*!
+ * Type for a model of a scene.
+ */
+typedef struct Scene_model Scene_model;
+
+/*!
+ * Structure defining a model of a scene, loaded once and drawn for each of
+ * its instances.
+ */
+struct Scene_model
+{
+    char name[STR_LEN + 1]; /*!< Name given to the model in the scene. */
+    char file[STR_LEN + 1]; /*!< File of the model. */
+    Mesh mesh;              /*!< Processed model. */
+    int batched;            /*!< Nonzero if its instances are in a batch. */
+    int first_instance;     /*!< Position of its first instance. */
+    int n_instances;        /*!< Number of its instances. */
+};
+
+/*!
+ * Type for an instance of a model in a scene.
+ */
+typedef struct Scene_instance Scene_instance;
+
+/*!
+ * Structure defining an instance of a model, i.e. the model placed in the
+ * scene by a transformation made of rotations, translations and uniform
+ * scales.
+ */
+struct Scene_instance
+{
+    int model;        /*!< Index of the model. */
+    float matrix[16]; /*!< Transformation, in column-major order. */
+};
+
+/*!
+ * Type for a scene.
+ */
+typedef struct Scene Scene;
+
+/*!
+ * Structure holding a scene: its models, their instances and the batches
+ * of the small ones.
+ */
+struct Scene
+{
+    Scene_model *models;       /*!< Models of the scene. */
+    int n_models;              /*!< Number of models. */
+    Scene_instance *instances; /*!< Instances, sorted by model. */
+    int n_instances;           /*!< Number of instances. */
+    Mesh batches[2];           /*!< Instances of the small models, without
+                                    and with color. */
+    Mesh summary;              /*!< Whole scene, without arrays. */
+    int loaded;                /*!< Nonzero if the scene is loaded. */
+};
+
+/*!
+ * \brief Load a scene file and all of its models.
+ * @param filename Name of the scene file.
+ * @param path Executable path (i.e. argv[0]).
+ * @return 0 on success, -1 on failure.
+ * @note The scene is shown only after publish_scene(Mesh*), so that the
+ * scene shown meanwhile can still be drawn.
+ */
+int load_scene(const char *filename, char *path);
+
+/*!
+ * \brief Release all the models of the scene loaded and not published.
+ * @note It needs a current OpenGL context if the scene was uploaded.
+ */
+void release_scene(void);
+
+/*!
+ * \brief Check if a scene is loaded and not published yet.
+ * @return Nonzero if the model loaded last is a scene.
+ */
+int scene_loaded(void);
+
+/*!
+ * \brief Check if a scene is shown.
+ * @return Nonzero if the model drawn by display(void) is a scene.
+ */
+int scene_active(void);
+
+/*!
+ * \brief Upload the models and batches of the scene loaded into buffer
+ * objects, if supported.
+ * @note It needs a current OpenGL context.
+ */
+void upload_scene(void);
+
+/*!
+ * \brief Show the scene loaded, if any, in place of the scene shown,
+ * which is released.
+ * @param summary Set to the summary of the scene (number of vertices and
+ * faces of all the instances, color, bounding box, without arrays), if a
+ * scene was loaded.
+ * @note It needs a current OpenGL context.
+ */
+void publish_scene(Mesh *summary);
+
+/*!
+ * \brief Draw all the instances of the scene shown.
+ * @return Number of triangles drawn.
+ * @note The modelview matrix must map the scene into the view.
+ */
+int draw_instances(void);
+
+/*!
+ * \brief Watch for changes the model files of the scene shown.
+ */
+void watch_scene(void);
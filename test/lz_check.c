@@ -0,0 +1,135 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file lz_check.c
+ * @author agent
+ * @date 2026-10-16
+ *
+ * Round-trip checks of the LZ codec, run by <code>make check</code>. Each
+ * input is compressed and decompressed, the result must equal the input,
+ * decompressing into a buffer one byte too small must fail, and every
+ * truncation of the compressed data must be decoded within the bounds of
+ * the input and of the output.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../lz.h"
+
+/*! Size of the largest input checked. */
+#define CHECK_SIZE (3 * LZ_MAX_OFFSET)
+
+/*!
+ * Compress and decompress an input, returning the number of failed checks.
+ */
+static int round_trip(const char *name, const unsigned char *src,
+        size_t size)
+{
+    unsigned char *packed = (unsigned char*) malloc(lz_bound(size));
+    unsigned char *unpacked = (unsigned char*) malloc(size + 1);
+    size_t packed_size, i;
+    int failed = 0;
+
+    if (packed == NULL || unpacked == NULL)
+    {
+        printf("lz: %s: out of memory.\n", name);
+        free(packed);
+        free(unpacked);
+        return 1;
+    }
+
+    packed_size = lz_compress(src, size, packed);
+    if (packed_size > lz_bound(size))
+    {
+        printf("lz: %s: %lu bytes compressed to %lu, over the bound.\n",
+                name, (unsigned long) size, (unsigned long) packed_size);
+        failed++;
+    }
+
+    if (lz_decompress(packed, packed_size, unpacked, size + 1) != (long) size
+            || memcmp(src, unpacked, size))
+    {
+        printf("lz: %s: round trip failed.\n", name);
+        failed++;
+    }
+
+    if (size > 0 && lz_decompress(packed, packed_size, unpacked, size - 1)
+            != -1)
+    {
+        printf("lz: %s: overflow of the output not detected.\n", name);
+        failed++;
+    }
+
+    // truncated data must stay within the output, or be rejected
+    for (i = 0; i < packed_size; i += 1 + i / 64)
+    {
+        if (lz_decompress(packed, i, unpacked, size + 1) > (long) size)
+        {
+            printf("lz: %s: truncation at %lu decoded past the input.\n",
+                    name, (unsigned long) i);
+            failed++;
+            break;
+        }
+    }
+
+    printf("lz: %s: %lu -> %lu bytes, %s.\n", name, (unsigned long) size,
+            (unsigned long) packed_size, failed ? "failed" : "ok");
+
+    free(packed);
+    free(unpacked);
+    return failed;
+}
+
+int main(void)
+{
+    static unsigned char data[CHECK_SIZE];
+    const char *text = "The quick brown fox jumps over the lazy dog. ";
+    unsigned int seed = 12345;
+    size_t i;
+    int failed = 0;
+
+    failed += round_trip("empty", data, 0);
+
+    memset(data, 'a', CHECK_SIZE);
+    failed += round_trip("one byte", data, 1);
+    failed += round_trip("short", data, LZ_MIN_MATCH - 1);
+    failed += round_trip("run", data, CHECK_SIZE);
+
+    for (i = 0; i < CHECK_SIZE; ++i)
+        data[i] = text[i % strlen(text)];
+    failed += round_trip("text", data, CHECK_SIZE);
+
+    for (i = 0; i < CHECK_SIZE; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (unsigned char) (seed >> 16);
+    }
+    failed += round_trip("random", data, CHECK_SIZE);
+
+    // random blocks repeated beyond the maximum offset
+    memcpy(data + LZ_MAX_OFFSET + 1, data, LZ_MAX_OFFSET - 1);
+    failed += round_trip("far repeats", data, CHECK_SIZE);
+
+    // runs of zeros of varying length among random bytes
+    for (i = 0; i + 16 <= CHECK_SIZE; i += 16)
+        memset(data + i, 0, 4 + i % 12);
+    failed += round_trip("records", data, CHECK_SIZE);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
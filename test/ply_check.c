@@ -0,0 +1,348 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file ply_check.c
+ * @author agent
+ * @date 2026-10-16
+ *
+ * Decoding checks of the .ply loader, run by <code>make check</code> on
+ * each fixture in <code>test/ply</code>. The file is parsed as the viewer
+ * does, and a line of values summarizing the decoded model is printed, to
+ * be compared with <code>test/ply/expected.txt</code>: the vertex and face
+ * counts, the bounding box found by the loader, the sums of the positions
+ * and of the colors (in 8 bit levels, as packed models store them), the
+ * total area of the triangles and the volume they enclose. The sums do not
+ * depend on the order of vertices and triangles, while a wrong byte order,
+ * property mapping, color scale or polygon split changes at least one of
+ * them.
+ *
+ * With <code>--process</code> the model is also processed as the viewer
+ * does after loading it, which must not change the summary. With
+ * <code>--open</code> it is opened as the viewer does, i.e. from its cache
+ * when there is one, otherwise parsed, processed and cached; compressed
+ * containers made from a fixture must give the summary of the fixture,
+ * except for the sums depending on positions, which they quantize.
+ *
+ * A scene opened with <code>--open</code> holds no arrays, so only the
+ * counts and bounding box of all its instances are printed.
+ *
+ * With <code>--chunks file.mvo</code> a chunked model is read instead,
+ * giving the counts and bounding box from its header, and the area and
+ * volume of the triangles of its leaves, which together hold the full
+ * model; the other sums do not apply, since leaves share vertices.
+ *
+ * With <code>--grid n file.ply</code> an ASCII grid of n x n vertices is
+ * written instead, large enough for the body to be parsed in parallel.
+ */
+
+#include <math.h>
+#include "../components.h"
+#include "../outofcore.h"
+#include "../scene.h"
+
+// model globals, defined in components.c
+extern GLuint *indices;
+extern GLfloat *color;
+extern GLfloat *vertexp;
+extern int n_vertex;
+extern int n_faces;
+extern int isColored;
+extern GLsizei vertex_stride;
+extern GLenum color_type;
+extern GLenum element_type;
+extern float max_coord[3];
+extern float min_coord[3];
+extern int parse_threads;
+
+/*!
+ * Address of the attribute of a vertex in an array of the parsed model,
+ * which may be interleaved in the mapping of the file.
+ */
+static const char *attribute(const void *array, int i, size_t size)
+{
+    return (const char*) array
+           + (size_t) i * (vertex_stride ? (size_t) vertex_stride : size);
+}
+
+/*!
+ * Index of a triangle corner, the indices being shrunk to 16 bits by the
+ * packing of small models.
+ */
+static int corner(int i)
+{
+    if (element_type == GL_UNSIGNED_SHORT)
+        return ((const GLushort*) indices)[i];
+    return indices[i];
+}
+
+/*!
+ * Position of a vertex of the parsed model.
+ */
+static const GLfloat *position(int i)
+{
+    return (const GLfloat*) attribute(vertexp, i, 3 * sizeof (GLfloat));
+}
+
+/*!
+ * Color component of a vertex of the parsed model, in [0, 1].
+ */
+static double color_at(int i, int k)
+{
+    if (color_type == GL_UNSIGNED_BYTE)
+        return ((const GLubyte*) attribute(color, i, 3))[k] / 255.0;
+    return ((const GLfloat*) attribute(color, i, 3 * sizeof (GLfloat)))[k];
+}
+
+/*!
+ * Name of a model file, without directory and without the suffix of the
+ * containers made from it, to match the expected summaries.
+ */
+static const char *model_name(char *filename)
+{
+    char *name = strrchr(filename, '/') ? strrchr(filename, '/') + 1
+                                        : filename;
+    char *suffix = strstr(name, ".ply");
+
+    if (suffix)
+        suffix[strlen(".ply")] = '\0';
+    return name;
+}
+
+/*!
+ * Write an ASCII model holding a grid of n x n vertices in the plane z = 0,
+ * two triangles for each cell, in the layout read by the viewer.
+ */
+static int write_grid(int n, const char *filename)
+{
+    FILE *f = fopen(filename, "w");
+    int i, j;
+
+    if (f == NULL)
+    {
+        printf("Unable to open the file %s.\n", filename);
+        return -1;
+    }
+
+    fprintf(f, "ply\nformat ascii 1.0\nelement vertex %d\n"
+            "property float x\nproperty float y\nproperty float z\n"
+            "property float nx\nproperty float ny\nproperty float nz\n"
+            "property uchar red\nproperty uchar green\n"
+            "property uchar blue\nelement face %d\n"
+            "property list uchar int vertex_indices\nend_header\n",
+            n * n, 2 * (n - 1) * (n - 1));
+    for (i = 0; i < n; ++i)
+        for (j = 0; j < n; ++j)
+            fprintf(f, "%d %d 0 0 0 1 %d %d %d\n",
+                    i, j, i % 256, j % 256, (i + j) % 256);
+    for (i = 0; i + 1 < n; ++i)
+        for (j = 0; j + 1 < n; ++j)
+        {
+            int v = i * n + j;
+            fprintf(f, "3 %d %d %d\n3 %d %d %d\n",
+                    v, v + n, v + n + 1, v, v + n + 1, v + 1);
+        }
+
+    return fclose(f) ? -1 : 0;
+}
+
+/*!
+ * Print the summary of a chunked model, from the triangles of its leaves.
+ */
+static int read_chunks(char *filename)
+{
+    FILE *f = fopen(filename, "rb");
+    Chunk_header h;
+    Chunk_node *nodes = NULL;
+    Packed_vertex *v = NULL;
+    GLuint *t = NULL;
+    double area = 0;
+    double volume = 0;
+    int error = 0;
+    int i, j, k;
+
+    if (f == NULL || fread(&h, sizeof h, 1, f) != 1 || h.n_nodes <= 0)
+    {
+        printf("Unable to read the file %s.\n", filename);
+        if (f)
+            fclose(f);
+        return -1;
+    }
+    nodes = (Chunk_node*) malloc(sizeof (Chunk_node) * h.n_nodes);
+    if (nodes == NULL
+            || fread(nodes, sizeof (Chunk_node), h.n_nodes, f)
+               != (size_t) h.n_nodes)
+        error = 1;
+
+    for (i = 0; !error && i < h.n_nodes; ++i)
+    {
+        const Chunk_node *n = &nodes[i];
+        int wide = n->n_vertex > 65536;
+
+        if (n->n_children)
+            continue;
+        v = (Packed_vertex*) realloc(v, sizeof (Packed_vertex)
+                * (n->n_vertex + 1));
+        t = (GLuint*) realloc(t, sizeof (GLuint) * (n->n_indices + 1));
+        if (v == NULL || t == NULL
+                || fseek(f, (long) n->offset, SEEK_SET)
+                || fread(v, sizeof *v, n->n_vertex, f)
+                   != (size_t) n->n_vertex)
+        {
+            error = 1;
+            break;
+        }
+        for (j = 0; j < n->n_indices && !error; ++j)
+        {
+            GLushort s;
+            if (wide)
+                error = fread(&t[j], sizeof (GLuint), 1, f) != 1;
+            else if (!(error = fread(&s, sizeof s, 1, f) != 1))
+                t[j] = s;
+        }
+
+        for (j = 0; j + 2 < n->n_indices && !error; j += 3)
+        {
+            const GLfloat *a = v[t[j]].position;
+            const GLfloat *b = v[t[j + 1]].position;
+            const GLfloat *c = v[t[j + 2]].position;
+            double p[3], q[3], m[3];
+
+            for (k = 0; k < 3; ++k)
+            {
+                p[k] = b[k] - a[k];
+                q[k] = c[k] - a[k];
+            }
+            m[0] = p[1] * q[2] - p[2] * q[1];
+            m[1] = p[2] * q[0] - p[0] * q[2];
+            m[2] = p[0] * q[1] - p[1] * q[0];
+            area += sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]) / 2;
+            volume += (a[0] * m[0] + a[1] * m[1] + a[2] * m[2]) / 6;
+        }
+    }
+    fclose(f);
+    free(nodes);
+    free(v);
+    free(t);
+
+    if (error)
+    {
+        printf("Unable to read the file %s.\n", filename);
+        return -1;
+    }
+    printf("%s %d %d", model_name(filename), h.n_vertex, h.n_faces);
+    for (k = 0; k < 3; ++k)
+        printf(" %.3f:%.3f", h.min_coord[k], h.max_coord[k]);
+    printf(" %.3f %.3f\n", area, volume);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    double pos[3] = {0, 0, 0};  // sum of the positions
+    double rgb[3] = {0, 0, 0};  // sum of the colors, in 8 bit levels
+    double area = 0;            // total area of the triangles
+    double volume = 0;          // signed volume enclosed by the triangles
+    int process = 0;            // nonzero to process the model
+    int open = 0;               // nonzero to open the model as the viewer
+    int i, k;
+
+    if (argc == 4 && !strcmp(argv[1], "--grid"))
+        return write_grid(atoi(argv[2]), argv[3]) ? EXIT_FAILURE
+                                                  : EXIT_SUCCESS;
+    if (argc == 3 && !strcmp(argv[1], "--chunks"))
+        return read_chunks(argv[2]) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    if (argc == 3 && !strcmp(argv[1], "--process"))
+        process = 1;
+    else if (argc == 3 && !strcmp(argv[1], "--open"))
+        open = 1;
+    else if (argc != 2)
+    {
+        printf("Usage: %s [--process | --open] file.ply | "
+                "--chunks file.mvo | --grid n file.ply\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    argv += argc - 2;
+
+    // split even small bodies, whatever the number of processors
+    parse_threads = 4;
+
+    if (open)
+    {
+        if (open_model(argv[1], argv[0]))
+            return EXIT_FAILURE;
+
+        // a scene is shown once published, as the viewer does on upload
+        if (scene_loaded())
+        {
+            Mesh summary;
+            publish_scene(&summary);
+            select_mesh(&summary);
+        }
+    }
+    else
+    {
+        if (parse_file(argv[1], argv[0]))
+            return EXIT_FAILURE;
+        if (process)
+            process_model();
+        else
+            init_model();
+    }
+
+    printf("%s %d %d", model_name(argv[1]), n_vertex, n_faces);
+    for (k = 0; k < 3; ++k)
+        printf(" %.3f:%.3f", min_coord[k], max_coord[k]);
+    if (scene_active())
+    {
+        printf("\n");
+        return EXIT_SUCCESS;
+    }
+
+    for (i = 0; i < n_vertex; ++i)
+        for (k = 0; k < 3; ++k)
+        {
+            pos[k] += position(i)[k];
+            if (isColored)
+                rgb[k] += floor(color_at(i, k) * 255 + 0.5);
+        }
+
+    for (i = 0; i < n_faces; ++i)
+    {
+        const GLfloat *a = position(corner(i * 3));
+        const GLfloat *b = position(corner(i * 3 + 1));
+        const GLfloat *c = position(corner(i * 3 + 2));
+        double u[3], v[3], n[3];
+
+        for (k = 0; k < 3; ++k)
+        {
+            u[k] = b[k] - a[k];
+            v[k] = c[k] - a[k];
+        }
+        n[0] = u[1] * v[2] - u[2] * v[1];
+        n[1] = u[2] * v[0] - u[0] * v[2];
+        n[2] = u[0] * v[1] - u[1] * v[0];
+        area += sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) / 2;
+        volume += (a[0] * n[0] + a[1] * n[1] + a[2] * n[2]) / 6;
+    }
+
+    printf(" %.3f %.3f %.3f %.0f %.0f %.0f %.3f %.3f\n",
+            pos[0], pos[1], pos[2], rgb[0], rgb[1], rgb[2], area, volume);
+
+    return EXIT_SUCCESS;
+}
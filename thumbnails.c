@@ -0,0 +1,606 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file thumbnails.c
+ * @author agent
+ * @date 2026-10-16
+ *
+ * Thumbnail tool: all the model files found in a directory tree are
+ * rendered offscreen, from the initial point of view of the viewer, and
+ * saved as images in a mirrored directory tree.
+ *
+ * The model loading works on the model globals, so a single process cannot
+ * load several models at once. The files are instead handed out, from a
+ * queue in shared memory, to a pool of worker processes, each one with its
+ * own offscreen context. Inside each worker a loader thread opens the next
+ * model while the previous one is drawn, read back and saved, as the viewer
+ * loads a changed model while drawing the one shown; the two meet in a
+ * single slot, since a model is published (moving it out of the model
+ * globals) before the next one is loaded.
+ *
+ * The main process only supervises the workers: a worker killed by a
+ * signal (e.g. by a malformed model) is reported along with the files it
+ * was busy with, which are queued again, and a new worker takes its place.
+ */
+
+#include "components.h"
+#include "headless.h"
+#include "profiler.h"
+
+#if defined(__linux__)
+    #include <dirent.h>
+    #include <errno.h>
+    #include <pthread.h>
+    #include <strings.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/types.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif // defined(__linux__)
+
+#include "thumbnails.h"
+
+#if defined(__linux__)
+
+Thumb_list models;         //!< Model files found, sorted by name.
+Thumb_slot slot = {        //!< Hand-off between loader and renderer.
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0, 0, 0
+};
+const char *model_dir;     //!< Directory walked for model files.
+const char *out_dir;       //!< Directory for the thumbnails.
+char *exe_path;            //!< Executable path, used to open the models.
+int worker_index = 0;      //!< Position of this worker in the pool.
+int n_jobs = 1;            //!< Number of worker processes.
+Thumb_queue *queue = NULL; //!< Files handed out to the workers, shared.
+
+/*!
+ * Lock the queue. A worker killed while holding the lock leaves it owned
+ * by a dead process, which the robust mutex reports: the queue is updated
+ * only in short critical sections, so it is still consistent.
+ */
+static void lock_queue(void)
+{
+    if (pthread_mutex_lock(&queue->mutex) == EOWNERDEAD)
+        pthread_mutex_consistent(&queue->mutex);
+}
+
+/*!
+ * Hand out the next file to the loader thread of this worker, files to be
+ * retried first. Return -1 when no file is left.
+ */
+static int take_file(void)
+{
+    int file = -1;
+
+    lock_queue();
+    if (queue->n_retry)
+        file = queue->retry[--queue->n_retry];
+    else if (queue->next < models.n_files)
+        file = queue->next++;
+    queue->busy[worker_index][0] = file;
+    pthread_mutex_unlock(&queue->mutex);
+
+    return file;
+}
+
+/*!
+ * Record the file drawn by this worker, -1 for none. A file starting to be
+ * drawn is no longer being loaded.
+ */
+static void set_drawn_file(int file)
+{
+    lock_queue();
+    if (file >= 0)
+        queue->busy[worker_index][0] = -1;
+    queue->busy[worker_index][1] = file;
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+/*!
+ * Count a file which could not be rendered.
+ */
+static void add_failure(void)
+{
+    lock_queue();
+    queue->n_failed++;
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+/*!
+ * Comparison function for qsort, ordering file names alphabetically.
+ */
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+/*!
+ * Add the model files of a directory to the list, descending into its
+ * subdirectories up to `THUMB_MAX_DEPTH` levels (which also stops loops of
+ * symbolic links). Names are stored relative to the walked directory.
+ */
+static void find_models(const char *relative, int depth)
+{
+    char path[STR_LEN + 1], name[STR_LEN + 1];
+    struct dirent *entry;
+    struct stat st;
+    size_t length;
+    DIR *d;
+    int line;
+
+    snprintf(path, sizeof path, "%s/%s", model_dir, relative);
+    d = opendir(path);
+    if (d == NULL)
+    {
+        printf("Unable to open the directory %s.\n", path);
+        return;
+    }
+
+    while ((entry = readdir(d)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+
+        if (snprintf(name, sizeof name, "%s%s%s", relative,
+                    relative[0] ? "/" : "", entry->d_name) > STR_LEN
+                || snprintf(path, sizeof path, "%s/%s", model_dir, name)
+                   > STR_LEN
+                || stat(path, &st))
+            continue;
+
+        if (S_ISDIR(st.st_mode))
+        {
+            if (depth < THUMB_MAX_DEPTH)
+                find_models(name, depth + 1);
+            continue;
+        }
+
+        length = strlen(name);
+        if (!S_ISREG(st.st_mode) || length < strlen(THUMB_EXTENSION)
+                || strcasecmp(name + length - strlen(THUMB_EXTENSION),
+                    THUMB_EXTENSION))
+            continue;
+
+        if (models.n_files == models.capacity)
+        {
+            models.capacity = models.capacity ? 2 * models.capacity : 256;
+            line = __LINE__ + 1;
+            models.files = (char**) realloc(models.files,
+                    sizeof (char*) * models.capacity);
+            if (models.files == NULL)
+                error_handler("realloc", __func__, __FILE__, line);
+        }
+
+        line = __LINE__ + 1;
+        models.files[models.n_files] = strdup(name);
+        if (models.files[models.n_files] == NULL)
+            error_handler("strdup", __func__, __FILE__, line);
+        models.n_files++;
+    }
+
+    closedir(d);
+}
+
+/*!
+ * Name the thumbnail of a model after its relative path, with the
+ * extension replaced, creating the directories leading to it.
+ */
+static int thumbnail_path(char *name, const char *file)
+{
+    const char *dot = strrchr(file, '.');
+    char *p;
+
+    if (snprintf(name, STR_LEN + 1, "%s/%.*s.png", out_dir,
+                (int) (dot - file), file) > STR_LEN)
+        return -1;
+
+    for (p = name + strlen(out_dir) + 1; (p = strchr(p, '/')) != NULL; ++p)
+    {
+        *p = '\0';
+        mkdir(name, 0777);
+        *p = '/';
+    }
+
+    return 0;
+}
+
+/*!
+ * Body of the loader thread of a worker. Each model is taken from the
+ * queue once the slot is free, i.e. once the renderer has published the
+ * previous one, then opened and left in the slot.
+ */
+static void *loader_main(void *arg)
+{
+    char filename[STR_LEN + 1];
+    double start;
+    int i, result;
+
+    UNUSED(arg);
+
+    for (;;)
+    {
+        pthread_mutex_lock(&slot.mutex);
+        while (slot.full)
+            pthread_cond_wait(&slot.change, &slot.mutex);
+        pthread_mutex_unlock(&slot.mutex);
+
+        if ((i = take_file()) < 0)
+            break;
+
+        start = profile_now();
+        result = -1;
+        if (snprintf(filename, sizeof filename, "%s/%s", model_dir,
+                    models.files[i]) <= STR_LEN)
+            result = open_model(filename, exe_path);
+
+        pthread_mutex_lock(&slot.mutex);
+        slot.full = 1;
+        slot.file = i;
+        slot.result = result;
+        slot.load_time = profile_now() - start;
+        pthread_cond_signal(&slot.change);
+        pthread_mutex_unlock(&slot.mutex);
+    }
+
+    pthread_mutex_lock(&slot.mutex);
+    slot.done = 1;
+    pthread_cond_signal(&slot.change);
+    pthread_mutex_unlock(&slot.mutex);
+
+    return NULL;
+}
+
+/*!
+ * Render the thumbnails of the models taken from the queue by the loader
+ * thread of the worker. Each model left in the slot is published, which
+ * frames it as the viewer does and frees the slot for the next one, then
+ * drawn, read back and saved while the next one is loaded.
+ * Return the number of models which could not be rendered.
+ */
+static int run_worker(int w, int h)
+{
+    char name[STR_LEN + 1];
+    unsigned char *pixels;
+    pthread_t loader;
+    double start, worker_start = profile_now(), load_time, render_time;
+    const Mesh *m;
+    int n_done = 0, n_failed = 0;
+    int file, result;
+    int line;
+
+    if (create_offscreen(w, h))
+        return models.n_files;
+    init_gl();
+    resize(w, h);
+
+    line = __LINE__ + 1;
+    pixels = (unsigned char*) malloc((size_t) w * h * 4);
+    if (pixels == NULL)
+        error_handler("malloc", __func__, __FILE__, line);
+
+    line = __LINE__ + 1;
+    if (pthread_create(&loader, NULL, loader_main, NULL))
+        error_handler("pthread_create", __func__, __FILE__, line);
+
+    for (;;)
+    {
+        pthread_mutex_lock(&slot.mutex);
+        while (!slot.full && !slot.done)
+            pthread_cond_wait(&slot.change, &slot.mutex);
+        if (!slot.full)
+        {
+            pthread_mutex_unlock(&slot.mutex);
+            break;
+        }
+        file = slot.file;
+        result = slot.result;
+        load_time = slot.load_time;
+        pthread_mutex_unlock(&slot.mutex);
+        set_drawn_file(file);
+
+        // a failed load is released by the next open_model call
+        start = profile_now();
+        if (!result)
+            publish_model(0);
+
+        pthread_mutex_lock(&slot.mutex);
+        slot.full = 0;
+        pthread_cond_signal(&slot.change);
+        pthread_mutex_unlock(&slot.mutex);
+
+        n_done++;
+        if (result)
+        {
+            printf("thumbnails: %s: unable to load the model.\n",
+                    models.files[file]);
+            n_failed++;
+            add_failure();
+            set_drawn_file(-1);
+            continue;
+        }
+
+        draw_scene();
+        glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        render_time = profile_now() - start;
+
+        if (thumbnail_path(name, models.files[file])
+                || write_png(name, pixels, w, h))
+        {
+            printf("thumbnails: %s: unable to write the thumbnail.\n",
+                    models.files[file]);
+            n_failed++;
+            add_failure();
+            set_drawn_file(-1);
+            continue;
+        }
+        set_drawn_file(-1);
+
+        m = shown_mesh();
+        printf("thumbnails: %s: %d vertices, %d faces, load %.1f ms, "
+                "render %.1f ms\n", models.files[file], m->n_vertex,
+                m->n_faces, load_time, render_time);
+    }
+
+    pthread_join(loader, NULL);
+    free(pixels);
+
+    printf("thumbnails: worker %d: %d models, %d failed, %.1f s.\n",
+            worker_index, n_done, n_failed,
+            (profile_now() - worker_start) * 1e-3);
+
+    return n_failed;
+}
+
+/*!
+ * Start a worker process in the given position of the pool.
+ */
+static pid_t spawn_worker(int k, int w, int h)
+{
+    pid_t pid;
+    int line;
+
+    fflush(stdout);
+    line = __LINE__ + 1;
+    pid = fork();
+    if (pid < 0)
+        error_handler("fork", __func__, __FILE__, line);
+    if (pid == 0)
+    {
+        worker_index = k;
+        exit(run_worker(w, h) ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    return pid;
+}
+
+/*!
+ * Report a worker which stopped, given its status from wait(), with the
+ * files it was loading and drawing: it was either killed by a signal or
+ * it exited in the middle of a file (e.g. on a failed allocation). Each of
+ * them is queued again, unless it was already involved in
+ * `THUMB_MAX_CRASHES` crashes (counted in <code>crashes</code>), in which
+ * case it is skipped as failed. Return nonzero if the worker was busy with
+ * some file, i.e. if it is worth replacing it.
+ */
+static int recover_worker(int k, int status, unsigned char *crashes)
+{
+    static const char *state[2] = {"loading", "drawing"};
+    char reason[32];  // how the worker stopped
+    int busy = 0, file, j;
+
+    if (WIFSIGNALED(status))
+        sprintf(reason, "killed by signal %d", WTERMSIG(status));
+    else
+        sprintf(reason, "exited with status %d", WEXITSTATUS(status));
+
+    lock_queue();
+    for (j = 0; j < 2; ++j)
+    {
+        if ((file = queue->busy[k][j]) < 0)
+            continue;
+        queue->busy[k][j] = -1;
+        busy = 1;
+
+        printf("thumbnails: worker %d %s while %s %s.\n",
+                k, reason, state[j], models.files[file]);
+        if (++crashes[file] >= THUMB_MAX_CRASHES)
+        {
+            printf("thumbnails: %s: skipped after %d crashes.\n",
+                    models.files[file], crashes[file]);
+            queue->n_failed++;
+        }
+        else
+            queue->retry[queue->n_retry++] = file;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    if (!busy && WIFSIGNALED(status))
+        printf("thumbnails: worker %d %s.\n", k, reason);
+
+    return busy;
+}
+
+/*!
+ * Create the queue of the files, in memory shared with the workers, with
+ * a lock which can be taken by any of them and which survives a worker
+ * killed while holding it.
+ */
+static void create_queue(void)
+{
+    pthread_mutexattr_t attributes;
+    int j, k;
+    int line;
+
+    line = __LINE__ + 1;
+    queue = (Thumb_queue*) mmap(NULL, sizeof (Thumb_queue),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (queue == MAP_FAILED)
+        error_handler("mmap", __func__, __FILE__, line);
+
+    memset(queue, 0, sizeof (Thumb_queue));
+    for (k = 0; k < THUMB_MAX_JOBS; ++k)
+        for (j = 0; j < 2; ++j)
+            queue->busy[k][j] = -1;
+
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&queue->mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+}
+
+/*!
+ * The tool is invoked as
+ * <code>thumbnails [--size WxH] [--out dir] [--jobs N] [options] dir</code>,
+ * with the model options of parse_option(int, char**, int*).
+ * The thumbnail of <code>dir/a/b.ply</code> is saved as
+ * <code>out/a/b.png</code> (in the <code>thumbnails</code> directory by
+ * default). The files are handed out to N worker processes (one per core
+ * by default), forked by a process which creates no context nor thread, so
+ * that a worker killed by a signal, or exiting before finishing its file,
+ * can be replaced at any time. The files which could not be rendered are
+ * reported, and the exit status is then a failure.
+ * Since llvmpipe would start as many rendering threads per worker, one
+ * rendering thread is requested for each worker, unless the
+ * <code>LP_NUM_THREADS</code> environment variable is already set.
+ */
+int main(int argc, char *argv[])
+{
+    int w = BATCH_THUMB_SIZE, h = BATCH_THUMB_SIZE;
+    int failed = 0, status, applied, alive, left, i, k;
+    int line;
+    unsigned char *crashes;     // crashes each file was involved in
+    pid_t workers[THUMB_MAX_JOBS], pid;
+
+    // lines of different workers must not be mixed
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    model_dir = NULL;
+    out_dir = "thumbnails";
+    exe_path = argv[0];
+    n_jobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    // a model library is not filled with cache files, unless asked
+    set_cache_writing(0);
+
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--size") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%dx%d", &w, &h) != 2)
+                w = h = 0;
+        }
+        else if (!strcmp(argv[i], "--out") && i + 1 < argc)
+            out_dir = argv[++i];
+        else if (!strcmp(argv[i], "--jobs") && i + 1 < argc)
+            n_jobs = atoi(argv[++i]);
+        else if ((applied = parse_option(argc, argv, &i)) != 0)
+        {
+            if (applied < 0)
+                return EXIT_FAILURE;
+        }
+        else if (argv[i][0] != '-' && model_dir == NULL)
+            model_dir = argv[i];
+        else
+        {
+            printf("Unknown argument %s.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (model_dir == NULL || w < 1 || h < 1 || n_jobs < 1)
+    {
+        printf("Usage: %s [--size WxH] [--out dir] [--jobs N] [options] "
+                "dir\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    find_models("", 0);
+    if (models.n_files == 0)
+    {
+        printf("No %s files found in %s.\n", THUMB_EXTENSION, model_dir);
+        return EXIT_SUCCESS;
+    }
+    qsort(models.files, models.n_files, sizeof (char*), compare_names);
+    mkdir(out_dir, 0777);
+
+    if (n_jobs > models.n_files)
+        n_jobs = models.n_files;
+    if (n_jobs > THUMB_MAX_JOBS)
+        n_jobs = THUMB_MAX_JOBS;
+    if (n_jobs > 1)
+        setenv("LP_NUM_THREADS", "1", 0);
+    printf("thumbnails: %d models, %d workers.\n", models.n_files, n_jobs);
+
+    create_queue();
+    line = __LINE__ + 1;
+    crashes = (unsigned char*) calloc(models.n_files, 1);
+    if (crashes == NULL)
+        error_handler("calloc", __func__, __FILE__, line);
+
+    for (k = 0; k < n_jobs; k++)
+        workers[k] = spawn_worker(k, w, h);
+
+    // replace the workers which stopped, however, while busy with a file
+    for (alive = n_jobs; alive > 0; )
+    {
+        pid = wait(&status);
+        if (pid < 0)
+            break;
+        for (k = 0; k < n_jobs && workers[k] != pid; k++) {}
+        if (k == n_jobs)
+            continue;
+        alive--;
+
+        if (recover_worker(k, status, crashes))
+        {
+            workers[k] = spawn_worker(k, w, h);
+            alive++;
+        }
+        else if (!WIFSIGNALED(status) && WEXITSTATUS(status) != EXIT_SUCCESS)
+            failed = 1;
+    }
+
+    // files left when no worker could go on
+    left = models.n_files - queue->next + queue->n_retry;
+    if (left)
+        printf("thumbnails: %d models not processed.\n", left);
+    printf("thumbnails: %d models, %d failed.\n", models.n_files,
+            queue->n_failed + left);
+    if (queue->n_failed || left)
+        failed = 1;
+
+    free(crashes);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#else // __APPLE__, _WIN32
+
+/*!
+ * The thumbnail tool relies on EGL, available only on Linux.
+ */
+int main(int argc, char *argv[])
+{
+    UNUSED(argc);
+    printf("%s: the thumbnail tool is not supported on this platform.\n",
+            argv[0]);
+    return EXIT_FAILURE;
+}
+
+#endif // defined(__linux__)
@@ -0,0 +1,99 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file thumbnails.h
+ * @author agent
+ * @date 2026-10-16
+ */
+
+/*! Extension of the model files rendered by the thumbnail tool. */
+#define THUMB_EXTENSION ".ply"
+
+/*! Maximum number of worker processes of the thumbnail tool. */
+#define THUMB_MAX_JOBS 256
+
+/*! Maximum depth of the directories walked by the thumbnail tool. */
+#define THUMB_MAX_DEPTH 64
+
+/*!
+ * Number of worker crashes a model file may be involved in before it is
+ * skipped. Since a worker loads a model while drawing another one, a file
+ * is retried once in case the crash was caused by the other one.
+ */
+#define THUMB_MAX_CRASHES 2
+
+/*!
+ * Type for the list of model files of the thumbnail tool.
+ */
+typedef struct Thumb_list Thumb_list;
+
+/*!
+ * Structure holding the model files found walking a directory.
+ */
+struct Thumb_list
+{
+    char **files;  /*!< Model file names, relative to the directory. */
+    int n_files;   /*!< Number of model files. */
+    int capacity;  /*!< Number of files allocated. */
+};
+
+#if defined(__linux__)
+/*!
+ * Type for the hand-off between the loader thread and the renderer of a
+ * thumbnail worker.
+ */
+typedef struct Thumb_slot Thumb_slot;
+
+/*!
+ * Structure holding the model loaded by the loader thread of a worker,
+ * waiting to be published and drawn by its renderer. While the slot is
+ * full the model globals belong to the renderer, otherwise to the loader.
+ */
+struct Thumb_slot
+{
+    pthread_mutex_t mutex; /*!< Lock for the slot. */
+    pthread_cond_t change; /*!< Signaled when the slot is filled or freed. */
+    int full;              /*!< Nonzero if a model is waiting. */
+    int done;              /*!< Nonzero when the loader has finished. */
+    int file;              /*!< Position of the waiting model in the list. */
+    int result;            /*!< Result of open_model for it. */
+    double load_time;      /*!< Time spent loading it, in ms. */
+};
+
+/*!
+ * Type for the queue of model files shared by the thumbnail workers.
+ */
+typedef struct Thumb_queue Thumb_queue;
+
+/*!
+ * Structure, in memory shared by all the processes of the thumbnail tool,
+ * holding the files still to be rendered and the files each worker is
+ * busy with, so that the files of a crashed worker can be reported and
+ * handed out again.
+ */
+struct Thumb_queue
+{
+    pthread_mutex_t mutex;  /*!< Lock for the queue, shared and robust. */
+    int next;               /*!< First file of the list not handed out. */
+    int retry[2 * THUMB_MAX_JOBS]; /*!< Files to be handed out again. */
+    int n_retry;            /*!< Number of files to be handed out again. */
+    int busy[THUMB_MAX_JOBS][2]; /*!< File loaded and file drawn by each
+                                      worker, -1 for none. */
+    int n_failed;           /*!< Number of files which failed. */
+};
+#endif // defined(__linux__)
@@ -0,0 +1,187 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file watch.c
+ * @author agent
+ * @date 2026-10-16
+ *
+ * Watch of the model files, to reload a model when it changes on disk. On
+ * Linux the directory of each file is watched through inotify, which also
+ * reports files replaced by a rename (as most editors save them); the
+ * events are read without blocking, from a timer. Elsewhere the size and
+ * modification time of the files are polled.
+ */
+
+#include "components.h"
+#include "profiler.h"
+#include "watch.h"
+
+#if defined(__APPLE__) || defined(__linux__)
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif // defined(__APPLE__) || defined(__linux__)
+
+#if defined(__linux__)
+    #include <sys/inotify.h>
+    #include <limits.h>
+#endif // defined(__linux__)
+
+Watched_file watched[WATCH_MAX_FILES]; //!< Files watched for changes.
+int n_watched = 0;         //!< Number of files watched.
+int watch_fd = -1;         //!< Inotify instance, if any.
+int change_pending = 0;    //!< Nonzero if a change was not reported yet.
+double last_change = 0;    //!< Time of the last change seen, in ms.
+
+#if defined(__APPLE__) || defined(__linux__)
+/*!
+ * Read size and modification time of a file, which are zero if it cannot
+ * be inspected (e.g. while it is being replaced).
+ */
+static void file_stamp(const char *filename, long long *mtime,
+        long long *size)
+{
+    struct stat st;
+
+    *mtime = *size = 0;
+    if (stat(filename, &st))
+        return;
+
+    #if defined(__APPLE__)
+    *mtime = st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+    #else
+    *mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    #endif // defined(__APPLE__)
+    *size = st.st_size;
+}
+#endif // defined(__APPLE__) || defined(__linux__)
+
+/*!
+ * On Linux the directory of the file is added to the inotify instance
+ * (created at the first call), and the events of the directory are then
+ * filtered by file name. A directory watched for several files has a
+ * single watch descriptor.
+ */
+int watch_file(const char *filename)
+{
+#if defined(__APPLE__) || defined(__linux__)
+    Watched_file *w;
+    const char *slash = strrchr(filename, '/');
+    int i;
+
+    for (i = 0; i < n_watched; ++i)
+        if (!strcmp(watched[i].path, filename))
+            return 0;
+
+    if (n_watched == WATCH_MAX_FILES || strlen(filename) > STR_LEN)
+        return -1;
+
+    w = &watched[n_watched];
+    strcpy(w->path, filename);
+    w->name = slash ? w->path + (slash - filename) + 1 : w->path;
+    file_stamp(filename, &w->mtime, &w->size);
+
+    #if defined(__linux__)
+    {
+        char dir[STR_LEN + 1];
+
+        if (watch_fd < 0)
+            watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (watch_fd < 0)
+            return -1;
+
+        if (slash == NULL)
+            strcpy(dir, ".");
+        else
+        {
+            memcpy(dir, filename, slash > filename ? slash - filename : 1);
+            dir[slash > filename ? slash - filename : 1] = '\0';
+        }
+
+        // saving in place closes the file, saving by rename moves it
+        w->wd = inotify_add_watch(watch_fd, dir,
+                IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY);
+        if (w->wd < 0)
+            return -1;
+    }
+    #endif // defined(__linux__)
+
+    ++n_watched;
+    return 0;
+#else // _WIN32
+    UNUSED(filename);
+    return -1;
+#endif // defined(__APPLE__) || defined(__linux__)
+}
+
+/*!
+ * Each change postpones the report by <code>settle</code> ms, so that a
+ * file written in several steps, or several files of a scene saved
+ * together, cause a single reload.
+ */
+int watch_changed(int settle)
+{
+    double now = profile_now();
+    int i;
+
+#if defined(__linux__)
+    union
+    {
+        struct inotify_event event;
+        char bytes[16 * (sizeof (struct inotify_event) + NAME_MAX + 1)];
+    } buffer;
+    const struct inotify_event *e;
+    ssize_t length;
+    char *p;
+
+    while (watch_fd >= 0
+            && (length = read(watch_fd, &buffer, sizeof buffer)) > 0)
+        for (p = buffer.bytes; p < buffer.bytes + length;
+                p += sizeof (struct inotify_event) + e->len)
+        {
+            e = (const struct inotify_event*) p;
+            for (i = 0; e->len && i < n_watched; ++i)
+                if (watched[i].wd == e->wd && !strcmp(watched[i].name, e->name))
+                {
+                    change_pending = 1;
+                    last_change = now;
+                }
+        }
+#elif defined(__APPLE__)
+    long long mtime, size;
+
+    for (i = 0; i < n_watched; ++i)
+    {
+        file_stamp(watched[i].path, &mtime, &size);
+        if (mtime != watched[i].mtime || size != watched[i].size)
+        {
+            watched[i].mtime = mtime;
+            watched[i].size = size;
+            change_pending = 1;
+            last_change = now;
+        }
+    }
+#else // _WIN32
+    UNUSED(i);
+#endif // defined(__linux__)
+
+    if (!change_pending || now - last_change < settle)
+        return 0;
+
+    change_pending = 0;
+    return 1;
+}
@@ -0,0 +1,57 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) agent, 2026
+ */
+
+/*!
+ * \file watch.h
+ * @author agent
+ * @date 2026-10-16
+ */
+
+/*! Maximum number of files watched for changes. */
+#define WATCH_MAX_FILES 512
+
+/*!
+ * Type for a file watched for changes.
+ */
+typedef struct Watched_file Watched_file;
+
+/*!
+ * Structure defining a file watched for changes.
+ */
+struct Watched_file
+{
+    char path[STR_LEN + 1]; /*!< Name of the file, as given. */
+    const char *name;       /*!< Name of the file within its directory. */
+    int wd;                 /*!< Watch descriptor of its directory. */
+    long long mtime;        /*!< Last modification time seen, in ns. */
+    long long size;         /*!< Last size seen. */
+};
+
+/*!
+ * \brief Start watching a file for changes.
+ * @param filename Name of the file.
+ * @return 0 on success (or if the file is already watched), -1 on failure.
+ */
+int watch_file(const char *filename);
+
+/*!
+ * \brief Check if any of the watched files changed.
+ * @param settle Time (in ms) which must elapse after the last change.
+ * @return Nonzero, once for a series of changes, when a watched file
+ * changed at least <code>settle</code> ms ago and not since then.
+ */
+int watch_changed(int settle);